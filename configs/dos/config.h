@@ -18,8 +18,12 @@
 #define ENABLE_MEMORY_GENERIC
 //#define ENABLE_MEMORY_X86_LINEAR
 //#define ENABLE_MEMORY_X86_VIRTUAL
+//#define ENABLE_PERF_COUNTERS_LINUX
+//#define ENABLE_PROFILER_LINUX
 //#define ENABLE_RANDOM_INTEL_X86
 #define ENABLE_RANDOM_GENERIC
+//#define ENABLE_REALTIME_HARDENING_LINUX
+//#define ENABLE_SCHEDULER_LINUX_DEADLINE
 #define ENABLE_SCHEDULER_REALTIME
 #define ENABLE_SERIAL_16650
 #define ENABLE_TEXT_DOS
@@ -29,5 +33,6 @@
 #define ENABLE_TIMER_DOS
 //#define ENABLE_TIMER_INTEL_8253
 //#define ENABLE_TIMER_LINUX
+//#define ENABLE_TIMER_LINUX_TIMERFD
 //#define ENABLE_TIMER_MACOS
 //#define ENABLE_TIMER_WIN32
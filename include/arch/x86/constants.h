@@ -35,6 +35,7 @@
 #        define   PIT_CHANNEL_0       0x40
 #        define   PIT_CHANNEL_1       0x41
 #        define   PIT_CHANNEL_2       0x42
+#        define   PIT_FREQUENCY       1193182     // Hz, the input clock divided down by the counters
 //   - Programmable Interrupt Controller  (8259)
 #        define   PIC_MASTER_COMMAND  0x20
 #        define   PIC_MASTER_DATA     0x21
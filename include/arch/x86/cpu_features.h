@@ -0,0 +1,41 @@
+/*
+  Real-time Scheduler
+  Copyright (c) 2023, John Ryland
+  All rights reserved.
+*/
+
+#pragma once
+
+#include "arch/x86/intrinsics.h"
+#include "module/cpu.h"
+
+// Queries cpuid for the features in cpu_feature_t. Assumes cpuid is
+// available, which it is on anything from the Pentium onwards.
+static inline
+uint32_t x86_cpu_features()
+{
+  uint32_t a, b, c, d;
+  uint32_t features = 0;
+
+  cpuid_count(0, 0, &a, &b, &c, &d);
+  uint32_t max_leaf = a;
+
+  cpuid_count(1, 0, &a, &b, &c, &d);
+  if (d & (1 << 4))
+    features |= CPU_FEATURE_TSC;
+  if (d & (1 << 26))
+    features |= CPU_FEATURE_SSE2;
+
+  // AVX needs the OS to have enabled saving the xmm and ymm state (XCR0 bits 1 and 2)
+  bool avx_usable = (c & (1 << 27)) && (c & (1 << 28)) && ((xgetbv(0) & 0x6) == 0x6);
+
+  if (max_leaf >= 7)
+  {
+    cpuid_count(7, 0, &a, &b, &c, &d);
+    if (avx_usable && (b & (1 << 5)))
+      features |= CPU_FEATURE_AVX2;
+    if (b & (1 << 9))
+      features |= CPU_FEATURE_ERMS;
+  }
+  return features;
+}
@@ -104,12 +104,37 @@ void cpuid(int code, uint32_t* a, uint32_t* d)
   asm volatile ( "cpuid" : "=a"(*a), "=d"(*d) : "0"(code) : "ebx", "ecx" );
 }
 
+static inline
+void cpuid_count(uint32_t leaf, uint32_t subleaf, uint32_t* a, uint32_t* b, uint32_t* c, uint32_t* d)
+{
+  asm volatile ( "cpuid" : "=a"(*a), "=b"(*b), "=c"(*c), "=d"(*d) : "0"(leaf), "2"(subleaf) );
+}
+
+// reads an extended control register, only valid if cpuid reports OSXSAVE
+static inline
+uint64_t xgetbv(uint32_t index)
+{
+  uint32_t lo, hi;
+  asm volatile ( "xgetbv" : "=a"(lo), "=d"(hi) : "c"(index) );
+  return (uint64_t(hi) << 32) | lo;
+}
+
+// "=A" is only edx:eax on 32-bit, so read the halves separately to also work on 64-bit
 static inline
 uint64_t rdtsc()
 {
-  uint64_t ret;
-  asm volatile ( "rdtsc" : "=A"(ret) );
-  return ret;
+  uint32_t lo, hi;
+  asm volatile ( "rdtsc" : "=a"(lo), "=d"(hi) );
+  return (uint64_t(hi) << 32) | lo;
+}
+
+// reads a performance counter, which faults unless CR4.PCE allows it
+static inline
+uint64_t rdpmc(uint32_t counter)
+{
+  uint32_t lo, hi;
+  asm volatile ( "rdpmc" : "=a"(lo), "=d"(hi) : "c"(counter) );
+  return (uint64_t(hi) << 32) | lo;
 }
 
 static inline
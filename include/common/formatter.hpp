@@ -21,19 +21,28 @@
 //! @details
 //!    Provides similar functionality to sprintf, however with some improvements.
 //!   
-//!    The first improvement is the safety because an output buffer is not
-//!    provided by the caller which needs to be large enough, instead the result
-//!    is returned on the stack.
+//!    The first improvement is the safety because output is written to a sink
+//!    which bounds what is written, such as FixedBufferSink which truncates,
+//!    or returned as a String<N> on the stack with Formatter.
 //!   
-//!    This is the second improvement which is that there are no heap or dynamic
-//!    memory allocations. Instead everything is using the stack only. This is
-//!    acheieved by using the String<N> class.
+//!    The second improvement is that there are no heap or dynamic memory
+//!    allocations, and the output is streamed straight in to the sink without
+//!    any intermediate strings.
 //!   
-//!    The last improvement is positional replacement of the parameters in to the
+//!    The third improvement is positional replacement of the parameters in to the
 //!    format string. A format string such as "Hi {1}, today is {2} of {3}." can
 //!    be translated in to other languages where the word order is different and
 //!    the code doesn't need to be changed to accomodate such a change, only the
 //!    format strings need to be selected based on the current language.
+//!   
+//!    Lastly, the format string is parsed at compile time in to a list of
+//!    segments, and it is a compile error to refer to a parameter which
+//!    was not passed.
+//!   
+//!    A sink is any type with these members:
+//!   
+//!        void put(char a_char);
+//!        void write(const char* a_str, size_t a_length);
 
 #pragma once
 
@@ -42,65 +51,286 @@
 
 #include "string.hpp"
 #include "string_utilities.hpp"
+#include "traits.hpp"
 #include "debug_logger.h"
 
+/// @brief Maximum number of literal and parameter segments in a format string.
+static constexpr size_t MaxFormatSegments = 32;
+
+/// @brief Size of the String returned by Formatter if not given.
+static constexpr size_t FormatterStringSize = 256;
+
+/// @cond document_details
+namespace details
+{
+  // Kept small as a FormatString holds MaxFormatSegments of these
+  struct FormatSegment
+  {
+    uint16_t  m_start;   // offset in to the format string of the literal text
+    uint16_t  m_length;  // length of the literal text
+    uint16_t  m_param;   // 0 for literal text, otherwise the 1-based index of the parameter
+  };
+
+  // Not constexpr, so calling this while parsing at compile time makes it a compile error
+  inline
+  void FormatStringError(const char* /*a_reason*/)
+  {
+  }
+} // end namespace details
+/// @endcond
+
+/// @brief A format string which is parsed at compile time for the given parameter types.
+///        It is constructed implicitly from a string literal passed to FormatTo or Formatter,
+///        which take it by reference so the segments aren't copied at each call.
+/// @tparam ...Ts are types of the parameters which will be formatted with it.
+template <typename... Ts>
+class FormatString
+{
+public:
+  /// @brief Parses the format string in to segments.
+  /// @param a_formatString is the format string literal.
+  template <size_t N>
+  consteval
+  FormatString(const char (&a_formatString)[N])
+    : m_format(a_formatString)
+  {
+    size_t len = 0;
+    while (len < N && a_formatString[len])
+      ++len;
+    if (len > 0xFFFF)
+      details::FormatStringError("format string is too long");
+
+    size_t literalStart = 0;
+    size_t i = 0;
+    while (i < len)
+    {
+      if (a_formatString[i] == '{')
+      {
+        size_t j = i + 1;
+        size_t param = 0;
+        while (j < len && a_formatString[j] >= '0' && a_formatString[j] <= '9')
+          param = param * 10 + (a_formatString[j++] - '0');
+        if (j < len && j != i + 1 && a_formatString[j] == '}')
+        {
+          if (param == 0 || param > sizeof...(Ts))
+            details::FormatStringError("format string refers to a parameter which is not passed");
+          addSegment(literalStart, i - literalStart, 0);
+          addSegment(0, 0, param);
+          i = j + 1;
+          literalStart = i;
+          continue;
+        }
+      }
+      ++i;
+    }
+    addSegment(literalStart, len - literalStart, 0);
+  }
+
+  inline constexpr
+  const char* format() const
+  {
+    return m_format;
+  }
+
+  inline constexpr
+  size_t segmentCount() const
+  {
+    return m_segmentCount;
+  }
+
+  inline constexpr
+  const details::FormatSegment& segment(size_t a_index) const
+  {
+    return m_segments[a_index];
+  }
+
+private:
+  const char*             m_format;
+  details::FormatSegment  m_segments[MaxFormatSegments] = {};
+  size_t                  m_segmentCount = 0;
+
+  consteval
+  void addSegment(size_t a_start, size_t a_length, size_t a_param)
+  {
+    if (a_param == 0 && a_length == 0)
+      return;
+    if (m_segmentCount >= MaxFormatSegments)
+      details::FormatStringError("format string has too many segments");
+    m_segments[m_segmentCount++] = { uint16_t(a_start), uint16_t(a_length), uint16_t(a_param) };
+  }
+};
+
+/// @brief A sink which writes in to a fixed size buffer, truncating anything which doesn't fit.
+/// @tparam N is the maximum number of characters it will hold.
+template <size_t N>
+class FixedBufferSink
+{
+public:
+  inline constexpr
+  void put(char a_char)
+  {
+    if (m_length < N)
+      m_data[m_length++] = a_char;
+    else
+      m_truncated = true;
+  }
+
+  inline constexpr
+  void write(const char* a_str, size_t a_length)
+  {
+    for (size_t i = 0; i < a_length; ++i)
+      put(a_str[i]);
+  }
+
+  /// @brief Gets the written characters, null-terminated.
+  inline constexpr
+  const char* c_str()
+  {
+    m_data[m_length] = 0;
+    return m_data;
+  }
+
+  inline constexpr
+  size_t length() const
+  {
+    return m_length;
+  }
+
+  /// @brief Returns true if anything didn't fit in the buffer.
+  inline constexpr
+  bool truncated() const
+  {
+    return m_truncated;
+  }
+
+  /// @brief Copies the written characters in to a String.
+  inline constexpr
+  String<N + 1> toString() const
+  {
+    return String<N + 1>(m_data, m_length);
+  }
+
+private:
+  char    m_data[N + 1] = {};
+  size_t  m_length = 0;
+  bool    m_truncated = false;
+};
+
 /// @cond document_details
 namespace details
 {
-  template <size_t ParamIndex, size_t N>
+  // Only for pointers, char arrays are handled by the overload for arrays
+  template <typename Sink, typename T, enable_if_t< is_same<T, const char*>::value || is_same<T, char*>::value, bool > = true>
+  static inline constexpr
+  void FormatValue(Sink& a_sink, const T& a_value)
+  {
+    const char* str = a_value;
+    if (!str)
+      str = "(null)";
+    size_t len = 0;
+    while (str[len])
+      ++len;
+    a_sink.write(str, len);
+  }
+
+  template <typename Sink, size_t N>
+  static inline constexpr
+  void FormatValue(Sink& a_sink, const char (&a_str)[N])
+  {
+    size_t len = 0;
+    while (len < N && a_str[len])
+      ++len;
+    a_sink.write(a_str, len);
+  }
+
+  template <typename Sink, size_t N>
+  static inline constexpr
+  void FormatValue(Sink& a_sink, const String<N>& a_str)
+  {
+    a_sink.write(a_str.c_str(), a_str.length());
+  }
+
+  template <typename Sink>
   static inline constexpr
-  auto FormatterHelper(const String<N>& a_formatString)
+  void FormatValue(Sink& a_sink, char a_char)
   {
-    k_dbg<FORMATTER>("helper  fmt: -%s- len: %i  N: %i\n", a_formatString.c_str(), a_formatString.length(), N);
-    const auto str = a_formatString;
-    k_dbg<FORMATTER>("helper  str: -%s- len: %i  N: %i\n", str.c_str(), str.length(), N);
-    return str;
+    a_sink.put(a_char);
   }
-  
-  template <size_t ParamIndex, size_t N, typename T, typename... Ts>
+
+  // Only the whole number part of floating point numbers is output, the same as to_string
+  template <typename Sink, typename T, enable_if_t< is_arithmetic<T>::value, bool > = true>
   static inline constexpr
-  auto FormatterHelper(const String<N>& a_formatString, T&& a_param, Ts&&... a_params)
-  {
-    k_dbg<FORMATTER>("step-1\n");
-    const auto paramIndexString = to_string("{") + to_string(ParamIndex) + to_string("}");
-    k_dbg<FORMATTER>("step-2\n");
-    const auto paramIndexStringLength = paramIndexString.length();
-    k_dbg<FORMATTER>("step-3\n");
-    const auto paramPosition = a_formatString.find(paramIndexString);
-    k_dbg<FORMATTER>("step-4: paramIndexString: -%s- len: %i  pos: %i\n", paramIndexString.c_str(), paramIndexStringLength, paramPosition);
-    const auto before = paramPosition ? a_formatString.template startEndSubString<N>(0, paramPosition - 1) : String<N>("");
-    k_dbg<FORMATTER>("step-5\n");
-    const auto after = a_formatString.template startEndSubString<N>(paramPosition + paramIndexStringLength); 
-    k_dbg<FORMATTER>("step-6:  b4: -%s- len: %i  aft: -%s- len: %i\n", before.c_str(), before.length(), after.c_str(), after.length());
-    const auto paramString = to_string(a_param);
-    k_dbg<FORMATTER>("step-7: paramStr: -%s- len: %i \n", paramString.c_str(), paramString.length());
-    const auto beforeWithParamString = before + paramString;
-    k_dbg<FORMATTER>("step-8\n");
-    const auto newFormatString = beforeWithParamString + after;
-    k_dbg<FORMATTER>("step-9\n");
-    //const auto newFormatString = before + to_string(a_param) + after;
-//    const auto ret = FormatterHelper<ParamIndex + 1>(newFormatString, forward<Ts>(a_params)...);
-//    return ret;
-    return FormatterHelper<ParamIndex + 1>(newFormatString, forward<Ts>(a_params)...);
+  void FormatValue(Sink& a_sink, const T& a_number)
+  {
+    char data[24];               // big enough for a 64-bit number in decimal with a sign
+    size_t idx = sizeof(data);
+    bool negative = a_number < T(0);
+    uint64_t value = negative ? uint64_t(0) - uint64_t(int64_t(a_number)) : uint64_t(a_number);
+    do {
+      data[--idx] = '0' + (value % 10);
+      value /= 10;
+    } while (value);
+    if (negative)
+      data[--idx] = '-';
+    a_sink.write(data + idx, sizeof(data) - idx);
+  }
+
+  template <size_t ParamIndex, typename Sink>
+  static inline constexpr
+  void FormatParam(Sink& /*a_sink*/, size_t /*a_param*/)
+  {
+  }
+
+  template <size_t ParamIndex, typename Sink, typename T, typename... Ts>
+  static inline constexpr
+  void FormatParam(Sink& a_sink, size_t a_param, const T& a_value, const Ts&... a_values)
+  {
+    if (a_param == ParamIndex)
+      FormatValue(a_sink, a_value);
+    else
+      FormatParam<ParamIndex + 1>(a_sink, a_param, a_values...);
   }
 } // end namespace details
 /// @endcond
 
+/// @brief Writes a_formatString to a_sink with the parameters substituted in to the positional
+///        places of the format string. For example a format string of "Hi {2}, you are {1}."
+///        and with parameters of age and name writes "Hi <name>, you are <age>".
+/// @tparam Sink is the type of a_sink, see the file details for what it needs to provide.
+/// @tparam ...Ts are types of a_params.
+/// @param a_sink is where the output is written.
+/// @param a_formatString is the string describing where a_params are to be expanded to.
+/// @param ...a_params are the parmeters to expand as strings and insert in to the format string.
+template <typename Sink, typename... Ts>
+static inline constexpr
+void FormatTo(Sink& a_sink, const FormatString<type_identity_t<Ts>...>& a_formatString, const Ts&... a_params)
+{
+  k_dbg<FORMATTER>("format: -%s- segments: %i\n", a_formatString.format(), a_formatString.segmentCount());
+  for (size_t i = 0; i < a_formatString.segmentCount(); ++i)
+  {
+    const details::FormatSegment& segment = a_formatString.segment(i);
+    if (segment.m_param)
+      details::FormatParam<1>(a_sink, segment.m_param, a_params...);
+    else
+      a_sink.write(a_formatString.format() + segment.m_start, segment.m_length);
+  }
+}
+
 /// @brief Creates a fixed size string that is formatted by a_formatString and where the
 ///        parameters are substituted in to the positional places of the format string.
 ///        For example a format string of "Hi {2}, you are {1}." and with parameters
 ///        of age and name which make a new string of "Hi <name>, you are <age>".
+/// @tparam Capacity is the maximum length of the result, anything longer is truncated.
 /// @tparam ...Ts are types of a_params.
-/// @tparam N is the size of the format string.
 /// @param a_formatString is the string describing where a_params are to be expanded to.
 /// @param ...a_params are the parmeters to expand as strings and insert in to the format string.
 /// @return Returns a fixed sized string.
-template <size_t N, typename... Ts>
+/// @see FormatTo which avoids the copy in to a String.
+template <size_t Capacity = FormatterStringSize, typename... Ts>
 static inline constexpr
-auto Formatter(const char (&a_formatString)[N], Ts&&... a_params)
+auto Formatter(const FormatString<type_identity_t<Ts>...>& a_formatString, const Ts&... a_params)
 {
-  k_dbg<FORMATTER>("entry\n");
-  const auto str = to_string(a_formatString);
-  k_dbg<FORMATTER>("entry2\n");
-  return details::FormatterHelper<1>(str, forward<Ts>(a_params)...);
+  FixedBufferSink<Capacity> sink;
+  FormatTo(sink, a_formatString, a_params...);
+  return sink.toString();
 }
@@ -0,0 +1,160 @@
+///////////////////////////////////////////////////////////////////////////////
+//!
+//! @file
+//!    hash_map.hpp
+//!
+//! @brief
+//!    C++ Fixed Capacity Hash Map Template.
+//!
+//! @author
+//!    Copyright (c) 2023, John Ryland,
+//!    All rights reserved.
+//!
+//! License
+//!    BSD-2-Clause License. See included LICENSE file for details.
+//!    If LICENSE file is missing, see:
+//!    https://opensource.org/licenses/BSD-2-Clause
+//!
+//!    Other licensing terms available.
+//!    See LICENSE.Commercial for details.
+//!
+//! @details
+//!    Similar to std::unordered_map with integer keys, but with a fixed
+//!    capacity and no allocations. Uses open addressing with linear probing,
+//!    and removal shifts entries back instead of leaving tombstones, so
+//!    lookups stay short however many times entries are added and removed.
+
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+// Includes
+
+#include "integers.hpp"
+
+/// @brief Mixes the bits of an integer key so nearby keys are spread out.
+/// @param a_key is the key to hash.
+/// @return Returns the hash of a_key.
+static inline constexpr
+uint32_t hashInteger(uint32_t a_key)
+{
+  // the finalizer of MurmurHash3
+  a_key ^= a_key >> 16;
+  a_key *= 0x85EBCA6B;
+  a_key ^= a_key >> 13;
+  a_key *= 0xC2B2AE35;
+  a_key ^= a_key >> 16;
+  return a_key;
+}
+
+/// @brief A map of integer keys to values with a fixed capacity.
+/// @tparam Key is the type of keys, which must be an integer type.
+/// @tparam Value is the type of values.
+/// @tparam Capacity is the number of slots, which must be a power of 2. For
+///         short probes, it should be at least twice the number of entries.
+template <typename Key, typename Value, size_t Capacity>
+class HashMap
+{
+  static_assert(Capacity && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of 2.");
+public:
+  /// @brief Inserts a value, replacing any existing value with the same key.
+  /// @param a_key is the key to insert a_value with.
+  /// @param a_value is the value to insert.
+  /// @return Returns false if the map is full.
+  bool insert(const Key& a_key, const Value& a_value)
+  {
+    size_t index = slot(a_key);
+    for (size_t probes = 0; probes < Capacity; ++probes, index = (index + 1) & Mask)
+    {
+      if (m_used[index] && m_keys[index] != a_key)
+        continue;
+      if (!m_used[index])
+      {
+        // keep a free slot so that searching for missing keys ends
+        if (m_count + 1 >= Capacity)
+          return false;
+        m_used[index] = true;
+        m_keys[index] = a_key;
+        ++m_count;
+      }
+      m_values[index] = a_value;
+      return true;
+    }
+    return false;
+  }
+
+  /// @brief Finds the value for a key.
+  /// @param a_key is the key to find.
+  /// @return Returns a pointer to the value, or nullptr if there isn't one.
+  Value* find(const Key& a_key)
+  {
+    for (size_t index = slot(a_key); m_used[index]; index = (index + 1) & Mask)
+      if (m_keys[index] == a_key)
+        return &m_values[index];
+    return nullptr;
+  }
+
+  /// @brief Finds the value for a key.
+  /// @param a_key is the key to find.
+  /// @return Returns a pointer to the value, or nullptr if there isn't one.
+  const Value* find(const Key& a_key) const
+  {
+    return const_cast<HashMap*>(this)->find(a_key);
+  }
+
+  /// @brief Removes the value for a key.
+  /// @param a_key is the key to remove.
+  /// @return Returns false if there wasn't a value for the key.
+  bool remove(const Key& a_key)
+  {
+    size_t hole = slot(a_key);
+    for (; m_used[hole]; hole = (hole + 1) & Mask)
+      if (m_keys[hole] == a_key)
+        break;
+    if (!m_used[hole])
+      return false;
+
+    // Move back any following entries which would no longer be found
+    // past the hole, which are those whose slot isn't between the
+    // hole and where they are.
+    for (size_t next = (hole + 1) & Mask; m_used[next]; next = (next + 1) & Mask)
+    {
+      size_t home = slot(m_keys[next]);
+      if (((next - home) & Mask) >= ((next - hole) & Mask))
+      {
+        m_keys[hole] = m_keys[next];
+        m_values[hole] = m_values[next];
+        hole = next;
+      }
+    }
+    m_used[hole] = false;
+    --m_count;
+    return true;
+  }
+
+  /// @brief Removes all the entries.
+  void clear()
+  {
+    for (size_t i = 0; i < Capacity; ++i)
+      m_used[i] = false;
+    m_count = 0;
+  }
+
+  /// @brief Returns the number of entries.
+  size_t count() const
+  {
+    return m_count;
+  }
+
+private:
+  static constexpr size_t Mask = Capacity - 1;
+
+  static size_t slot(const Key& a_key)
+  {
+    return hashInteger(uint32_t(a_key)) & Mask;
+  }
+
+  Key    m_keys[Capacity];
+  Value  m_values[Capacity];
+  bool   m_used[Capacity] = {};
+  size_t m_count = 0;
+};
@@ -44,28 +44,30 @@ enum LogLevel
   LOG_ERR
 };
 
+/// @brief Maximum length of a log message including the source location, longer messages are truncated.
+static constexpr size_t LogMessageSize = 256;
+
 /// @cond document_details
 namespace details
 {
-  template <int LEVEL, size_t N1, size_t N2, typename... Ts>
+  template <int LEVEL, size_t N1, typename... Ts>
   static inline constexpr
-  void LogMessage(const char (&a_sourceFile)[N1], int a_sourceLine, const char (&a_formatString)[N2], Ts&&... a_params)
+  void LogMessage(const char (&a_sourceFile)[N1], int a_sourceLine, const FormatString<type_identity_t<Ts>...>& a_formatString, const Ts&... a_params)
   {
     k_dbg<LOGGER>("step-1\n");
     if constexpr(buildType == BuildType::Debug || LEVEL != LOG_DEBUG)
     {
-      k_dbg<LOGGER>("step-2\n");
-      const auto message = Formatter(a_formatString, a_params...);
-      k_dbg<LOGGER>("step-3: message: -%s- len: %i \n", message.c_str(), message.length());
-      auto formattedString = Formatter("{1}:{2}: {3}", a_sourceFile, a_sourceLine, message);
-      k_dbg<LOGGER>("step-4: formattedString: -%s- len: %i \n", formattedString.c_str(), formattedString.length());
-      sysLog(formattedString.c_str(), formattedString.length());
-      k_dbg<LOGGER>("step-5\n");
+      // The location and message are formatted in a single pass in to the one buffer
+      FixedBufferSink<LogMessageSize> message;
+      FormatTo(message, "{1}:{2}: ", a_sourceFile, a_sourceLine);
+      FormatTo(message, a_formatString, a_params...);
+      k_dbg<LOGGER>("step-2: message: -%s- len: %i \n", message.c_str(), message.length());
+      sysLog(message.c_str(), message.length());
       if constexpr(LEVEL == LOG_ERR)
       {
         sysAbort();
       }
-      k_dbg<LOGGER>("step-6\n");
+      k_dbg<LOGGER>("step-3\n");
     }
   }
 } // end namespace details
@@ -0,0 +1,277 @@
+///////////////////////////////////////////////////////////////////////////////
+//!
+//! @file
+//!    sort.hpp
+//!
+//! @brief
+//!    C++ Sort and Search Templates.
+//!
+//! @author
+//!    Copyright (c) 2023, John Ryland,
+//!    All rights reserved.
+//!
+//! License
+//!    BSD-2-Clause License. See included LICENSE file for details.
+//!    If LICENSE file is missing, see:
+//!    https://opensource.org/licenses/BSD-2-Clause
+//!
+//!    Other licensing terms available.
+//!    See LICENSE.Commercial for details.
+//!
+//! @details
+//!    Sorting and binary searching of arrays. The comparison is a template
+//!    parameter so it is inlined, and elements are moved as whole objects
+//!    rather than a byte at a time.
+
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+// Includes
+
+#include "integers.hpp"
+
+/// @brief Ranges this size or smaller are left to insertion sort by the introsort.
+constexpr size_t IntroSortThreshold = 16;
+
+namespace details
+{
+
+template <typename T>
+static inline constexpr
+void swapItems(T& a_first, T& a_second)
+{
+  T tmp = a_first;
+  a_first = a_second;
+  a_second = tmp;
+}
+
+template <typename T, typename Less>
+static inline constexpr
+void insertionSort(T* a_first, T* a_last, Less& a_less)
+{
+  for (T* item = a_first + 1; item < a_last; ++item)
+  {
+    T value = *item;
+    T* hole = item;
+    for (; hole > a_first && a_less(value, hole[-1]); --hole)
+      *hole = hole[-1];
+    *hole = value;
+  }
+}
+
+// Insertion sort which gives up once it has shifted more than a_limit
+// elements, returning false. The range is still a permutation of the
+// input so it can be sorted another way from there.
+template <typename T, typename Less>
+static inline constexpr
+bool partialInsertionSort(T* a_first, T* a_last, Less& a_less, size_t a_limit)
+{
+  size_t moved = 0;
+  for (T* item = a_first + 1; item < a_last; ++item)
+  {
+    if (!a_less(*item, item[-1]))
+      continue;
+    T value = *item;
+    T* hole = item;
+    for (; hole > a_first && a_less(value, hole[-1]); --hole)
+      *hole = hole[-1];
+    *hole = value;
+    moved += item - hole;
+    if (moved > a_limit)
+      return false;
+  }
+  return true;
+}
+
+template <typename T, typename Less>
+static inline constexpr
+void siftDown(T* a_items, size_t a_parent, size_t a_count, Less& a_less)
+{
+  T value = a_items[a_parent];
+  for (size_t child = 2 * a_parent + 1; child < a_count; child = 2 * a_parent + 1)
+  {
+    if (child + 1 < a_count && a_less(a_items[child], a_items[child + 1]))
+      ++child;
+    if (!a_less(value, a_items[child]))
+      break;
+    a_items[a_parent] = a_items[child];
+    a_parent = child;
+  }
+  a_items[a_parent] = value;
+}
+
+template <typename T, typename Less>
+static inline constexpr
+void heapSort(T* a_first, T* a_last, Less& a_less)
+{
+  size_t count = a_last - a_first;
+  for (size_t i = count / 2; i > 0; --i)
+    siftDown(a_first, i - 1, count, a_less);
+  for (size_t active = count - 1; active > 0; --active)
+  {
+    swapItems(a_first[0], a_first[active]);
+    siftDown(a_first, 0, active, a_less);
+  }
+}
+
+// Partitions around the median of the first, middle and last elements,
+// returning where the second part starts. The scans are bounds checked
+// so a comparison which isn't a strict weak ordering can't run off the
+// ends, it just gives a poor split.
+template <typename T, typename Less>
+static inline constexpr
+T* partition(T* a_first, T* a_last, Less& a_less)
+{
+  T* middle = a_first + (a_last - a_first) / 2;
+  if (a_less(*middle, *a_first))
+    swapItems(*middle, *a_first);
+  if (a_less(a_last[-1], *middle))
+  {
+    swapItems(a_last[-1], *middle);
+    if (a_less(*middle, *a_first))
+      swapItems(*middle, *a_first);
+  }
+  T pivot = *middle;
+  T* lo = a_first;
+  T* hi = a_last - 1;
+  for (;;)
+  {
+    while (lo <= hi && a_less(*lo, pivot))
+      ++lo;
+    while (lo <= hi && a_less(pivot, *hi))
+      --hi;
+    if (lo >= hi)
+      return lo;
+    swapItems(*lo, *hi);
+    ++lo;
+    --hi;
+  }
+}
+
+template <typename T, typename Less>
+static inline constexpr
+void introSort(T* a_first, T* a_last, size_t a_depthLimit, Less& a_less)
+{
+  while (size_t(a_last - a_first) > IntroSortThreshold)
+  {
+    T* cut = (a_depthLimit--) ? partition(a_first, a_last, a_less) : a_first;
+    // Out of depth, or a split that made no progress, gets the heap sort
+    if (cut == a_first || cut == a_last)
+    {
+      heapSort(a_first, a_last, a_less);
+      return;
+    }
+    // Recurse on the smaller part and loop on the larger to bound the stack
+    if (cut - a_first < a_last - cut)
+    {
+      introSort(a_first, cut, a_depthLimit, a_less);
+      a_first = cut;
+    }
+    else
+    {
+      introSort(cut, a_last, a_depthLimit, a_less);
+      a_last = cut;
+    }
+  }
+}
+
+} // namespace details
+
+/// @brief Checks if the items are in order.
+/// @tparam T is the type of items.
+/// @tparam Less is a callable taking two items returning true if the first goes before the second.
+/// @param a_items is the array of items to check.
+/// @param a_count is the number of items.
+/// @param a_less is the comparison to check the order with.
+/// @return Returns true if no item goes before the one preceding it.
+template <typename T, typename Less>
+static inline constexpr
+bool isSorted(const T* a_items, size_t a_count, Less a_less)
+{
+  for (size_t i = 1; i < a_count; ++i)
+    if (a_less(a_items[i], a_items[i - 1]))
+      return false;
+  return true;
+}
+
+/// @brief Sorts the items, which does not need to be stable.
+/// @details Input which is already nearly in order, such as a list which
+///          has had a few items appended, is finished with an insertion
+///          sort. Otherwise an introsort is used, a quick sort which falls
+///          back to a heap sort if the partitioning goes badly, so it is
+///          O(n log n) in the worst case and doesn't need extra memory.
+/// @tparam T is the type of items.
+/// @tparam Less is a callable taking two items returning true if the first goes before the second.
+/// @param a_items is the array of items to sort.
+/// @param a_count is the number of items.
+/// @param a_less is the comparison to sort the items by.
+template <typename T, typename Less>
+static inline constexpr
+void sort(T* a_items, size_t a_count, Less a_less)
+{
+  if (a_count < 2)
+    return;
+  // Allow about as many shifts as a pass of the introsort would take
+  if (details::partialInsertionSort(a_items, a_items + a_count, a_less, a_count))
+    return;
+  size_t depthLimit = 0;
+  for (size_t n = a_count; n > 1; n /= 2)
+    depthLimit += 2;
+  details::introSort(a_items, a_items + a_count, depthLimit, a_less);
+  details::insertionSort(a_items, a_items + a_count, a_less);
+}
+
+/// @brief Finds where an item would be inserted in to a sorted array to keep it sorted.
+/// @tparam T is the type of items.
+/// @tparam Less is a callable taking two items returning true if the first goes before the second.
+/// @param a_items is the sorted array of items to search.
+/// @param a_count is the number of items.
+/// @param a_value is the item to find the position for.
+/// @param a_less is the comparison the items are sorted by.
+/// @return Returns the index of the first item which a_value goes before, after any equal items.
+template <typename T, typename Less>
+static inline constexpr
+size_t upperBound(const T* a_items, size_t a_count, const T& a_value, Less a_less)
+{
+  size_t lo = 0;
+  size_t hi = a_count;
+  while (lo < hi)
+  {
+    size_t mid = lo + (hi - lo) / 2;
+    if (a_less(a_value, a_items[mid]))
+      hi = mid;
+    else
+      lo = mid + 1;
+  }
+  return lo;
+}
+
+/// @brief Finds an item in a sorted array.
+/// @tparam T is the type of items.
+/// @tparam Key is the type of what is being searched for.
+/// @tparam Compare is a callable taking the key and an item returning less than,
+///         equal to or greater than 0 if the key goes before, matches or goes after the item.
+/// @param a_items is the sorted array of items to search.
+/// @param a_count is the number of items.
+/// @param a_key is what to search for.
+/// @param a_compare is the comparison of the key with the items.
+/// @return Returns a pointer to the matching item, or nullptr if there isn't one.
+template <typename T, typename Key, typename Compare>
+static inline constexpr
+T* binarySearch(T* a_items, size_t a_count, const Key& a_key, Compare a_compare)
+{
+  size_t lo = 0;
+  size_t hi = a_count;
+  while (lo < hi)
+  {
+    size_t mid = lo + (hi - lo) / 2;
+    int result = a_compare(a_key, a_items[mid]);
+    if (result < 0)
+      hi = mid;
+    else if (result > 0)
+      lo = mid + 1;
+    else
+      return &a_items[mid];
+  }
+  return nullptr;
+}
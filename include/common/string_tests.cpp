@@ -26,6 +26,7 @@
 
 #include <cstdio>
 #include "string_utilities.hpp"
+#include "formatter.hpp"
 
 // For code coverage, instantiate these templates in this translation unit
 #include "array.hpp"
@@ -101,6 +102,15 @@ constexpr void run_tests()
   TEST(s.empty() == true);
   TEST(s2.empty() == false);
   TEST(s3.empty() == false);
+
+  constexpr auto f1 = Formatter("Hi {2}, you are {1}.", 42, "Bob");
+  TEST(f1.compare(to_string("Hi Bob, you are 42.")) == true);
+
+  constexpr auto f2 = Formatter("{1}{1} {2}", -7, s2);
+  TEST(f2.compare(to_string("-7-7 1234")) == true);
+
+  constexpr auto f3 = Formatter<4>("{1}", 123456);
+  TEST(f3.compare(to_string("1234")) == true);
 }
 
 consteval void run_tests_compile_time()
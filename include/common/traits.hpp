@@ -53,6 +53,10 @@ template<class T> using  remove_const_t = typename remove_const<T>::type;
 template<class T> using  remove_volatile_t = typename remove_volatile<T>::type;
 template<class T> using  remove_reference_t = typename remove_reference<T>::type;
 
+// Used to stop a parameter taking part in template argument deduction
+template<class T> struct type_identity { typedef T type; };
+template<class T> using  type_identity_t = typename type_identity<T>::type;
+
 // Integral Constants /////////////////////////////////////////////////////////
 
 template<class T, T v>
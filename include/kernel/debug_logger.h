@@ -7,6 +7,10 @@
 #pragma once
 
 #include <stdarg.h>
+#include "types.h"
+
+// Maximum number of arguments a format string can reference
+#define LOG_MAX_ARGS   8
 
 enum log_level
 {
@@ -27,6 +31,36 @@ enum log_system
   LOGGER
 };
 
+// Maximum number of modules the logger can output to
+#define LOG_MAX_SINKS  8
+
+// An output the logger writes to, resolved from a registered text display
+// or serial module. The table of these is bound once modules are initialized
+// and re-bound whenever the registered modules change.
+struct log_sink_t
+{
+  const module_t*  module;
+  log_level        min_level;   // messages below this level are not output to this sink
+  bool             enabled;
+  bool             binary;      // sent binary records (types/log_record.h) instead of text
+  void (*put_char)(const log_sink_t* sink, char ch);
+  void (*goto_xy)(const log_sink_t* sink, unsigned x, unsigned y);
+  void (*clear)(const log_sink_t* sink);
+  void (*flush)(const log_sink_t* sink);
+  void (*write)(const log_sink_t* sink, const uint8_t* data, uint32_t length);   // nullptr if binary isn't supported
+};
+
+// Sets the level filter for the sink for the given module, returns false if
+// the module isn't one of the logger's sinks
+bool k_log_set_sink_level(const module_t* module, log_level level, bool enabled = true);
+
+// Switches the sink for the given module between text and binary records.
+// Returns false if the module isn't a sink or it can't take binary data.
+bool k_log_set_sink_binary(const module_t* module, bool binary);
+
+// Gets the table of sinks, returning the number of them
+uint32_t k_log_sinks(const log_sink_t** sinks);
+
 // Use this before module initialization
 void k_log_early(log_level level, const char* str);
 
@@ -40,6 +74,40 @@ void k_log_vfmt(log_level level, const char* fmt, va_list ap);
 // a kernel only function.
 void k_log_fmt(log_level level, const char* fmt, ...);
 
+// Deferred logging records the level, tick, format pointer and raw
+// arguments in to a ring buffer without formatting anything, which is
+// cheap enough to use from within a task. The entries are formatted and
+// output later by k_log_drain(), which should be called in slack time.
+// Because only the pointer is kept, any %s arguments must still be valid
+// when drained (string literals or task names, not stack buffers).
+// CRITICAL messages are not deferred, they drain the ring and are output
+// immediately.
+void k_log_deferred(log_level level, const char* fmt, ...);
+
+// The same as k_log_deferred but moves to x,y before output
+void k_log_deferred_xy(unsigned x, unsigned y, log_level level, const char* fmt, ...);
+
+// Formats and outputs up to max_entries queued messages, returning how
+// many were output. Messages dropped since the last drain are reported.
+uint32_t k_log_drain(uint32_t max_entries = 0xFFFFFFFF);
+
+// Messages which can be queued before they are dropped, a power of 2
+#define LOG_RING_SIZE  128
+
+// True if there are queued messages waiting to be drained
+bool k_log_pending();
+
+struct log_statistics_t
+{
+  uint32_t  logged;             // number of messages queued
+  uint32_t  dropped;            // dropped because the ring was full, not yet reported
+  uint32_t  total_dropped;      // dropped and reported by k_log_drain
+  uint32_t  high_water;         // maximum number of entries queued at once
+  uint32_t  max_latency;        // maximum ticks between queuing and output
+};
+
+const log_statistics_t& k_log_statistics();
+
 // Editing the enabled systems in the if statement can
 // be used to turn on and off system specific debug logging.
 // Note that some of this logging can be quite verbose and
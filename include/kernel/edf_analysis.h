@@ -0,0 +1,56 @@
+/*
+  Real-time Scheduler
+  Copyright (c) 2023, John Ryland
+  All rights reserved.
+*/
+
+#pragma once
+
+#include "../types/time.h"
+
+// EDF Schedulability and Sensitivity Analysis
+//
+// A set of periodic tasks is schedulable by earliest deadline first if in
+// every interval [0, t] the processor demand, the exec_bounds of the jobs
+// released and due within it, is at most t. Only the deadlines up to the
+// synchronous busy period need checking, and Zhang and Burns' quick
+// processor-demand analysis (QPA) skips most of those by jumping backwards
+// from the end of the busy period straight to the demand at each step.
+//
+// On top of that test, binary searches find how much headroom a task set
+// has. The critical scaling factor is how much all the exec_bounds can be
+// multiplied by together, and the allowable exec_bound of a task is how
+// large its exec_bound can grow to with the others as they are.
+//
+// These only depend on the task parameters passed in, and don't use any
+// kernel state, so the host tools can use them too, and the analysis of
+// each task can be run on a different thread.
+
+#define EDF_SCALE_ONE          65536          // a scaling factor of 1.0
+// Intervals longer than this aren't checked, so task sets with a longer
+// busy period are treated as unschedulable
+#define EDF_MAX_INTERVAL       (1ULL << 40)
+
+// The parameters are 32-bit, which is over 11 hours even at 100 kHz, so
+// the products with the scaling factors can't overflow
+struct edf_task_t
+{
+  uint32_t  exec_bound;
+  uint32_t  period;
+  uint32_t  deadline;       // relative to the release, at most the period
+};
+
+// the processor demand of the jobs which are released and due in [0, t]
+uint64_t edf_demand(const edf_task_t* tasks, unsigned count, uint64_t t);
+
+// true if the tasks are schedulable by EDF
+bool edf_schedulable(const edf_task_t* tasks, unsigned count);
+
+// The largest factor, in EDF_SCALE_ONE units, that all of the exec_bounds
+// can be multiplied by with the tasks still schedulable. It is less than
+// EDF_SCALE_ONE if the tasks aren't schedulable as they are.
+uint32_t edf_critical_scaling_factor(const edf_task_t* tasks, unsigned count);
+
+// The largest exec_bound the task at index can have with the other tasks
+// as they are and the tasks still schedulable, or 0 if there isn't one.
+ticks_t edf_allowable_exec_bound(const edf_task_t* tasks, unsigned count, unsigned index);
@@ -0,0 +1,40 @@
+/*
+  Real-time Scheduler
+  Copyright (c) 2023, John Ryland
+  All rights reserved.
+*/
+
+#pragma once
+
+#include "schedule.h"
+
+// Elastic Scheduling
+//
+// An elastic task has a range of periods it can run at, from the period it
+// would like, min_period, to the longest it can put up with, max_period,
+// and an elasticity which is how readily it gives up utilization compared
+// to the other elastic tasks. Tasks with an elasticity of 0 are rigid.
+//
+// With elastic scheduling enabled, when admitting a task would take the
+// utilization of the periodic tasks over the limit, the elastic tasks are
+// compressed like springs, each giving up utilization in proportion to its
+// elasticity by having its period stretched, down to what it uses at its
+// max_period. A task is only rejected if the rigid tasks and the elastic
+// tasks at their max_period don't fit. When tasks are removed the elastic
+// tasks are given back what was freed, going back towards their min_period.
+
+#define ELASTIC_UTILIZATION_SCALE   65536
+// Some headroom is left for the interrupts and the scheduler's overheads
+#define ELASTIC_UTILIZATION_LIMIT   (ELASTIC_UTILIZATION_SCALE * 95 / 100)
+
+void set_elastic_scheduling(bool enabled);
+bool elastic_scheduling_enabled();
+
+// Sets the periods of the elastic tasks so that the periodic tasks fit in
+// ELASTIC_UTILIZATION_LIMIT, as close to their min_period as they can be.
+// Returns false, leaving the periods as they are, if they can't be made to fit.
+bool compress_elastic_tasks();
+
+// Sets the period an elastic task runs at, replacing its jobs which haven't
+// started. Used by compress_elastic_tasks(), which has already checked it.
+acceptance_codes set_elastic_period(task_t* task, ticks_t period);
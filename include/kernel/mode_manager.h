@@ -0,0 +1,89 @@
+/*
+  Real-time Scheduler
+  Copyright (c) 2023, John Ryland
+  All rights reserved.
+*/
+
+#pragma once
+
+#include "schedule.h"
+
+// Operating Modes
+//
+// A mode is a set of periodic tasks which run together, such as for
+// startup, nominal or degraded operation. A mode is analysed when it is
+// defined, so a mode change only has to swap the tasks over and doesn't
+// need the task set to be analysed again at the time of the switch.
+//
+// Tasks which are in both the old and new mode, with the same name and
+// parameters, are left running through a mode change. The old mode's
+// other tasks stop releasing jobs at the mode change request, and the
+// new mode's other tasks are released from a point which the protocol
+// chooses so that the old tasks' jobs and the new tasks' jobs never
+// compete, so neither mode's analysis is broken by the change.
+
+#define MAX_MODES                8
+#define MAX_MODE_TASKS           16
+#define MODE_UTILIZATION_SCALE   65536
+// Left for tasks outside of the modes, such as the online scheduler
+#define MODE_UTILIZATION_LIMIT   (MODE_UTILIZATION_SCALE * 9 / 10)
+#define NO_MODE                  0xFFFFFFFF
+
+// A periodic task of a mode, each job must complete within its period
+struct mode_task_t
+{
+  task_entry_t  func_ptr;
+  id_t          task_name;
+  id_t          wait_for;       // must be an earlier task in the mode, or one outside of the modes
+  ticks_t       exec_bound;
+  ticks_t       period;
+  const char*   name;
+  unsigned      x_pos;
+  unsigned      y_pos;
+};
+
+enum class mode_change_protocol : uint8_t
+{
+  // The new tasks are released once the old tasks' released jobs are past
+  // their deadlines, so straight after the old mode's work is done.
+  IDLE_TIME,
+  // The new tasks are released after the longest period of the old tasks,
+  // which doesn't depend on what has been released at the time.
+  MAX_PERIOD_OFFSET,
+};
+
+struct mode_analysis_t
+{
+  uint32_t      utilization;    // sum of exec_bound / period, in MODE_UTILIZATION_SCALE units
+  ticks_t       max_period;
+  bool          schedulable;
+};
+
+struct operating_mode_t
+{
+  const char*      name;
+  mode_task_t      tasks[MAX_MODE_TASKS];
+  unsigned         task_count;
+  mode_analysis_t  analysis;
+};
+
+void initialize_modes();
+
+// Defines a mode, analysing it now. Returns accepted and the mode's id in
+// mode_id if it is schedulable, otherwise why it isn't.
+acceptance_codes define_mode(const char* name, const mode_task_t* tasks, unsigned task_count, unsigned& mode_id);
+
+// Gets a defined mode, or nullptr if there isn't one with the id
+const operating_mode_t* get_mode(unsigned mode_id);
+
+// The id of the mode running, or NO_MODE before the first mode change
+unsigned current_mode();
+
+// Switches to the mode, returns when the new mode's tasks are released in
+// release_at. The first mode change just releases the mode's tasks. The
+// new mode is checked against the tasks running outside of the modes
+// first, and if the change can't be made nothing is changed. A task of
+// the new mode with the name of one which is still running, including an
+// old mode's task with other parameters which hasn't finished its last
+// job yet, is turned away with task_name_in_use.
+acceptance_codes request_mode_change(unsigned mode_id, mode_change_protocol protocol, tick_t& release_at);
@@ -12,9 +12,16 @@ void initialize_modules();
 
 bool modules_initialized();
 
+// Changes each time the set of registered modules changes, so anything
+// holding on to resolved modules can tell when it needs to look them up again
+uint32_t modules_generation();
+
 void module_register(module_t& driver);
 
 module_t const* find_module_by_class(module_class driver_type);
+
+// the module of the class with the given name, or nullptr if there isn't one
+module_t const* find_module_by_class_and_name(module_class driver_type, const char* name);
 // module_t const* find_driver_by_id(uint32_t id);
 // module_t const* find_driver_by_name(const short_name& name);
 // module_t const* find_driver_by_class_and_id(module_class driver_type,
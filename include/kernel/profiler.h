@@ -0,0 +1,55 @@
+/*
+  Real-time Scheduler
+  Copyright (c) 2023, John Ryland
+  All rights reserved.
+*/
+
+#pragma once
+
+#include "../types/integers.h"
+#include "../types/symbol.h"
+
+// Statistical Profiler
+//
+// While it is enabled, the timer's tick handler records the address it
+// interrupted in to a ring of samples for the cpu, along with whether a
+// task was running, so over many ticks the samples show where the time
+// goes. The report counts the samples by symbol, looking each up with a
+// binary search of the kernel's symbol map, as made by symbol_map_gen, so
+// it doesn't need any other tools.
+//
+// The samples are taken at the tick, so code which runs in step with the
+// ticks, such as the dispatcher waking up, is over or under represented.
+
+#define PROFILER_MAX_CPUS         1       // the kernel only runs on one cpu so far
+#define PROFILER_SAMPLES          4096    // the most recent samples kept per cpu, a power of 2
+
+struct profile_entry_t
+{
+  const char*  name;                      // not nul terminated
+  uint32_t     name_length;
+  uint32_t     samples;
+  uint32_t     task_samples;              // samples taken while a task was running
+};
+
+// starting clears the samples
+void profiler_enable(bool enable);
+
+bool profiler_enabled();
+
+// called from the timer's tick handler with the address it interrupted
+void profiler_record_sample(size_t pc, unsigned cpu);
+
+// marks when a task is running, so the samples can be split between the
+// real-time tasks and the time in between
+void profiler_task_started();
+void profiler_task_finished();
+
+// Uses a different symbol map to the one appended to the kernel, such as
+// when hosted, where load_base is subtracted from addresses before they
+// are looked up, for a map of offsets in to a relocated image.
+void profiler_set_symbol_map(const symbol_table* map, size_t load_base);
+
+// Fills in the entries with the symbols with the most samples, most first,
+// returning how many. The totals are across all the samples.
+unsigned profiler_report(profile_entry_t* entries, unsigned max_entries, uint32_t& total_samples, uint32_t& total_task_samples);
@@ -0,0 +1,92 @@
+/*
+  Real-time Scheduler
+  Copyright (c) 2023, John Ryland
+  All rights reserved.
+*/
+
+#pragma once
+
+#include "../types.h"
+#include "../types/replay_record.h"
+
+// Schedule Record and Replay
+//
+// A run of the scheduler depends on things which differ each time, the
+// random values the tasks use, how long the tasks actually run for, and
+// when tasks are added, removed or changed, so a run which missed its
+// deadlines can't simply be run again. While recording, each of these is
+// written out as it happens along with its tick, in the compact layout of
+// types/replay_record.h, and so is each dispatch of a scheduled item, and
+// the keys pressed.
+//
+// Replaying feeds a recording back through the scheduler in virtual time.
+// The ticks are set rather than counted by the timer, each request is
+// made again at the tick it was recorded at, and each task is replaced by
+// one which does nothing, with the clock moved on by the time the task
+// was recorded to have taken. The online scheduler is the real one, so
+// the same dispatches follow, as fast as the scheduler can work them out.
+// A mode change is recorded as the request for it, and not the tasks it
+// adds and ends, so the modes have to be defined as they were when it was
+// recorded before replaying, and their tasks are replaced like the rest.
+// Each dispatch is checked against the recording, and the replay stops at
+// the first which differs, so a change to the scheduler can be tested
+// against a recording of a bad run, or a regression bisected.
+//
+// The recording and replaying are done on the thread which runs the tasks.
+
+#define REPLAY_BUFFER_SIZE        4096    // records are written and read in blocks of up to this
+
+// receives the recording in pieces, in order
+typedef void (*replay_writer_t)(const void* data, uint32_t size, void* context);
+
+// reads up to size bytes of the recording, returning how many, 0 at the end
+typedef uint32_t (*replay_reader_t)(void* data, uint32_t size, void* context);
+
+struct replay_result_t
+{
+  uint32_t  dispatches;                   // items run
+  uint32_t  requests;                     // requests made again
+  uint32_t  deadline_misses;
+  bool      diverged;                     // a dispatch or a request's result differed from the recording
+  tick_t    divergence_tick;              // where the recording was up to when it diverged
+  tick_t    end_tick;
+};
+
+// Starts recording, writing the header. The tasks which are already
+// added aren't recorded, so it is started before adding any.
+bool replay_start_recording(replay_writer_t write, void* context);
+
+// writes out the records still buffered and stops
+void replay_stop_recording();
+
+bool replay_recording();
+
+bool replay_replaying();
+
+// Called by the scheduler as it starts making a request
+void replay_request_started();
+
+// Called by the scheduler after a request, with the request's arguments
+// and result in the order of its record type. Requests made while making
+// another aren't recorded, as the replay makes them again.
+void replay_record_request(replay_record_type_t type, const uint64_t* fields, unsigned field_count, const char* name);
+
+// called as a scheduled item of the task is about to run
+void replay_dispatched(const task_t* task);
+
+// Called as the task returns, before its end is noted. Replaying, this
+// makes the requests the task made and moves the clock on to when it
+// finished.
+void replay_task_ran(task_t* task);
+
+void replay_record_random(unsigned upper_bound, unsigned value);
+
+void replay_record_key(int key);
+
+// what a task being added runs, which while replaying is the stand in for
+// it, unless it is the online scheduler
+task_entry_t replay_task_entry(task_entry_t func_ptr);
+
+// Replays the recording from its start, with no tasks added and the timer
+// stopped. Returns false if it isn't a recording or it is recording.
+bool replay_schedule(replay_reader_t read, void* context, replay_result_t& result);
@@ -11,6 +11,7 @@
 
 #define UPDATE_SCHEDULE_RATE  1000   // every 1000 ticks schedule is updated
 // ie this is the event horizon
+// this is the initial rate, it is re-tuned for the task set by tune_event_horizon()
 
 // A scheduled_item is:
 //  - an aperiodic task, or
@@ -28,6 +29,14 @@ typedef struct
 // #define MAX_SCHEDULED_ITEMS    50
 #define MAX_SCHEDULED_ITEMS    4096
 
+// Hosted on Linux the tables of scheduled items are aligned to, and padded
+// out to, a 2MB huge page so they can be backed by one
+#ifdef _LINUX
+#define SCHEDULE_TABLES_ALIGNMENT   (2 * 1024 * 1024)
+#else
+#define SCHEDULE_TABLES_ALIGNMENT   64
+#endif
+
 //extern unsigned items_in_scheduled_item_list;
 //extern unsigned item_upto;
 //extern unsigned index_sorted_upto;
@@ -38,6 +47,9 @@ unsigned& get_item_upto();
 unsigned get_index_sorted_upto();
 scheduled_item_t* get_scheduled_item_list();
 
+// the memory holding all of the tables of scheduled items
+void get_schedule_tables(void*& tables, size_t& size);
+
 #define items_in_scheduled_item_list  get_items_in_scheduled_item_list()
 #define item_upto                     get_item_upto()
 #define index_sorted_upto             get_index_sorted_upto()
@@ -52,21 +64,50 @@ enum acceptance_codes
   wait_for_not_present = 3,
   can_not_be_scheduled_with_the_other_tasks = 4,
   schedule_full = 5,
-  scheduled_item_buffer_too_small = 6
+  scheduled_item_buffer_too_small = 6,
+  task_not_present = 7,
+  mode_not_defined = 8,
+  firm_constraint_invalid = 9,
+  task_name_in_use = 10
 };
 
+#define MAX_FIRM_WINDOW    32     // bits in task_t::deadline_history
+
 void initialize_scheduler();
 
 void run_scheduled_item(scheduled_item_t *item);
 
-// compares items using the earliest deadline algorithm
-int on_line_scheduled_item_cmp(const void *a, const void *b);
+// orders items using the earliest deadline algorithm, except that a task
+// which another task waits for goes before it
+static inline
+bool scheduled_item_less(const scheduled_item_t& a, const scheduled_item_t& b)
+{
+  // having to wait_for another task has precedence over earliest deadline
+  if (a.task->wait_for_task == b.task)
+    return false;
+  if (b.task->wait_for_task == a.task)
+    return true;
+  return tick_before(a.complete_not_after, b.complete_not_after);
+}
+
+// compares items using the earliest deadline algorithm, for k_qsort
+int scheduled_item_cmp(const void *a, const void *b);
 
 // order the schedule by ordering items in the scheduled item list
 void sort_schedule();
 bool add_to_scheduled_item_list(task_t *task, tick_t start_not_before, tick_t complete_not_after);
 bool convert_periodic_tasks_to_scheduled_items_upto_event_horizon(task_t *item);
 void online_scheduler();
+
+// how often the online scheduler currently runs
+ticks_t schedule_update_rate();
+
+// how far ahead periodic tasks are currently converted to scheduled items
+ticks_t event_horizon();
+
+// re-tunes the rate the online scheduler runs at and the event horizon
+// for the current task set, called when tasks are added or removed
+void tune_event_horizon();
 void kill_task();
 
 // bar representation of the scheduled tasks and how they will run
@@ -78,7 +119,8 @@ void run_on_line_scheduler();
 // save the current state of the scheduled list and its variables
 void save_schedule_list_state();
 
-// restore the state of the scheduled list and its variables
+// restore the state of the scheduled list and its variables, and the ticks
+// the tasks have been converted up to. The clock isn't restored.
 void restore_schedule_list_state();
 
 // tries to work out if there is a viable schedule
@@ -90,4 +132,57 @@ acceptance_codes request_to_add_task(void (*func_ptr)(), id_t task_name,
                                      tick_t complete_not_after, ticks_t period,
                                      const char *name, unsigned x_pos, unsigned y_pos);
 
+// as request_to_add_task, but with the times in nanoseconds, which are
+// converted to ticks at the timer's current frequency. The exec_bound and
+// start are rounded up, and the deadline and period down, so the task isn't
+// given less time than it asked for. A period which is less than a tick is
+// rejected with bound_gt_period.
+acceptance_codes request_to_add_task_ns(void (*func_ptr)(), id_t task_name,
+                                        id_t wait_for, uint64_t start_not_before_ns, uint64_t exec_bound_ns,
+                                        uint64_t complete_not_after_ns, uint64_t period_ns,
+                                        const char *name, unsigned x_pos, unsigned y_pos);
+
+// adds a periodic task which can run with any period from min_period to
+// max_period, see elastic.h. It starts at min_period unless elastic
+// scheduling has to stretch it.
+acceptance_codes request_to_add_elastic_task(void (*func_ptr)(), id_t task_name, id_t wait_for,
+                                             ticks_t exec_bound, ticks_t min_period, ticks_t max_period,
+                                             uint32_t elasticity, const char *name, unsigned x_pos, unsigned y_pos);
+
+// makes the task (m,k)-firm, so at least m of every k of its jobs must meet
+// their deadlines, the others are optional and can be skipped under
+// overload. A k of 0 makes it a hard task again.
+acceptance_codes request_set_firm_constraint(id_t task_name, unsigned m, unsigned k);
+
+// true if the task's next job could miss its deadline without breaking
+// the task's (m,k)-firm constraint, always false for hard tasks
+bool task_can_miss_deadline(const task_t* task);
+
+// removes the task and its jobs which haven't started from the schedule
+acceptance_codes request_remove_task(id_t task_name);
+
+// changes the task's parameters, replacing its jobs which haven't started.
+// For an elastic task the period is its new min_period, up to its max_period,
+// and in elastic scheduling the change is turned away, as adding a task is,
+// if the periodic tasks can't be fitted in with it.
+acceptance_codes request_update_task(id_t task_name, ticks_t period, ticks_t exec_bound, tick_t complete_not_after);
+
+// stops the task releasing any more jobs from the given tick, it is removed
+// once the jobs it has already released have run. Returns the latest deadline
+// of those jobs, which is when the task will have finished by.
+tick_t end_task_at(task_t* task, tick_t end);
+
+// The latest deadline of the task's jobs released before the given tick,
+// or the tick if there are none, which is what end_task_at() returns.
+tick_t jobs_done_by(const task_t* task, tick_t end);
+
+// end_task_at() without removing the task once it has finished, for a
+// change which might have to be undone with restore_schedule_list_state().
+// Unlike end_task_at() it isn't recorded for replaying, so it is only for
+// changes which are recorded as a whole, such as a mode change.
+void stop_task_at(task_t* task, tick_t end);
+
+// removes a stopped or removed task if its last job has run, returns true if it did
+bool retire_task_if_finished(task_t* task);
+
 
@@ -0,0 +1,36 @@
+/*
+  Real-time Scheduler
+  Copyright (c) 2023, John Ryland
+  All rights reserved.
+*/
+
+#pragma once
+
+#include "schedule.h"
+#include "task_manager.h"
+#include "edf_analysis.h"
+
+// Sensitivity Analysis
+//
+// How much headroom the periodic tasks running have, see edf_analysis.h.
+// A periodic task's jobs are due by the end of their periods.
+
+struct task_sensitivity_t
+{
+  task_t*   task;
+  ticks_t   allowable_exec_bound;   // with the other tasks as they are
+  ticks_t   slack;                  // how much its exec_bound can grow by
+};
+
+struct sensitivity_analysis_t
+{
+  bool                schedulable;
+  uint32_t            critical_scaling_factor;  // in EDF_SCALE_ONE units
+  unsigned            task_count;
+  task_sensitivity_t  tasks[MAX_TASKS];
+};
+
+// Analyses the periodic tasks in the task list. This takes a binary search
+// of demand tests for each task, so it is for planning and diagnostics,
+// not for running in a task's exec_bound.
+void analyse_task_sensitivity(sensitivity_analysis_t& analysis);
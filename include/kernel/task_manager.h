@@ -22,19 +22,30 @@ task_t* get_task_list();
 
 void initialize_tasks();
 
-bool add_task_to_schedule(task_entry_t func_ptr,
-                          id_t         task_name,
-                          id_t         wait_for,
-                          tick_t       start_not_before,
-                          ticks_t      exec_bound,
-                          tick_t       complete_not_after,
-                          ticks_t      period,
-                          const char*  name,
-                          unsigned     x_pos,
-                          unsigned     y_pos);
+// returns the new task, or nullptr if the task list is full or
+// the task it is to wait for is not present
+task_t* add_task_to_schedule(task_entry_t func_ptr,
+                             id_t         task_name,
+                             id_t         wait_for,
+                             tick_t       start_not_before,
+                             ticks_t      exec_bound,
+                             tick_t       complete_not_after,
+                             ticks_t      period,
+                             const char*  name,
+                             unsigned     x_pos,
+                             unsigned     y_pos);
+
+// frees the task's slot to be reused, any of its scheduled items must
+// already have been removed. Free slots are left in the task list with
+// a null func_ptr and a period of 0 until reused.
+void remove_task_from_schedule(task_t* task);
 
 task_t *search_for_task_in_schedule(id_t task_name);
 
 void run_task(task_t *item);
 
+// updates the task's exec time statistics after a run, for the scheduler
+// backends which run tasks themselves
+void calculate_stats(task_t *item);
+
 
@@ -0,0 +1,48 @@
+/*
+  Real-time Scheduler
+  Copyright (c) 2023, John Ryland
+  All rights reserved.
+*/
+
+#pragma once
+
+#include "../types.h"
+#include "../types/trace_event.h"
+
+// Schedule Trace Recorder
+//
+// Records the scheduler's decisions as they happen, the releases, starts
+// and finishes of the jobs, preemptions, deadline misses, skipped jobs,
+// admissions and optionally the timer's ticks, so long schedules can be
+// looked at afterwards rather than by watching the display. Each event is
+// 16 bytes with a high resolution timestamp, added to a ring per cpu which
+// keeps the most recent TRACE_EVENTS of them.
+//
+// Hosted the timestamps are from the monotonic clock, on x86 they are from
+// the TSC, its rate measured against the timer's ticks, and otherwise they
+// are ticks. A slot in the ring is taken with an atomic add, so events can
+// be recorded from interrupt or signal handlers and other threads.
+//
+// trace_dump() writes the events out in the layout of types/trace_event.h,
+// for tools/trace_export to turn in to a Chrome trace, which Perfetto's UI
+// also opens.
+
+#define TRACE_MAX_CPUS            1       // the kernel only runs on one cpu so far
+#define TRACE_EVENTS              8192    // the most recent events kept per cpu, a power of 2
+
+// receives the dump in pieces, in order
+typedef void (*trace_writer_t)(const void* data, uint32_t size, void* context);
+
+// records the events in the mask, see TRACE_DEFAULT_EVENTS, or stops for
+// 0. Starting clears the events.
+void trace_enable(uint32_t event_mask);
+
+uint32_t trace_event_mask();
+
+// task can be nullptr for events which aren't for a task
+void trace_event(trace_event_type_t type, const task_t* task, uint32_t arg);
+
+// Writes the header, tasks and events, returning the number of events.
+// Events recorded while it is dumping may not be complete, so it is best
+// to stop first.
+uint32_t trace_dump(trace_writer_t write, void* context);
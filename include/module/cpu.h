@@ -18,10 +18,30 @@ enum class cpu_register_t : uint8_t
   TSC
 };
 
+// Optional instruction set features, returned by cpu_state_vtable_t::features
+enum cpu_feature_t : uint32_t
+{
+  CPU_FEATURE_TSC   = 0x0001,
+  CPU_FEATURE_SSE2  = 0x0002,
+  CPU_FEATURE_AVX2  = 0x0004,   // only set if the OS has also enabled saving the AVX state
+  CPU_FEATURE_ERMS  = 0x0008,   // enhanced rep movsb/stosb
+};
+
+// How halt() idles the cpu. Whichever it is, halt() returns after the
+// next interrupt or timer event at the latest, so the caller checks what
+// it is waiting for in a loop around it.
+enum cpu_idle_policy_t : uint8_t
+{
+  CPU_IDLE_HALT,    // the hlt instruction, until the next interrupt, on bare metal
+  CPU_IDLE_WAIT,    // blocks until the timer's next tick, when hosted
+  CPU_IDLE_SPIN,    // returns straight away, for the lowest latency but a busy cpu
+};
+
 struct cpu_state_vtable_t
 {
   void (*initialize)();
-  void (*halt)();         // make the cpu idle until next interrupt
+  void (*halt)();         // make the cpu idle until next interrupt, see cpu_idle_policy_t
+  bool (*set_idle_policy)(cpu_idle_policy_t policy);  // false if the cpu can't idle that way
 
   void (*enable_interrupts)();
   void (*disable_interrupts)();
@@ -36,4 +56,6 @@ struct cpu_state_vtable_t
 
   uint64_t (*read_cpu_register)(cpu_register_t reg);
   void (*write_cpu_register)(cpu_register_t reg, uint64_t value);
+
+  uint32_t (*features)();  // cpu_feature_t flags of what the cpu supports
 };
@@ -0,0 +1,58 @@
+/*
+  Real-time Scheduler
+  Copyright (c) 2023, John Ryland
+  All rights reserved.
+*/
+
+#pragma once
+
+#include "../types.h"
+
+// Hardware performance counters around each run of a task, to tell a task
+// which is slow because of what it does from one which is slowed by cache
+// misses, from the other tasks evicting its data, or by being switched
+// out. From these a task's instructions per cycle and cache misses per
+// thousand instructions are worked out.
+//
+// Only hosted on Linux, with perf_event_open(). The counters are opened
+// once, for the thread which runs the tasks, and only count user space.
+// Where the user page allows it, the hardware counters are read with
+// rdpmc, which doesn't need a system call. Any counters which can't be
+// opened, such as under a hypervisor without a virtual PMU or with
+// perf_event_paranoid too high, are left out and read as 0. The context
+// switches come from getrusage() so are always counted.
+
+enum perf_counter_t : uint8_t
+{
+  PERF_CYCLES,
+  PERF_INSTRUCTIONS,
+  PERF_LLC_MISSES,
+  PERF_CONTEXT_SWITCHES,
+  PERF_COUNTER_COUNT
+};
+
+struct perf_sample_t
+{
+  uint64_t  values[PERF_COUNTER_COUNT];
+};
+
+struct task_perf_profile_t
+{
+  uint64_t  runs;
+  uint64_t  totals[PERF_COUNTER_COUNT];
+};
+
+// opens the counters for the calling thread, logging which it could open,
+// and returns false if there aren't any hardware counters
+bool initialize_perf_counters();
+
+bool perf_counter_available(perf_counter_t counter);
+
+// reads the counters, which only count up, so runs are their differences
+void read_perf_counters(perf_sample_t& sample);
+
+// adds the counts since the sample was read to the task's profile
+void account_perf_counters(const task_t* task, const perf_sample_t& before);
+
+// the profile of a task, or nullptr if it has no profile
+const task_perf_profile_t* task_perf_profile(const task_t* task);
@@ -0,0 +1,32 @@
+/*
+  Real-time Scheduler
+  Copyright (c) 2023, John Ryland
+  All rights reserved.
+*/
+
+#pragma once
+
+#include "../types.h"
+
+// Precise sleeping on the host's monotonic clock, in nanoseconds, so it
+// doesn't depend on the tick rate. The bulk of the wait is slept with an
+// absolute deadline, so time spent being woken up or pre-empted part way
+// doesn't add up, and the last part is spun so the deadline isn't
+// overshot by the host's wakeup latency. How early to stop sleeping and
+// start spinning adapts to the latencies seen.
+//
+// Only hosted on Linux, by the timer_linux and timer_linux_timerfd timers.
+
+uint64_t monotonic_ns();
+
+// sleeps until monotonic_ns() reaches deadline_ns
+void sleep_until_ns(uint64_t deadline_ns);
+
+// sleeps for the given number of nanoseconds
+void sleep_ns(uint64_t duration_ns);
+
+// measures the wakeup latency to begin with a suitable spin margin
+void calibrate_precise_sleep();
+
+// how early the sleep currently wakes up to spin the rest of the wait
+uint64_t precise_sleep_spin_margin_ns();
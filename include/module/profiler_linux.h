@@ -0,0 +1,27 @@
+/*
+  Real-time Scheduler
+  Copyright (c) 2023, John Ryland
+  All rights reserved.
+*/
+
+#pragma once
+
+#include "../types.h"
+
+// Hosted parts of the kernel's profiler, see kernel/profiler.h. The ticks
+// are signals, or with the timerfd timer a signal its thread sends to the
+// tasks' thread, so the address which was interrupted comes from the
+// signal's context.
+//
+// The symbol map isn't appended to the executable as it is for the
+// kernel, so it is loaded from RTS_SYMBOL_MAP if that is set, or else
+// from the executable's path with ".sym" added, made with:
+//   nm -n -C --defined-only rts | symbol_map_gen > rts.sym
+
+// the address the thread was at when the signal came, from the ucontext a
+// SA_SIGINFO handler is passed, or 0 if it isn't known for the host
+size_t signal_interrupted_pc(const void* ucontext);
+
+// loads the symbol map for the profiler's reports, returning false if
+// there isn't one, so the report only counts the samples
+bool load_profiler_symbol_map();
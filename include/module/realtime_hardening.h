@@ -0,0 +1,40 @@
+/*
+  Real-time Scheduler
+  Copyright (c) 2023, John Ryland
+  All rights reserved.
+*/
+
+#pragma once
+
+#include "../types.h"
+
+// Hardening of the hosted process against the host getting in the way of
+// the real-time loop. It pins the process to a CPU, so it isn't migrated,
+// locks its memory, so it isn't paged out, and prefaults the stack and
+// heap, so the first use of them doesn't take page faults. The schedule's
+// tables can also be backed by a huge page, to save on TLB misses.
+//
+// Only hosted on Linux. The settings come from the environment:
+//   RTS_CPU=n               pin to CPU n, otherwise it isn't pinned
+//   RTS_LOCK_MEMORY=0       don't lock memory
+//   RTS_STACK_PREFAULT_KB=n prefault this much of the stack
+//   RTS_HEAP_PREFAULT_KB=n  prefault this much of the heap
+//   RTS_HUGE_PAGES=1        back the schedule's tables with a huge page
+
+struct realtime_hardening_t
+{
+  int32_t   cpu;                  // -1 to leave it unpinned
+  bool      lock_memory;
+  bool      huge_pages;
+  uint32_t  stack_prefault_kb;
+  uint32_t  heap_prefault_kb;
+};
+
+// the defaults with any settings from the environment
+realtime_hardening_t realtime_hardening_settings();
+
+// applies the settings, logging how each part went
+void harden_realtime(const realtime_hardening_t& settings);
+
+// undoes what it can of harden_realtime(), for comparing with and without
+void soften_realtime();
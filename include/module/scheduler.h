@@ -55,4 +55,6 @@ struct scheduler_vtable_t
 {
   bool (*initialize)();
   task_acceptance_t (*add_task)(task_t* task);
+  // stops running a task which was added
+  void (*remove_task)(task_t* task);
 };
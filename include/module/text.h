@@ -19,4 +19,5 @@ struct text_display_vtable_t
   void (*put_char)(text_display_t*, uint8_t attrib, char ch);
   void (*put_string)(text_display_t*, uint8_t attrib, const char* str);
   void (*clear)(text_display_t*);
+  void (*flush)(text_display_t*);   // present any buffered changes to the screen
 };
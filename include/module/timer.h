@@ -49,6 +49,13 @@ void delay(ticks_t number_of_ticks, tick_t deadline = 0);
 tick_t current_tick();
 void set_current_tick(tick_t tick);
 
+// how many ticks a second the timer is currently running at
+uint32_t timer_frequency();
+
+// blocks until the timer's next tick, for idling when hosted, although it
+// can return sooner
+void wait_for_timer_event();
+
 struct timer_driver_t
 {
   const char* name;
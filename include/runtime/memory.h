@@ -13,3 +13,31 @@ void* mem_move(void* dst, const void* src, size_t len);
 void* mem_cpy(void* dst, const void* src, size_t len);
 int mem_cmp(const void* dst, const void* src, size_t len);
 void mem_swap(void* first, void* second, size_t len);
+
+// A set of implementations of the memory functions. Until
+// initialize_memory_routines() is called, portable word at a time
+// versions are used, then the best set for the cpu is selected.
+struct mem_routines_t
+{
+  const char* name;
+  void* (*set)(void* dst, int val, size_t len);
+  void* (*move)(void* dst, const void* src, size_t len);
+  int (*cmp)(const void* dst, const void* src, size_t len);
+  void (*swap)(void* first, void* second, size_t len);
+};
+
+// The portable word at a time versions
+extern const mem_routines_t mem_routines_word;
+
+// Picks the memory routines using the features reported by the cpu module
+void initialize_memory_routines();
+
+// The memory routines currently in use
+const mem_routines_t& current_memory_routines();
+
+// Makes the given memory routines the ones used, eg: for benchmarking
+void select_memory_routines(const mem_routines_t& routines);
+
+// Gets the implementations the cpu supports, from the portable one first
+// to the one expected to be fastest last. Returns how many there are.
+uint32_t supported_memory_routines(const mem_routines_t** routines, uint32_t max_routines);
@@ -10,6 +10,8 @@
 
 typedef int (*compare_t)(const void *, const void *);
 
+// The void* callback versions, common/sort.hpp has typed versions which
+// inline the comparison and are what the kernel uses
 void k_qsort(void *base, size_t nel, size_t width, compare_t compare_func);
 const void *k_bsearch(const void *key, const void *base, size_t nmemb, size_t size, compare_t compare_func);
 unsigned k_random(unsigned x);
@@ -0,0 +1,56 @@
+/*
+  Real-time Scheduler
+  Copyright (c) 2023, John Ryland
+  All rights reserved.
+*/
+
+#pragma once
+
+#include "integers.h"
+
+// Binary Log Records
+//
+// In binary logging mode, instead of formatting a message, the logger sends
+// an ID for the format string along with the raw arguments. The ID is a hash
+// of the format string, so the tools/binary_log tool can compute the same
+// IDs from the format strings in the sources and decode the records back in
+// to text.
+//
+// Each record is:
+//
+//   uint8_t    sync            LOG_RECORD_SYNC
+//   uint8_t    level           log_level, with LOG_RECORD_TRUNCATED set if the arguments didn't all fit
+//   uint8_t    length          number of bytes which follow, so unknown records can be skipped
+//   uint32_t   format_id       little endian
+//   varint     timestamp       tick the message was logged at
+//   ...        arguments       in the order of the format string:
+//                                %d %i     zig-zag varint
+//                                %x %X     varint
+//                                %c        uint8_t
+//                                %s        uint8_t length, followed by the characters (at most 64)
+//                                %f        8 bytes, little endian IEEE double
+//
+// A varint is 7 bits per byte, least significant first, with the top bit
+// set on all bytes but the last.
+//
+// A record is at most LOG_RECORD_MAX_LENGTH bytes after the header. The
+// arguments which would take it over are left out, from the first which
+// doesn't fit, and the record is marked as truncated.
+
+#define LOG_RECORD_SYNC          0xA5
+#define LOG_RECORD_HEADER_SIZE   3
+#define LOG_RECORD_MAX_LENGTH    255
+#define LOG_RECORD_TRUNCATED     0x80
+
+// FNV-1a hash of the format string
+static inline constexpr
+uint32_t log_format_id(const char* fmt)
+{
+  uint32_t hash = 0x811C9DC5;
+  while (*fmt)
+  {
+    hash ^= static_cast<uint8_t>(*fmt++);
+    hash *= 0x01000193;
+  }
+  return hash;
+}
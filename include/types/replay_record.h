@@ -0,0 +1,63 @@
+/*
+  Real-time Scheduler
+  Copyright (c) 2023, John Ryland
+  All rights reserved.
+*/
+
+#pragma once
+
+#include "integers.h"
+
+// Schedule Replay Records
+//
+// The kernel's schedule recorder (see include/kernel/replay.h) writes the
+// inputs which make one run of the scheduler differ from another in this
+// layout. A recording is a replay_header_t followed by records, each:
+//
+//   uint8_t   type            replay_record_type_t
+//   varint    tick            less the tick of the record before, or the header's start_tick
+//   uint8_t   field_count     at most REPLAY_MAX_FIELDS
+//   varint    fields          field_count of them, as listed for each type
+//   uint8_t   name_length     then the name's characters, only for the types which add a task
+//
+// A varint is 7 bits at a time, least significant first, with the top bit
+// set on every byte but the last, so most records take a few bytes. The
+// tick differences are unsigned, so they wrap like the ticks do.
+//
+// All little endian.
+
+#define REPLAY_MAGIC              0x50525452    // "RTRP"
+#define REPLAY_VERSION            1
+#define REPLAY_MAX_FIELDS         10
+#define REPLAY_NAME_LENGTH        32            // including the nul, longer names are cut short
+
+enum replay_record_type_t : uint8_t
+{
+  REPLAY_RANDOM,            // upper_bound, value
+  REPLAY_DISPATCH,          // slot, a scheduled item of the task in the slot is about to run
+  REPLAY_EXEC,              // slot, ticks ran for, at the tick it finished
+  REPLAY_ADD_TASK,          // task_name, wait_for, start_not_before, exec_bound, complete_not_after, period, x_pos, y_pos, flags, result
+  REPLAY_ADD_ELASTIC_TASK,  // task_name, wait_for, exec_bound, min_period, max_period, elasticity, x_pos, y_pos, flags, result
+  REPLAY_REMOVE_TASK,       // task_name, result
+  REPLAY_UPDATE_TASK,       // task_name, period, exec_bound, complete_not_after, result
+  REPLAY_SET_FIRM,          // task_name, m, k, result
+  REPLAY_KEY,               // key, a key pressed while it was running
+  REPLAY_END_TASK,          // task_name, end, done_by
+  REPLAY_MODE_CHANGE,       // mode_id, protocol, release_at, result
+  REPLAY_RECORD_TYPE_COUNT
+};
+
+// the flags of the records which add a task
+#define REPLAY_TASK_IS_SCHEDULER  0x1           // the task is the online scheduler
+
+struct replay_header_t
+{
+  uint32_t     magic;                   // REPLAY_MAGIC
+  uint16_t     version;                 // REPLAY_VERSION
+  uint16_t     reserved;
+  uint32_t     timer_frequency;         // ticks per second when it was recorded
+  uint32_t     reserved2;
+  uint64_t     start_tick;
+};
+
+STATIC_ASSERT(sizeof(replay_header_t) == 24);
@@ -62,6 +62,17 @@ struct task_t
   tick_t        period;
   tick_t        time_evaluated_upto;
   tick_t        saved_time_evaluated_upto;
+  task_t*       wait_for_task;      // wait_for resolved when the task is added, or nullptr
+
+  // Elastic scheduling parameters, the range period can be stretched over
+  ticks_t       min_period;
+  ticks_t       max_period;
+  uint32_t      elasticity;         // 0 for a rigid task
+
+  // (m,k)-firm constraint, at least firm_m of every firm_k jobs must meet
+  // their deadlines. A firm_k of 0 is a hard task, which can't miss any.
+  uint8_t       firm_m;
+  uint8_t       firm_k;
 
   // Statistical analysis parameters
 // task_statistics_t  stats;
@@ -74,7 +85,10 @@ struct task_t
   ticks_t       average_exec_time;
   count_t       times_called;
   count_t       deadline_failures;
-  int           padding;
+  count_t       pending_jobs;       // scheduled items of this task not yet run
+  uint32_t      deadline_history;   // a bit per recent job, most recent lowest, set if it met its deadline
+  count_t       jobs_skipped;       // optional jobs shed under overload
+  count_t       firm_violations;    // jobs after which fewer than firm_m of the last firm_k met their deadlines
 
   // Display parameters (where output is printed)
   const char*   name;
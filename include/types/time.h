@@ -8,5 +8,44 @@
 
 #include "integers.h"
 
-typedef uint32_t tick_t;
-typedef uint32_t ticks_t;
+// Ticks are 64-bit so the time doesn't wrap, even at tick rates of
+// 100 kHz and above, where 32 bits would wrap in under 12 hours.
+typedef uint64_t tick_t;
+typedef uint64_t ticks_t;
+
+#define NS_PER_SECOND   1000000000ULL
+
+// Compares ticks so that they are still ordered correctly if the tick
+// count wraps around, as long as they are within half the range of each
+// other. A tick of 0 is used to mean not set, so those need checking first.
+static inline constexpr
+bool tick_before(tick_t a, tick_t b)
+{
+  return int64_t(a - b) < 0;
+}
+
+static inline constexpr
+bool tick_after(tick_t a, tick_t b)
+{
+  return int64_t(a - b) > 0;
+}
+
+// Converts between nanoseconds and ticks at the given tick rate, splitting
+// the seconds off first so the multiplications don't overflow
+static inline constexpr
+ticks_t ns_to_ticks(uint64_t ns, uint32_t ticks_per_second)
+{
+  return (ns / NS_PER_SECOND) * ticks_per_second + (ns % NS_PER_SECOND) * ticks_per_second / NS_PER_SECOND;
+}
+
+static inline constexpr
+ticks_t ns_to_ticks_rounded_up(uint64_t ns, uint32_t ticks_per_second)
+{
+  return (ns / NS_PER_SECOND) * ticks_per_second + ((ns % NS_PER_SECOND) * ticks_per_second + NS_PER_SECOND - 1) / NS_PER_SECOND;
+}
+
+static inline constexpr
+uint64_t ticks_to_ns(ticks_t ticks, uint32_t ticks_per_second)
+{
+  return (ticks / ticks_per_second) * NS_PER_SECOND + (ticks % ticks_per_second) * NS_PER_SECOND / ticks_per_second;
+}
@@ -0,0 +1,77 @@
+/*
+  Real-time Scheduler
+  Copyright (c) 2023, John Ryland
+  All rights reserved.
+*/
+
+#pragma once
+
+#include "integers.h"
+
+// Schedule Trace Events
+//
+// The kernel's trace recorder (see include/kernel/trace.h) keeps the
+// scheduler's events in a ring per cpu, and dumps them in this layout for
+// the tools/trace_export tool to convert to the Chrome trace format.
+//
+// A dump is:
+//
+//   trace_dump_header_t
+//   trace_task_record_t    task_count of them, naming the tasks by slot
+//   trace_event_t          event_count of them, oldest first for each cpu
+//
+// All little endian.
+
+#define TRACE_DUMP_MAGIC          0x43525452    // "RTRC"
+#define TRACE_DUMP_VERSION        1
+#define TRACE_NO_TASK             0xFFFF
+#define TRACE_TASK_NAME_LENGTH    24
+
+enum trace_event_type_t : uint8_t
+{
+  TRACE_RELEASE,          // a job is due to be run, arg is the tick it was released at
+  TRACE_START,            // a task started running
+  TRACE_FINISH,           // a task finished running, arg is how many ticks it ran for
+  TRACE_PREEMPT,          // a task overran its exec_bound and was stopped
+  TRACE_DEADLINE_MISS,    // a job finished after its complete_not_after, arg is how many ticks late
+  TRACE_JOB_SKIPPED,      // a firm task's job was skipped so other jobs meet their deadlines
+  TRACE_ADMISSION,        // a task asked to be added, arg is the acceptance_codes
+  TRACE_TIMER_TICK,       // arg is the tick
+  TRACE_EVENT_TYPE_COUNT
+};
+
+#define TRACE_EVENT_MASK(type)    (1U << (type))
+#define TRACE_ALL_EVENTS          ((1U << TRACE_EVENT_TYPE_COUNT) - 1)
+// the ticks would soon fill the ring, so they are left out unless asked for
+#define TRACE_DEFAULT_EVENTS      (TRACE_ALL_EVENTS & ~TRACE_EVENT_MASK(TRACE_TIMER_TICK))
+
+struct trace_event_t
+{
+  uint64_t     timestamp;               // in trace_dump_header_t::timestamp_frequency units
+  uint8_t      type;                    // trace_event_type_t
+  uint8_t      cpu;
+  uint16_t     task;                    // slot in the task list, or TRACE_NO_TASK
+  uint32_t     arg;
+};
+
+STATIC_ASSERT(sizeof(trace_event_t) == 16);
+
+struct trace_dump_header_t
+{
+  uint32_t     magic;                   // TRACE_DUMP_MAGIC
+  uint16_t     version;                 // TRACE_DUMP_VERSION
+  uint16_t     task_count;
+  uint32_t     event_count;
+  uint32_t     lost_events;             // overwritten by newer events before the dump
+  uint64_t     timestamp_frequency;     // timestamps per second
+};
+
+// The tasks which had events, by slot. Slots are reused, so if another
+// task took the slot while tracing, it is the last which is named.
+struct trace_task_record_t
+{
+  uint16_t     slot;
+  uint16_t     reserved;
+  uint32_t     task_name;               // the task's id_t
+  char         name[TRACE_TASK_NAME_LENGTH];    // nul terminated, cut short if it is too long
+};
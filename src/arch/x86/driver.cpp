@@ -10,6 +10,8 @@
 #include "arch/x86/intrinsics.h"
 #include "arch/x86/constants.h"
 #include "kernel/exception_handler.h"
+#include "kernel/profiler.h"
+#include "kernel/trace.h"
 //#include "kernel/debug_logger.h"
 #include "kernel/module_manager.h"
 #include "module/serial.h"
@@ -29,6 +31,11 @@ test2_class_t foobar;
 */
 
 
+// The fastest the timer can be set to run, which the PIT can go well past
+#define MAX_TIMER_FREQUENCY   100000
+#define PIT_MIN_DIVISOR       (PIT_FREQUENCY / MAX_TIMER_FREQUENCY)
+
+
 // Variables
 static volatile tick_t current_tick_;   // number of ticks since timer was enabled
 static volatile unsigned int timer_speed = 0x0000;
@@ -62,7 +69,7 @@ void preemptor()
 	 (user_preempt_routine == nullptr) || (block_preemptor == true))
     return;
 
-  if (current_tick_ >= preempt_at_tick)
+  if (!tick_before(current_tick_, preempt_at_tick))
   {
     block_preemptor = true;
     // run the user function
@@ -74,13 +81,19 @@ void preemptor()
   }
 }
 
+// where the interrupt came from, for the profiler
+static
+size_t interrupted_pc = 0;
+
 static
 void timer_handler()
 {
+  profiler_record_sample(interrupted_pc, 0);
   if (installed_timer_interrupt_in_service == true)
     return;
   installed_timer_interrupt_in_service = true;
   current_tick_ = current_tick_ + 1;
+  trace_event(TRACE_TIMER_TICK, nullptr, uint32_t(current_tick_));
   preemptor();
   installed_timer_interrupt_in_service = false;
 }
@@ -355,11 +368,24 @@ void interrupt_handler(uint32_t interruptNumberOrMask)
     outportb(0xA0, 0x20); // Send EOI (End-of-interrupt) to slave PIC
 }
 
+#if defined(__i386__)
+// generic_isr calls this after pushal and pushing the interrupt number, so
+// the registers and then the return address of the interrupt follow the
+// interrupt number on the stack, where they can be taken as arguments
+extern "C"
+void _interrupt_handler(uint32_t interruptNumberOrMask, uint32_t /*edi*/, uint32_t /*esi*/, uint32_t /*ebp*/, uint32_t /*esp*/,
+                        uint32_t /*ebx*/, uint32_t /*edx*/, uint32_t /*ecx*/, uint32_t /*eax*/, uint32_t eip)
+{
+  interrupted_pc = eip;
+  interrupt_handler(interruptNumberOrMask);
+}
+#else
 extern "C"
 void _interrupt_handler(uint32_t interruptNumberOrMask)
 {
   interrupt_handler(interruptNumberOrMask);
 }
+#endif
 
 // installs a user function that will get called at the given tick
 static
@@ -435,12 +461,21 @@ void resume_timer()
   timer_not_installed_blocking = false;
 }
 
+// timer_speed is the PIT's count, which it divides its clock by, where a
+// count of 0 divides it by 65536
+static
+uint32_t pit_divisor()
+{
+  return timer_speed ? timer_speed : 0x10000;
+}
+
 // speeds up timer so current_tick updates faster
 void speed_up_timer()
 {
   //puts2(" -- speedup -- ");
   disable();
-  timer_speed = timer_speed * 2;
+  uint32_t divisor = pit_divisor() / 2;
+  timer_speed = (divisor < PIT_MIN_DIVISOR) ? PIT_MIN_DIVISOR : divisor;
   set_timer_speed(timer_speed);
   enable();
 }
@@ -450,9 +485,8 @@ void slow_down_timer()
 {
   //puts2(" -- slowdown -- ");
   disable();
-  if (timer_speed == 0)
-    timer_speed = -1;
-  timer_speed = timer_speed / 2;
+  uint32_t divisor = pit_divisor() * 2;
+  timer_speed = (divisor >= 0x10000) ? 0 : divisor;
   set_timer_speed(timer_speed);
   enable();
 }
@@ -471,17 +505,17 @@ void delay(ticks_t number_of_ticks, ticks_t /*deadline*/)
   if (timer_not_installed_blocking == true)
     k_critical_error(130, "error: cannot call delay unless timer is enabled\n");
 
-  tick_t finish_at = current_tick_ + number_of_ticks;
+  tick_t finish_at = current_tick() + number_of_ticks;
 
-  if (current_tick_ > finish_at)
+  if (tick_after(current_tick(), finish_at))
     k_critical_error(133, "error: overflow condition in delay\n");
 
   draw_tasks();
-  while (current_tick_ < finish_at)
+  while (tick_before(current_tick(), finish_at))
   {
     // wait for next tick
-    tick_t next_tick = current_tick_ + 1;
-    while (current_tick_ < next_tick)
+    tick_t next_tick = current_tick() + 1;
+    while (tick_before(current_tick(), next_tick))
       /* do nothing */ ;
 
     // update the bar view of the tasks every tick
@@ -491,13 +525,24 @@ void delay(ticks_t number_of_ticks, ticks_t /*deadline*/)
 
 tick_t current_tick()
 {
-  return current_tick_;
+  // on 32-bit CPUs the tick is read in two halves, so it is read again
+  // in case the timer interrupt updated it in between
+  tick_t tick;
+  do
+    tick = current_tick_;
+  while (tick != current_tick_);
+  return tick;
 }
 
 void set_current_tick(tick_t tick)
 {
   current_tick_ = tick;
 }
+
+uint32_t timer_frequency()
+{
+  return PIT_FREQUENCY / pit_divisor();
+}
   
 static
 timer_driver_t baremetal_timer =
@@ -46,7 +46,7 @@ test_class_t foo;
 
 void kputs(const char* s)
 {
-  k_log_fmt(SUCCESS, s);
+  k_log_fmt(SUCCESS, "%s", s);
 }
 
 /*
@@ -0,0 +1,563 @@
+/*
+  Real-time Scheduler
+  Copyright (c) 2023, John Ryland
+  All rights reserved.
+*/
+
+#ifdef ENABLE_BENCHMARKS
+
+#include <config.h>
+#include "benchmarks.h"
+#include "conio.h"
+#include "kernel/debug_logger.h"
+#include "module/timer.h"
+#include "module/cpu.h"
+#include "module_manager.h"
+#include "runtime/memory.h"
+#include "runtime/utilities.h"
+#include "kernel/schedule.h"
+#include "common/sort.hpp"
+
+#if defined(ENABLE_TIMER_LINUX) || defined(ENABLE_TIMER_LINUX_TIMERFD)
+#include "module/precise_sleep.h"
+#include <sys/resource.h>
+#endif
+
+#define BENCHMARK_TICKS     500       // how long each benchmark runs for
+
+extern void log_char(char ch);
+extern void log_char_by_lookup(char ch);
+
+// Outputs the line a character at a time for BENCHMARK_TICKS, returning the
+// rate in characters per 1000 ticks
+static
+uint32_t log_chars_rate(void (*output)(char ch), const char* line, uint32_t line_length)
+{
+  clrscr();
+  uint32_t chars = 0;
+  tick_t start = current_tick();
+  tick_t end = start + BENCHMARK_TICKS;
+  while (current_tick() < end)
+  {
+    for (uint32_t i = 0; i < line_length; ++i)
+      output(line[i]);
+    chars += line_length;
+  }
+  tick_t elapsed = current_tick() - start;
+  return uint32_t((uint64_t(chars) * 1000) / elapsed);
+}
+
+// Measures how many characters per second can be pushed through k_log_fmt
+// to all the log sinks, and a character at a time through the sink table
+// and through the per-character module lookups it replaced. The hosted
+// timers default to 1000 ticks a second, so the rates are per 1000 ticks.
+static
+void benchmark_log_throughput()
+{
+  const char* line = "The quick brown fox jumps over the lazy dog 0123456789\n";
+  uint32_t line_length = 0;
+  while (line[line_length])
+    ++line_length;
+
+  clrscr();
+  uint32_t chars = 0;
+  tick_t start = current_tick();
+  tick_t end = start + BENCHMARK_TICKS;
+  while (current_tick() < end)
+  {
+    k_log_fmt(TRACE, "%s", line);
+    chars += line_length;
+  }
+  tick_t elapsed = current_tick() - start;
+
+  uint32_t sinks_rate = log_chars_rate(log_char, line, line_length);
+  uint32_t lookup_rate = log_chars_rate(log_char_by_lookup, line, line_length);
+
+  clrscr();
+  k_log_fmt(NORMAL, "k_log_fmt throughput: %i chars per 1000 ticks (%i chars in %i ticks)\n",
+            uint32_t((uint64_t(chars) * 1000) / elapsed), chars, uint32_t(elapsed));
+  k_log_fmt(NORMAL, "  per character: %i chars per 1000 ticks with the sink table, %i looking up the modules\n",
+            sinks_rate, lookup_rate);
+}
+
+#define MEM_BENCHMARK_MAX_SIZE    (1024 * 1024)
+#define MEM_BENCHMARK_BYTES       (16 * 1024 * 1024)   // how much each size processes
+
+static
+uint8_t mem_benchmark_buffers[2][MEM_BENCHMARK_MAX_SIZE + 64];
+
+static
+uint64_t read_tsc(cpu_state_vtable_t* cpu)
+{
+  return cpu ? cpu->read_cpu_register(cpu_register_t::TSC) : 0;
+}
+
+// Reports cycles per byte times 100 of an operation, so fractions are visible
+// without needing floating point, or 0 when there is no TSC to time it with.
+#define MEM_BENCHMARK(op) \
+  { \
+    uint64_t start = read_tsc(cpu); \
+    for (uint32_t i = 0; i < iterations; ++i) \
+      op; \
+    cycles[n++] = uint32_t(((read_tsc(cpu) - start) * 100) / (uint64_t(size) * iterations)); \
+  }
+
+// Measures mem_set, mem_move, mem_cmp and mem_swap with each of the memory
+// routines the cpu supports for each power of two size from 8 bytes to 1MB.
+// The destination is offset by a byte for the unaligned move, to show the
+// cost of that.
+// Below MEM_DISPATCH_THRESHOLD the word versions are always used, so the
+// small sizes show what the dispatch is avoiding.
+static
+void benchmark_memory_routines()
+{
+  module_t const* cpu_module = find_module_by_class(module_class::CPU_STATE);
+  cpu_state_vtable_t* cpu = cpu_module ? (cpu_state_vtable_t*)cpu_module->vtable : nullptr;
+  if (!cpu || !(cpu->features() & CPU_FEATURE_TSC))
+  {
+    k_log_fmt(WARNING, "No TSC, skipping the memory routine benchmarks\n");
+    return;
+  }
+
+  const mem_routines_t& selected = current_memory_routines();
+  const mem_routines_t* routines[8];
+  uint32_t routine_count = supported_memory_routines(routines, 8);
+  uint8_t* src = mem_benchmark_buffers[0];
+  uint8_t* dst = mem_benchmark_buffers[1];
+
+  k_log_fmt(NORMAL, "Memory routines, cycles per 100 bytes (selected: %s)\n", selected.name);
+  k_log_fmt(NORMAL, "  routines size: set move unaligned-move cmp swap\n");
+  for (uint32_t r = 0; r < routine_count; ++r)
+  {
+    select_memory_routines(*routines[r]);
+    for (uint32_t size = 8; size <= MEM_BENCHMARK_MAX_SIZE; size *= 2)
+    {
+      uint32_t iterations = MEM_BENCHMARK_BYTES / size;
+      uint32_t cycles[5];
+      uint32_t n = 0;
+      MEM_BENCHMARK(mem_set(dst, int(i), size));
+      MEM_BENCHMARK(mem_move(dst, src, size));
+      MEM_BENCHMARK(mem_move(dst + 1, src, size));
+      MEM_BENCHMARK(mem_cmp(dst, dst + 32, size));
+      MEM_BENCHMARK(mem_swap(dst, src, size));
+      k_log_fmt(NORMAL, "  %s %i: %i %i %i %i %i\n", routines[r]->name, size,
+                cycles[0], cycles[1], cycles[2], cycles[3], cycles[4]);
+    }
+  }
+  select_memory_routines(selected);
+}
+
+#define SORT_BENCHMARK_ITEMS      4096
+#define SORT_BENCHMARK_RUNS       8
+
+static
+scheduled_item_t sort_benchmark_input[SORT_BENCHMARK_ITEMS];
+
+static
+scheduled_item_t sort_benchmark_items[SORT_BENCHMARK_ITEMS];
+
+static
+task_t sort_benchmark_task;
+
+enum class sort_input_t
+{
+  SORTED,
+  NEARLY_SORTED,
+  RANDOM,
+};
+
+static
+void make_sort_input(sort_input_t type)
+{
+  uint32_t seed = 1;
+  for (uint32_t i = 0; i < SORT_BENCHMARK_ITEMS; ++i)
+  {
+    seed = seed * 1103515245 + 12345;
+    scheduled_item_t& item = sort_benchmark_input[i];
+    item.task = &sort_benchmark_task;
+    item.start_not_before = i * 10;
+    item.complete_not_after = (type == sort_input_t::RANDOM) ? (seed >> 8) : i * 10 + 5;
+    item.done = false;
+  }
+  // like what the scheduler usually sorts, a few items out of place
+  if (type == sort_input_t::NEARLY_SORTED)
+    for (uint32_t i = 0; i < SORT_BENCHMARK_ITEMS; i += 64)
+      sort_benchmark_input[i].complete_not_after += 300;
+}
+
+// Measures sorting SORT_BENCHMARK_ITEMS scheduled_item_t's with the old
+// k_qsort which calls the comparison through a pointer and swaps a byte at
+// a time, against the sort template the scheduler now uses.
+static
+void benchmark_sort()
+{
+  module_t const* cpu_module = find_module_by_class(module_class::CPU_STATE);
+  cpu_state_vtable_t* cpu = cpu_module ? (cpu_state_vtable_t*)cpu_module->vtable : nullptr;
+  if (!cpu || !(cpu->features() & CPU_FEATURE_TSC))
+  {
+    k_log_fmt(WARNING, "No TSC, skipping the sort benchmarks\n");
+    return;
+  }
+
+  static const char* input_names[] = { "sorted", "nearly sorted", "random" };
+  k_log_fmt(NORMAL, "Sorting %i scheduled items, kilo-cycles per sort\n", SORT_BENCHMARK_ITEMS);
+  for (uint32_t type = 0; type < 3; ++type)
+  {
+    make_sort_input(sort_input_t(type));
+    uint64_t k_qsort_cycles = 0;
+    uint64_t sort_cycles = 0;
+    for (uint32_t run = 0; run < SORT_BENCHMARK_RUNS; ++run)
+    {
+      mem_cpy(sort_benchmark_items, sort_benchmark_input, sizeof(sort_benchmark_items));
+      uint64_t start = read_tsc(cpu);
+      k_qsort(sort_benchmark_items, SORT_BENCHMARK_ITEMS, sizeof(scheduled_item_t), scheduled_item_cmp);
+      k_qsort_cycles += read_tsc(cpu) - start;
+
+      mem_cpy(sort_benchmark_items, sort_benchmark_input, sizeof(sort_benchmark_items));
+      start = read_tsc(cpu);
+      sort(sort_benchmark_items, SORT_BENCHMARK_ITEMS, scheduled_item_less);
+      sort_cycles += read_tsc(cpu) - start;
+    }
+    k_log_fmt(NORMAL, "  %s: k_qsort %i, sort %i\n", input_names[type],
+              uint32_t(k_qsort_cycles / (SORT_BENCHMARK_RUNS * 1000)),
+              uint32_t(sort_cycles / (SORT_BENCHMARK_RUNS * 1000)));
+  }
+}
+
+#define JITTER_BENCHMARK_TICKS    1000
+
+static
+uint64_t tick_times[JITTER_BENCHMARK_TICKS + 1];
+
+// Measures how evenly spaced the timer's ticks are, by spinning on
+// current_tick() and timing when it changes with the TSC. Which timer
+// backend is measured depends on the build, so comparing backends, such
+// as the Linux signal and timerfd timers, is done by running this with
+// each of them.
+static
+void benchmark_tick_jitter()
+{
+  module_t const* cpu_module = find_module_by_class(module_class::CPU_STATE);
+  cpu_state_vtable_t* cpu = cpu_module ? (cpu_state_vtable_t*)cpu_module->vtable : nullptr;
+  if (!cpu || !(cpu->features() & CPU_FEATURE_TSC))
+  {
+    k_log_fmt(WARNING, "No TSC, skipping the tick jitter benchmark\n");
+    return;
+  }
+
+  // start on a tick boundary
+  tick_t tick = current_tick();
+  while (current_tick() == tick)
+    ;
+  tick = current_tick();
+  tick_times[0] = read_tsc(cpu);
+
+  uint32_t skipped = 0;
+  for (uint32_t i = 1; i <= JITTER_BENCHMARK_TICKS; ++i)
+  {
+    tick_t now;
+    while ((now = current_tick()) == tick)
+      ;
+    tick_times[i] = read_tsc(cpu);
+    // more than one tick at once, where ticks were late and caught up
+    if (now - tick > 1)
+      skipped++;
+    tick = now;
+  }
+
+  uint64_t mean = (tick_times[JITTER_BENCHMARK_TICKS] - tick_times[0]) / JITTER_BENCHMARK_TICKS;
+  uint64_t total_deviation = 0;
+  uint64_t max_deviation = 0;
+  for (uint32_t i = 1; i <= JITTER_BENCHMARK_TICKS; ++i)
+  {
+    uint64_t interval = tick_times[i] - tick_times[i - 1];
+    uint64_t deviation = (interval > mean) ? interval - mean : mean - interval;
+    total_deviation += deviation;
+    if (deviation > max_deviation)
+      max_deviation = deviation;
+  }
+
+  // deviations in 1/10000ths of a tick
+  k_log_fmt(NORMAL, "Tick jitter of %s over %i ticks, %i kilo-cycles per tick\n",
+            timer.name, JITTER_BENCHMARK_TICKS, uint32_t(mean / 1000));
+  k_log_fmt(NORMAL, "  mean deviation %i, max deviation %i (1/10000 tick), %i late ticks caught up\n",
+            uint32_t(total_deviation * 10000 / JITTER_BENCHMARK_TICKS / (mean ? mean : 1)),
+            uint32_t(max_deviation * 10000 / (mean ? mean : 1)), skipped);
+}
+
+#define IDLE_BENCHMARK_RELEASES   200
+#define IDLE_RELEASE_TICKS        4
+
+static
+uint64_t release_latencies[IDLE_BENCHMARK_RELEASES];
+
+// idles until the release tick, returning the TSC at when it saw it
+static
+uint64_t idle_until(cpu_state_vtable_t* cpu, tick_t release, uint32_t& wakeups)
+{
+  while (tick_before(current_tick(), release))
+  {
+    cpu->halt();
+    wakeups++;
+  }
+  return read_tsc(cpu);
+}
+
+// Measures how many times each idle policy wakes up while waiting and how
+// late after the tick it notices a release. Releases alternate between the
+// policy and spinning, which sees the ticks almost straight away, so when
+// each tick happened is taken as half way between the spinning releases
+// either side of it.
+static
+void benchmark_idle_policies()
+{
+  static const cpu_idle_policy_t policies[] = { CPU_IDLE_HALT, CPU_IDLE_WAIT, CPU_IDLE_SPIN };
+  static const char* policy_names[] = { "halt", "wait", "spin" };
+  module_t const* cpu_module = find_module_by_class(module_class::CPU_STATE);
+  cpu_state_vtable_t* cpu = cpu_module ? (cpu_state_vtable_t*)cpu_module->vtable : nullptr;
+  if (!cpu || !(cpu->features() & CPU_FEATURE_TSC) || !cpu->set_idle_policy(CPU_IDLE_SPIN))
+  {
+    k_log_fmt(WARNING, "No TSC or can't spin, skipping the idle policy benchmark\n");
+    return;
+  }
+
+  for (cpu_idle_policy_t policy : policies)
+  {
+    if (!cpu->set_idle_policy(policy))
+      continue;
+    uint32_t wakeups = 0;
+    uint32_t spin_wakeups = 0;
+    tick_t release = current_tick() + IDLE_RELEASE_TICKS;
+    cpu->set_idle_policy(CPU_IDLE_SPIN);
+    uint64_t before = idle_until(cpu, release, spin_wakeups);
+    for (uint32_t i = 0; i < IDLE_BENCHMARK_RELEASES; ++i)
+    {
+      release += IDLE_RELEASE_TICKS;
+      cpu->set_idle_policy(policy);
+      uint64_t seen = idle_until(cpu, release, wakeups);
+      release += IDLE_RELEASE_TICKS;
+      cpu->set_idle_policy(CPU_IDLE_SPIN);
+      uint64_t after = idle_until(cpu, release, spin_wakeups);
+      uint64_t expected = before + (after - before) / 2;
+      release_latencies[i] = (seen > expected) ? seen - expected : 0;
+      before = after;
+    }
+
+    sort(release_latencies, IDLE_BENCHMARK_RELEASES, [](uint64_t a, uint64_t b) { return a < b; });
+    k_log_fmt(NORMAL, "Idling by %s, %i wakeups per 100 ticks, release latency median %i, 99%% %i, max %i cycles\n",
+              policy_names[policy], wakeups * 100 / (IDLE_BENCHMARK_RELEASES * IDLE_RELEASE_TICKS),
+              uint32_t(release_latencies[IDLE_BENCHMARK_RELEASES / 2]),
+              uint32_t(release_latencies[IDLE_BENCHMARK_RELEASES * 99 / 100]),
+              uint32_t(release_latencies[IDLE_BENCHMARK_RELEASES - 1]));
+  }
+
+  // back to the first policy it supports of halt then wait
+  if (!cpu->set_idle_policy(CPU_IDLE_HALT))
+    cpu->set_idle_policy(CPU_IDLE_WAIT);
+}
+
+#if defined(ENABLE_TIMER_LINUX) || defined(ENABLE_TIMER_LINUX_TIMERFD)
+
+#define SLEEP_BENCHMARK_SLEEPS    1000
+
+static
+uint32_t sleep_overshoots[SLEEP_BENCHMARK_SLEEPS];
+
+static
+uint64_t process_cpu_ns()
+{
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return (uint64_t(usage.ru_utime.tv_sec) + uint64_t(usage.ru_stime.tv_sec)) * 1000000000
+       + (uint64_t(usage.ru_utime.tv_usec) + uint64_t(usage.ru_stime.tv_usec)) * 1000;
+}
+
+// Measures how far past their deadlines precise sleeps of a few lengths
+// wake up, and how much of the time sleeping was spent using the CPU, which
+// is mostly the spin at the end of each sleep. The CPU time is for the whole
+// process, so includes the timer's own ticks.
+static
+void benchmark_precise_sleep()
+{
+  static const uint32_t durations_us[] = { 50, 500, 2000 };
+  for (uint32_t duration_us : durations_us)
+  {
+    uint64_t start_cpu = process_cpu_ns();
+    uint64_t start = monotonic_ns();
+    for (uint32_t i = 0; i < SLEEP_BENCHMARK_SLEEPS; ++i)
+    {
+      uint64_t deadline = monotonic_ns() + uint64_t(duration_us) * 1000;
+      sleep_until_ns(deadline);
+      sleep_overshoots[i] = uint32_t(monotonic_ns() - deadline);
+    }
+    uint64_t elapsed = monotonic_ns() - start;
+    uint64_t cpu = process_cpu_ns() - start_cpu;
+
+    sort(sleep_overshoots, SLEEP_BENCHMARK_SLEEPS, [](uint32_t a, uint32_t b) { return a < b; });
+    k_log_fmt(NORMAL, "Sleeps of %ius overshoot by median %ins, 99%% %ins, max %ins, using %i%% CPU, spin margin %ins\n",
+              duration_us, sleep_overshoots[SLEEP_BENCHMARK_SLEEPS / 2],
+              sleep_overshoots[SLEEP_BENCHMARK_SLEEPS * 99 / 100], sleep_overshoots[SLEEP_BENCHMARK_SLEEPS - 1],
+              uint32_t(cpu * 100 / (elapsed ? elapsed : 1)), uint32_t(precise_sleep_spin_margin_ns()));
+  }
+}
+
+#define TICK_BENCHMARK_NS         200000000ULL   // how long each tick rate is measured for
+#define TICK_BENCHMARK_MIN_RATE   8000
+
+// Measures the cost of each tick at tick rates up to the fastest the timer
+// goes, by sleeping and seeing how much CPU time the process used handling
+// the ticks meanwhile, and how many of the ticks it got.
+static
+void benchmark_tick_overhead()
+{
+  for (;;)
+  {
+    uint32_t rate = timer_frequency();
+    if (rate >= TICK_BENCHMARK_MIN_RATE)
+    {
+      tick_t start_tick = current_tick();
+      uint64_t start_cpu = process_cpu_ns();
+      uint64_t start = monotonic_ns();
+      sleep_ns(TICK_BENCHMARK_NS);
+      uint64_t elapsed = monotonic_ns() - start;
+      uint64_t cpu = process_cpu_ns() - start_cpu;
+      uint64_t ticks = current_tick() - start_tick;
+
+      k_log_fmt(NORMAL, "At %i ticks a second, got %i ticks a second, %ins of CPU per tick, %i%% CPU\n",
+                rate, uint32_t(ticks * NS_PER_SECOND / (elapsed ? elapsed : 1)),
+                uint32_t(cpu / (ticks ? ticks : 1)), uint32_t(cpu * 100 / (elapsed ? elapsed : 1)));
+    }
+
+    // until it won't go any faster
+    timer.speed_up();
+    if (timer_frequency() == rate)
+      break;
+  }
+
+  // back to the normal rate
+  timer.disable();
+  timer.enable();
+}
+
+#endif
+
+#if defined(ENABLE_REALTIME_HARDENING_LINUX) && (defined(ENABLE_TIMER_LINUX) || defined(ENABLE_TIMER_LINUX_TIMERFD))
+
+#include "module/realtime_hardening.h"
+// the POSIX timer_t would conflict with the kernel's
+#define timer_t posix_timer_t
+#include <cstdlib>
+#undef timer_t
+
+#define HARDENING_BENCHMARK_JOBS    500
+#define HARDENING_JOB_PERIOD_NS     1000000
+#define HARDENING_JOB_BYTES         (256 * 1024)   // above malloc's default mmap threshold
+
+static
+uint32_t job_response_times[HARDENING_BENCHMARK_JOBS];
+
+static
+void run_hardening_jobs(const char* label)
+{
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  long faults = usage.ru_minflt + usage.ru_majflt;
+  uint64_t release = monotonic_ns() + HARDENING_JOB_PERIOD_NS;
+  for (uint32_t i = 0; i < HARDENING_BENCHMARK_JOBS; ++i, release += HARDENING_JOB_PERIOD_NS)
+  {
+    sleep_until_ns(release);
+    volatile uint8_t* block = (volatile uint8_t*)malloc(HARDENING_JOB_BYTES);
+    for (uint32_t offset = 0; block && offset < HARDENING_JOB_BYTES; offset += 4096)
+      block[offset] = uint8_t(i);
+    free((void*)block);
+    job_response_times[i] = uint32_t(monotonic_ns() - release);
+  }
+  getrusage(RUSAGE_SELF, &usage);
+  faults = usage.ru_minflt + usage.ru_majflt - faults;
+
+  sort(job_response_times, HARDENING_BENCHMARK_JOBS, [](uint32_t a, uint32_t b) { return a < b; });
+  k_log_fmt(NORMAL, "%s: job response median %ins, 99%% %ins, max %ins, %i page faults\n", label,
+            job_response_times[HARDENING_BENCHMARK_JOBS / 2], job_response_times[HARDENING_BENCHMARK_JOBS * 99 / 100],
+            job_response_times[HARDENING_BENCHMARK_JOBS - 1], uint32_t(faults));
+}
+
+// Measures the tail latency of periodic jobs which allocate and touch a
+// block of memory, without and then with the real-time hardening, which is
+// left applied afterwards.
+static
+void benchmark_hardening()
+{
+  soften_realtime();
+  run_hardening_jobs("Not hardened");
+  harden_realtime(realtime_hardening_settings());
+  run_hardening_jobs("Hardened");
+}
+
+#endif
+
+#ifdef ENABLE_SCHEDULER_LINUX_DEADLINE
+
+#include "module/scheduler.h"
+
+#define DEADLINE_BENCHMARK_NS     1000000000ULL
+
+static volatile uint32_t deadline_benchmark_work;
+
+static
+void deadline_benchmark_task()
+{
+  for (uint32_t i = 0; i < 1000; ++i)
+    deadline_benchmark_work = deadline_benchmark_work + i;
+}
+
+// Runs a task every other tick on a kernel deadline thread, which logs its
+// release latency when it is removed. The built-in dispatcher's is the
+// release latency of the idle policy benchmark, in cycles rather than ns.
+static
+void benchmark_deadline_scheduler()
+{
+  module_t const* module = find_module_by_class_and_name(module_class::SCHEDULER_MODULE, "sched_linux_dl");
+  if (!module)
+    return;
+  scheduler_vtable_t* scheduler = (scheduler_vtable_t*)module->vtable;
+
+  task_t task = {};
+  task.func_ptr = deadline_benchmark_task;
+  task.exec_bound = 1;
+  task.period = 2;
+  task.min_exec_time = -1;
+  task.name = "deadline benchmark";
+  task_acceptance_t result = scheduler->add_task(&task);
+  if (result != task_acceptance_t::accepted)
+  {
+    k_log_fmt(WARNING, "Deadline scheduler didn't accept the benchmark task (%i)\n", uint32_t(result));
+    return;
+  }
+  sleep_ns(DEADLINE_BENCHMARK_NS);
+  scheduler->remove_task(&task);
+  k_log_fmt(NORMAL, "  %i runs, %i deadline failures\n", task.times_called, task.deadline_failures);
+}
+
+#endif
+
+void run_benchmarks()
+{
+  k_log_fmt(SUCCESS, "Running benchmarks.\n");
+  benchmark_log_throughput();
+  benchmark_memory_routines();
+  benchmark_sort();
+  benchmark_tick_jitter();
+  benchmark_idle_policies();
+#if defined(ENABLE_TIMER_LINUX) || defined(ENABLE_TIMER_LINUX_TIMERFD)
+  benchmark_precise_sleep();
+  benchmark_tick_overhead();
+#endif
+#if defined(ENABLE_REALTIME_HARDENING_LINUX) && (defined(ENABLE_TIMER_LINUX) || defined(ENABLE_TIMER_LINUX_TIMERFD))
+  benchmark_hardening();
+#endif
+#ifdef ENABLE_SCHEDULER_LINUX_DEADLINE
+  benchmark_deadline_scheduler();
+#endif
+}
+
+#endif // ENABLE_BENCHMARKS
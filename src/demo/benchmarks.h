@@ -0,0 +1,11 @@
+/*
+  Real-time Scheduler
+  Copyright (c) 2023, John Ryland
+  All rights reserved.
+*/
+
+#pragma once
+
+// Runs the benchmarks and logs the results. These are built in to the
+// profile build (ENABLE_BENCHMARKS) and need the timer to be started.
+void run_benchmarks();
@@ -4,10 +4,33 @@
   All rights reserved.
 */
 
+#include <config.h>
 #include "helpers.h"
 #include "conio.h"
 #include "debug_logger.h"
 #include "exception_handler.h"
+#include "module_manager.h"
+#include "module/cpu.h"
+#include "kernel/mode_manager.h"
+#include "kernel/profiler.h"
+#include "kernel/replay.h"
+#include "kernel/task_manager.h"
+#include "kernel/trace.h"
+
+#ifdef ENABLE_PERF_COUNTERS_LINUX
+#include "module/perf_counters.h"
+#endif
+
+#if defined(ENABLE_TIMER_LINUX) || defined(ENABLE_TIMER_LINUX_TIMERFD)
+#define DUMP_TO_FILE
+#include "module/precise_sleep.h"
+// the POSIX timer_t would conflict with the kernel's
+#define timer_t posix_timer_t
+#include <cstdio>
+#undef timer_t
+#else
+#include "module/serial.h"
+#endif
 
 static
 unsigned status_row = 5;
@@ -72,26 +95,31 @@ void status_message(const char *message)
 
 void status_to_adding_a_task(acceptance_codes status, const char *message)
 {
-  static const char *error_msgs[6] = {
+  static const char *error_msgs[11] = {
     "task accepted",
     "exec_bound > period",
     "start + exec_bound > deadline",
     "must topologically sort requests in advance",
     "can't be scheduled with the other tasks",
-    "schedule full"
+    "schedule full",
+    "scheduled item buffer too small",
+    "task not present",
+    "mode not defined",
+    "(m,k)-firm needs 0 < m <= k <= 32",
+    "task name in use"
   };
 
+  // This can be called from within a task, so it is deferred to be
+  // output by the run loop in slack time rather than taking the time
+  // to output it now.
   if (status == accepted)
   {
-    status_message("sucessfully added: ");
-    print_str(message);
+    k_log_deferred_xy(2, status_row++, DEBUG, "sucessfully added: %s", message);
   }
   else
   {
-    status_message("couldn't add: ");
-    print_str(message);
-    status_message("  reason: ");
-    print_str(error_msgs[status]);
+    k_log_deferred_xy(2, status_row++, DEBUG, "couldn't add: %s", message);
+    k_log_deferred_xy(2, status_row++, DEBUG, "  reason: %s", error_msgs[status]);
   }
 }
 
@@ -109,6 +137,12 @@ void kill_task(void* user_data)
 {
   task_t* task = reinterpret_cast<task_t*>(user_data);
 
+  // a firm task which can miss this deadline is left to finish, the miss
+  // is recorded when it does
+  if (task_can_miss_deadline(task))
+    return;
+  trace_event(TRACE_PREEMPT, task, 0);
+
   // Allow up to 3 deadline failures, then quit if keeps happening
   //if (task->deadline_failures < 3)
   //{
@@ -146,9 +180,15 @@ void kill_task(void* user_data)
   print_str_int("   average_exec_time:         ", task->average_exec_time);
   print_str_int("   times_called:              ", task->times_called);
   print_str_int("   deadline_failures:         ", task->deadline_failures);
+  print_str_int("   jobs_skipped:              ", task->jobs_skipped);
+  print_str_int("   firm_violations:           ", task->firm_violations);
+  // so the run up to the overrun can be replayed
+  stop_recording();
   exit(134);
 }
 
+extern void flush_screen();
+
 // bar representation of the scheduled tasks and how they will run
 void draw_tasks()
 {
@@ -186,7 +226,7 @@ void draw_tasks()
       bar_end = bar_start + scheduled_item_list[item].task->exec_bound / 20;
 
       gotoxy(1, 40 + display_row);
-      k_log_fmt(NORMAL, scheduled_item_list[item].task->name);
+      k_log_fmt(NORMAL, "%s", scheduled_item_list[item].task->name);
 
       // draw it as a bar
       for (unsigned int i = bar_start; i < bar_end; i++)
@@ -216,48 +256,359 @@ void draw_tasks()
       }
     }
   }
+
+  flush_screen();
+}
+
+#define INPUT_POLL_NS   20000000ULL   // how often the keyboard is checked while idle
+
+static
+cpu_idle_policy_t _idle_policy = CPU_IDLE_SPIN;
+
+static
+const char* idle_policy_names[] = { "halt", "wait", "spin" };
+
+// moves on to the next way of idling which the cpu supports
+static
+void cycle_idle_policy(cpu_state_vtable_t* cpu)
+{
+  for (unsigned i = 1; i <= CPU_IDLE_SPIN + 1; i++)
+  {
+    cpu_idle_policy_t policy = cpu_idle_policy_t((_idle_policy + i) % (CPU_IDLE_SPIN + 1));
+    if (cpu->set_idle_policy(policy))
+    {
+      _idle_policy = policy;
+      return;
+    }
+  }
+}
+
+#define STATUS_FIRST_ROW    5
+#define STATUS_LAST_ROW     12
+
+static
+void clear_status_window()
+{
+  for (unsigned row = STATUS_FIRST_ROW; row <= STATUS_LAST_ROW; row++)
+  {
+    gotoxy(2, row);
+    k_log_fmt(DEBUG, "%s", "                                                                            ");
+  }
+}
+
+#define PROFILE_ENTRIES     (STATUS_LAST_ROW - STATUS_FIRST_ROW - 1)
+#define PROFILE_NAME_WIDTH  44
+
+static
+uint32_t percent(uint32_t part, uint32_t total)
+{
+  return total ? uint32_t(uint64_t(part) * 100 / total) : 0;
+}
+
+// The symbols the profiler sampled most, in the status window, with how
+// much of the time was in the tasks and how much was in between them. The
+// names are copied as they aren't nul terminated in the symbol map.
+static
+void draw_profile()
+{
+  static char names[PROFILE_ENTRIES][PROFILE_NAME_WIDTH + 1];
+  profile_entry_t entries[PROFILE_ENTRIES];
+  uint32_t total_samples, total_task_samples;
+  unsigned count = profiler_report(entries, PROFILE_ENTRIES, total_samples, total_task_samples);
+
+  clear_status_window();
+  unsigned row = STATUS_FIRST_ROW;
+  gotoxy(2, row++);
+  k_log_fmt(DEBUG, "%i samples, %i%% in tasks, %i%% between them", total_samples,
+            percent(total_task_samples, total_samples), percent(total_samples - total_task_samples, total_samples));
+  gotoxy(2, row++);
+  k_log_fmt(DEBUG, "symbol                                       samples    in tasks");
+  for (unsigned i = 0; i < count; i++, row++)
+  {
+    uint32_t length = entries[i].name_length < PROFILE_NAME_WIDTH ? entries[i].name_length : PROFILE_NAME_WIDTH;
+    for (uint32_t c = 0; c < length; c++)
+      names[i][c] = entries[i].name[c];
+    names[i][length] = 0;
+    gotoxy(2, row);
+    k_log_fmt(DEBUG, "%s", names[i]);
+    gotoxy(47, row);
+    k_log_fmt(DEBUG, "%i%%", percent(entries[i].samples, total_samples));
+    gotoxy(58, row);
+    k_log_fmt(DEBUG, "%i%%", percent(entries[i].task_samples, entries[i].samples));
+  }
+}
+
+// starts profiling, or stops and shows where the time went
+static
+void toggle_profiler()
+{
+  clear_status_window();
+  if (profiler_enabled())
+  {
+    profiler_enable(false);
+    draw_profile();
+    return;
+  }
+  profiler_enable(true);
+  gotoxy(2, STATUS_FIRST_ROW);
+  k_log_fmt(DEBUG, "Profiling, press 'P' again to see where the time went");
+}
+
+#define RECORDING_PATH      "rts_replay.bin"
+
+#ifdef DUMP_TO_FILE
+
+static
+FILE* recording_file = nullptr;
+
+static
+void write_dump(const void* data, uint32_t size, void* file)
+{
+  fwrite(data, 1, size, (FILE*)file);
+}
+
+static
+uint32_t read_dump(void* data, uint32_t size, void* file)
+{
+  return uint32_t(fread(data, 1, size, (FILE*)file));
+}
+
+// hosted the trace goes to a file in the working directory
+static
+void dump_trace()
+{
+  const char* path = "rts_trace.bin";
+  FILE* file = fopen(path, "wb");
+  gotoxy(2, STATUS_FIRST_ROW);
+  if (!file)
+  {
+    k_log_fmt(DEBUG, "Couldn't write the trace to %s", path);
+    return;
+  }
+  uint32_t events = trace_dump(write_dump, file);
+  fclose(file);
+  k_log_fmt(DEBUG, "Wrote %i events to %s, see tools/trace_export", events, path);
+}
+
+// hosted the recording goes to a file in the working directory, and is
+// replayed from there
+void start_recording()
+{
+  recording_file = fopen(RECORDING_PATH, "wb");
+  if (recording_file && replay_start_recording(write_dump, recording_file))
+    status_message("Recording to " RECORDING_PATH);
+  else
+    status_message("Couldn't record to " RECORDING_PATH);
+}
+
+void stop_recording()
+{
+  if (!replay_recording())
+    return;
+  replay_stop_recording();
+  fclose(recording_file);
+}
+
+void run_replay()
+{
+  FILE* file = fopen(RECORDING_PATH, "rb");
+  if (!file)
+  {
+    status_message("Couldn't open " RECORDING_PATH " to replay");
+    return;
+  }
+
+  // the replay sets the ticks itself
+  timer.disable();
+  replay_result_t result;
+  uint64_t start_ns = monotonic_ns();
+  bool replayed = replay_schedule(read_dump, file, result);
+  uint64_t elapsed_us = (monotonic_ns() - start_ns) / 1000;
+  fclose(file);
+  if (!replayed)
+  {
+    status_message(RECORDING_PATH " isn't a recording");
+    return;
+  }
+
+  gotoxy(2, STATUS_FIRST_ROW);
+  k_log_fmt(DEBUG, "Replayed %i dispatches and %i requests in %i us", result.dispatches, result.requests, uint32_t(elapsed_us));
+  gotoxy(2, STATUS_FIRST_ROW + 1);
+  k_log_fmt(DEBUG, "up to tick %i, with %i deadline misses", uint32_t(result.end_tick), result.deadline_misses);
+  gotoxy(2, STATUS_FIRST_ROW + 2);
+  if (result.diverged)
+    k_log_fmt(DEBUG, "Diverged from the recording at tick %i", uint32_t(result.divergence_tick));
+  else
+    k_log_fmt(DEBUG, "The same as the recording");
+}
+
+#else
+
+static
+void write_dump(const void* data, uint32_t size, void* context)
+{
+  const module_t* serial = (const module_t*)context;
+  for (uint32_t i = 0; i < size; i++)
+    ((serial_driver_vtable_t*)(serial->vtable))->send((serial_driver_t*)serial->instance, ((const uint8_t*)data)[i]);
+}
+
+// on the machine the trace goes to the first serial port, to be captured
+static
+void dump_trace()
+{
+  const module_t* serial = find_module_by_class(module_class::SERIAL_DRIVER);
+  gotoxy(2, STATUS_FIRST_ROW);
+  if (!serial)
+  {
+    k_log_fmt(DEBUG, "No serial port to send the trace to");
+    return;
+  }
+  uint32_t events = trace_dump(write_dump, (void*)serial);
+  k_log_fmt(DEBUG, "Sent %i events to the serial port, see tools/trace_export", events);
+}
+
+// on the machine the recording goes to the first serial port, to be
+// captured and replayed hosted
+void start_recording()
+{
+  const module_t* serial = find_module_by_class(module_class::SERIAL_DRIVER);
+  if (serial && replay_start_recording(write_dump, (void*)serial))
+    status_message("Recording to the serial port");
+  else
+    status_message("No serial port to record to");
+}
+
+void stop_recording()
+{
+  replay_stop_recording();
+}
+
+void run_replay()
+{
+  status_message("Replaying needs a hosted build, to read " RECORDING_PATH);
+}
+
+#endif
+
+// starts tracing, or stops and dumps the trace
+static
+void toggle_trace()
+{
+  clear_status_window();
+  if (trace_event_mask())
+  {
+    trace_enable(0);
+    dump_trace();
+    return;
+  }
+  trace_enable(TRACE_DEFAULT_EVENTS);
+  gotoxy(2, STATUS_FIRST_ROW);
+  k_log_fmt(DEBUG, "Tracing, press 'T' again to dump the trace");
 }
 
+#ifdef ENABLE_PERF_COUNTERS_LINUX
+
+static
+bool _show_perf_counters = false;
+
+// prints a value in hundredths with 2 decimal places, or '-' without the counters for it
+static
+void print_hundredths(unsigned x, unsigned y, bool available, uint64_t hundredths)
+{
+  gotoxy(x, y);
+  if (available)
+    k_log_fmt(DEBUG, "%i.%i%i", uint32_t(hundredths / 100), uint32_t(hundredths / 10 % 10), uint32_t(hundredths % 10));
+  else
+    k_log_fmt(DEBUG, "-");
+}
+
+// The IPC and cache miss profile of each task which has been run, in the
+// status window. The LLC misses are per thousand instructions.
+static
+void draw_perf_counters()
+{
+  clear_status_window();
+  unsigned row = STATUS_FIRST_ROW;
+  gotoxy(2, row++);
+  k_log_fmt(DEBUG, "task                 runs      IPC      LLC misses/Ki   switches/run");
+  for (unsigned i = 0; i < items_in_list && row <= STATUS_LAST_ROW; i++)
+  {
+    task_t* task = &task_list[i];
+    const task_perf_profile_t* profile = task->func_ptr ? task_perf_profile(task) : nullptr;
+    if (!profile)
+      continue;
+    uint64_t cycles = profile->totals[PERF_CYCLES];
+    uint64_t instructions = profile->totals[PERF_INSTRUCTIONS];
+    bool have_ipc = perf_counter_available(PERF_CYCLES) && perf_counter_available(PERF_INSTRUCTIONS);
+    bool have_misses = perf_counter_available(PERF_LLC_MISSES) && perf_counter_available(PERF_INSTRUCTIONS);
+
+    gotoxy(2, row);
+    k_log_fmt(DEBUG, "%s", task->name);
+    gotoxy(23, row);
+    k_log_fmt(DEBUG, "%i", uint32_t(profile->runs));
+    print_hundredths(33, row, have_ipc, cycles ? instructions * 100 / cycles : 0);
+    print_hundredths(42, row, have_misses, instructions ? profile->totals[PERF_LLC_MISSES] * 100000 / instructions : 0);
+    print_hundredths(58, row, perf_counter_available(PERF_CONTEXT_SWITCHES), profile->totals[PERF_CONTEXT_SWITCHES] * 100 / profile->runs);
+    row++;
+  }
+}
+
+#endif
+
 // sets the realtime system going
 void run_on_line_scheduler()
 {
+  module_t const* cpu_module = find_module_by_class(module_class::CPU_STATE);
+  cpu_state_vtable_t* cpu = cpu_module ? (cpu_state_vtable_t*)cpu_module->vtable : nullptr;
+  // starting from spin, the first which is supported of halt then wait
+  if (cpu)
+    cycle_idle_policy(cpu);
+
   // set timer going
   timer.enable();
+  tick_t next_input_poll = 0;
 
   for (item_upto = 0; item_upto < items_in_scheduled_item_list; item_upto++)
   {
     scheduled_item_t* item = &scheduled_item_list[item_upto];
 
     // wait till its time to run the next scheduled item
-    while (current_tick() < item->start_not_before)
+    // the screen is redrawn by the "Visualize Schedule" task
+    while (tick_before(current_tick(), item->start_not_before))
     {
+      // TODO: this is where can run non-realtime processes in this free time
+      // they will get pre-empted when the timer goes off
+      if (k_log_pending())
+        k_log_drain(4);
+      else if (cpu)
+        cpu->halt();    // until the next tick at the latest
+
+      // checking the keyboard takes system calls when hosted, which at high
+      // tick rates would take more time than the ticks, so it isn't every tick
+      if (tick_before(current_tick(), next_input_poll))
+        continue;
+      ticks_t poll_ticks = ns_to_ticks(INPUT_POLL_NS, timer_frequency());
+      next_input_poll = current_tick() + (poll_ticks ? poll_ticks : 1);
+
       gotoxy(2,4);
       print_str_int("current tick: ", current_tick());
-
-      // wait for the next tick
-      // this will call draw_tasks
-//      delay(1, item->start_not_before);
-
-      tick_t finish_at = current_tick() + 1;
-      while (current_tick() < finish_at)
+      if (cpu)
       {
-        // wait for next tick
-        
-        // wait for events
-        
-        // TODO: this is where can run non-realtime processes in this free time
-        // they will get pre-empted when the timer goes off
-        asm volatile ( "hlt" );
-
+        gotoxy(30,4);
+        k_log_fmt(DEBUG, "idle: %s \n", idle_policy_names[_idle_policy]);
       }
-
+#ifdef ENABLE_PERF_COUNTERS_LINUX
+      if (_show_perf_counters)
+        draw_perf_counters();
+#endif
 
       if (kbhit())
       {
         int ch = getch();
+        replay_record_key(ch);
         switch(ch)
         {
-          case  27: exit(0); break; // ESC
+          case  27: stop_recording(); exit(0); break; // ESC
           case 'x': k_panic(); break;
           case 'q': k_critical_error(0, "user abort"); break;
 
@@ -266,6 +617,22 @@ void run_on_line_scheduler()
           case '=': timer.speed_up(); break;
           case '_':
           case '-': timer.slow_down(); break;
+          case 'i': if (cpu) cycle_idle_policy(cpu); break;
+#ifdef ENABLE_PERF_COUNTERS_LINUX
+          case 'c': _show_perf_counters = !_show_perf_counters; clear_status_window(); break;
+#endif
+          case 'p':
+#ifdef ENABLE_PERF_COUNTERS_LINUX
+            _show_perf_counters = false;
+#endif
+            toggle_profiler();
+            break;
+          case 't':
+#ifdef ENABLE_PERF_COUNTERS_LINUX
+            _show_perf_counters = false;
+#endif
+            toggle_trace();
+            break;
           default:  break;
         }
       }
@@ -334,3 +701,39 @@ void test_adding_task_on_the_fly()
 {
   status_to_adding_a_task(request_to_add_task(test_added_on_the_fly, 6, 0, 20000, 10, 30000, 1000, "Task added on the fly", 54, 26), "task added on the fly");
 }
+
+static
+unsigned normal_mode = NO_MODE;
+
+static
+unsigned degraded_mode = NO_MODE;
+
+// The degraded mode keeps the deterministic task and runs the exponential
+// one half as often, which as it has different parameters is another task
+void define_demo_modes()
+{
+  static const mode_task_t normal_tasks[] =
+  {
+    { test_deterministic, 2, 0,  5,  200, "Deterministic",          28, 14 },
+    { test_exponential,   3, 0, 10,  700, "Exponential",            54, 14 },
+  };
+  static const mode_task_t degraded_tasks[] =
+  {
+    { test_deterministic, 2, 0,  5,  200, "Deterministic",          28, 14 },
+    { test_exponential,   7, 0, 10, 1400, "Exponential (degraded)", 54, 14 },
+  };
+  status_to_adding_a_task(define_mode("Normal", normal_tasks, 2, normal_mode), "normal mode");
+  status_to_adding_a_task(define_mode("Degraded", degraded_tasks, 2, degraded_mode), "degraded mode");
+}
+
+void start_demo_modes()
+{
+  tick_t release_at;
+  status_to_adding_a_task(request_mode_change(normal_mode, mode_change_protocol::IDLE_TIME, release_at), "change to normal mode");
+}
+
+void test_changing_mode()
+{
+  tick_t release_at;
+  status_to_adding_a_task(request_mode_change(degraded_mode, mode_change_protocol::IDLE_TIME, release_at), "change to degraded mode");
+}
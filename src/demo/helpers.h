@@ -16,8 +16,21 @@ void initialize_status();
 void status_to_adding_a_task(acceptance_codes status, const char *message);
 void status_message(const char *message);
 
+// records the run for replaying, see kernel/replay.h
+void start_recording();
+void stop_recording();
+
+// replays the recording instead of running the tasks
+void run_replay();
+
 void test_deterministic();
 void test_exponential();
 void test_binary();
 void test_added_on_the_fly();
 void test_adding_task_on_the_fly();
+
+// the demo's operating modes, the normal mode is changed to the degraded
+// one by test_changing_mode
+void define_demo_modes();
+void start_demo_modes();
+void test_changing_mode();
@@ -4,15 +4,22 @@
   All rights reserved.
 */
 
+#include <config.h>
 #include "common/formatter.hpp"
 #include "conio.h"
 #include "exception_handler.h"
 #include "helpers.h"
+#include "benchmarks.h"
 #include "kernel/schedule.h"
+#include "kernel/mode_manager.h"
 #include "kernel/task_manager.h"
 #include "kernel/debug_logger.h"
 #include "kernel/module_manager.h"
 #include "module/serial.h"
+#include "module/realtime_hardening.h"
+#include "module/perf_counters.h"
+#include "module/profiler_linux.h"
+#include "runtime/memory.h"
 #include "types/modules.h"
 
 #include "common/logger.hpp"
@@ -58,7 +65,7 @@ extern void k_sleep(int);
 extern void k_power_off();
 
 static
-void initialize_serial_ports()
+void initialize_serial_ports(bool binary_log)
 {
   int i = 0;
   const char* name[] = { "COM1", "COM2", "COM3", "COM4" };
@@ -70,6 +77,9 @@ void initialize_serial_ports()
 
     ((serial_driver_vtable_t*)(serial->vtable))->send((serial_driver_t*)serial->instance, name[i][3]);
 
+    if (binary_log)
+      k_log_set_sink_binary(serial, true);
+
     serial = serial->next;
     i++;
   }
@@ -143,6 +153,10 @@ void show_info()
   k_log_fmt(NORMAL, "  ' ' SPACE BAR pauses everything until a key is pressed\n");
   k_log_fmt(NORMAL, "  '+' '=' or UP ARROW speeds things up\n");
   k_log_fmt(NORMAL, "  '-' or DOWN ARROW slows things up\n");
+  k_log_fmt(NORMAL, "  'I' changes how the cpu idles between tasks, halt, wait or spin\n");
+  k_log_fmt(NORMAL, "  'C' shows the tasks' perf counters in the status window, if there are any\n");
+  k_log_fmt(NORMAL, "  'P' starts profiling, then again shows where the time went by function\n");
+  k_log_fmt(NORMAL, "  'T' starts tracing the schedule, then again dumps the trace\n");
   k_log_fmt(NORMAL, "\nMeaning of characters in display:\n");
   k_log_fmt(NORMAL, "  '\xb3' start_not_before\n");
   k_log_fmt(NORMAL, "  '\xba' complete_not_after\n");
@@ -236,6 +250,9 @@ static int graphics = 1;           // "vga" | "no_vga"
 static int quiet = 0;              // "quiet"
 static int hosted = 0;             // "hosted"  (running as a guest OS on some already hosted environment)
 static int no_args = 0;            // " "
+static int binary_log = 0;         // "binary_log"  (send binary log records to the serial port, see tools/binary_log)
+static int record = 0;             // "record"  (record the run for replaying, see kernel/replay.h)
+static int replay = 0;             // "replay"  (replay the recording instead of running the tasks)
 static const char* boot_entry = "none";
 
 struct arg_desc_t
@@ -253,14 +270,17 @@ static const arg_desc_t arg_descs[] =
   { "no_vga",     &graphics,     0 },
   { "quiet",      &quiet,        1 },
   { "hosted",     &hosted,       1 },
-  { " ",          &no_args,      1 }
+  { " ",          &no_args,      1 },
+  { "binary_log", &binary_log,   1 },
+  { "record",     &record,       1 },
+  { "replay",     &replay,       1 }
 };
 
 static
 void parse_arg_span(const char* arg_start, const char* arg_end)
 {
   bool found = false;
-  for (int i = 0; i < 7 && !found; i++)
+  for (size_t i = 0; i < sizeof(arg_descs) / sizeof(arg_descs[0]) && !found; i++)
   {
     if (!mem_cmp(arg_descs[i].param_str, arg_start, arg_end - arg_start))
     {
@@ -312,7 +332,7 @@ void k_log_main(log_level lvl, const char* msg)
 void sysLog(const char* str, size_t /*len*/)
 {
 //  k_log_early(ERROR, str);
-  k_log_fmt(WARNING, str);
+  k_log_fmt(WARNING, "%s", str);
 }
 
 void sysAbort()
@@ -323,7 +343,7 @@ void sysAbort()
 
 void sysFatal(const char* str)
 {
-  k_log_fmt(ERROR, str);
+  k_log_fmt(ERROR, "%s", str);
   k_power_off();
 //  k_halt();
 //  k_panic();
@@ -339,7 +359,9 @@ int __main(int argc, const char* argv[])
   k_log_main(SUCCESS, "[X] Initialized parameters.");
   initialize_modules();
   k_log_main(SUCCESS, "[X] Initialized modules.");
-  initialize_serial_ports();
+  initialize_memory_routines();
+  k_log_main(SUCCESS, "[X] Initialized memory routines.");
+  initialize_serial_ports(binary_log);
   k_log_main(SUCCESS, "[X] Initialized serial ports.");
   initialize_conio();
   k_log_main(SUCCESS, "[X] Initialized console.");
@@ -353,6 +375,22 @@ int __main(int argc, const char* argv[])
   k_log_fmt(SUCCESS, "[X] Initialized PCIE.\n");
   dump_memorymap();
   k_log_fmt(SUCCESS, "[X] Dumped memory map.\n");
+#ifdef ENABLE_REALTIME_HARDENING_LINUX
+  // before the timer's thread is started, so it inherits the CPU affinity
+  harden_realtime(realtime_hardening_settings());
+  k_log_fmt(SUCCESS, "[X] Hardened for real-time.\n");
+#endif
+#ifdef ENABLE_PERF_COUNTERS_LINUX
+  // the tasks are run on this thread, which the counters are for
+  if (initialize_perf_counters())
+    k_log_fmt(SUCCESS, "[X] Initialized perf counters.\n");
+  else
+    k_log_fmt(WARNING, "[ ] No hardware perf counters, only the tasks' context switches are profiled.\n");
+#endif
+#ifdef ENABLE_PROFILER_LINUX
+  // without a symbol map, the samples are still counted
+  load_profiler_symbol_map();
+#endif
 
 /*
   sysLog("this is a sys log\n", 0);
@@ -385,6 +423,15 @@ int __main(int argc, const char* argv[])
   // enables interrupts
   start_timer();
 
+#ifdef ENABLE_BENCHMARKS
+  run_benchmarks();
+  if (!quiet)
+  {
+    k_log_fmt(NORMAL, "\nPress any key to continue.\n");
+    wait_for_keypress();
+  }
+#endif
+
   if (!quiet)
     show_info();
 
@@ -405,9 +452,23 @@ int __main(int argc, const char* argv[])
 
   initialize_tasks();
   initialize_scheduler();
+  initialize_modes();
   initialize_status();
   initialize_timer_driver();
 
+  // before replaying too, as the recording has the mode changes but not the modes
+  define_demo_modes();
+
+  if (replay)
+  {
+    // the recording adds the tasks it had
+    run_replay();
+    wait_for_keypress();
+    return 0;
+  }
+  if (record)
+    start_recording();
+
   // draw_tasks();  // should make this a task
 
   //                                                                       wait for   start after
@@ -420,10 +481,11 @@ int __main(int argc, const char* argv[])
   status_to_adding_a_task(request_to_add_task(test_deterministic,         10, 0,     0, 100,     0,                       50,     "unaccept test1",  2, 14), "task with exec_bound > period");
   status_to_adding_a_task(request_to_add_task(draw_tasks,                  1, 0,     0,  10,     0,                       50, "Visualize Schedule",  2, 14), "visualize schedule");
   // This task shouldn't be accepted because the exec_bound of 50 can't be added between draw_tasks tasks which are every 50 ticks
-  status_to_adding_a_task(request_to_add_task(test_deterministic,          2, 0,     0,   5,     0,                      200,      "Deterministic", 28, 14), "deterministic");
-  status_to_adding_a_task(request_to_add_task(test_exponential,            3, 0,     0,  10,     0,                      700,        "Exponential", 54, 14), "exponential");
+  // the deterministic and exponential tasks are those of the modes
+  start_demo_modes();
   status_to_adding_a_task(request_to_add_task(test_binary,                 4, 0,     0,  10,     0,                      500,             "Binary",  2, 26), "binary");
   status_to_adding_a_task(request_to_add_task(test_adding_task_on_the_fly, 5, 0, 10000,   5, 10500,                        0,  "Exec another task", 28, 26), "on the fly task");
+  status_to_adding_a_task(request_to_add_task(test_changing_mode,          8, 0, 40000,   5, 40500,                        0,        "Change mode", 28, 26), "mode change task");
 
   start_timer();
 
@@ -6,84 +6,347 @@
 
 #include "module/text.h"
 #include "module/serial.h"
+#include "module/timer.h"
 #include "module_manager.h"
 #include "debug_logger.h"
+#include "types/log_record.h"
 #include <stdarg.h>
 
 static char attrib;
+static log_level current_level = TRACE;
 
-static bool both = true;
+#define   DARK                0x08
+#define   LIGHT               0x07
+#define   BOLD                0x0F
+#define   GREEN               0x0A
+#define   YELLOW              0x0E
+#define   RED                 0x04
+#define   BRIGHT_RED          0x0C
 
-// static
-void log_char(char ch1)
+static
+void set_attrib(log_level level)
 {
-  if (!modules_initialized())
-    return;
+  current_level = level;
+  switch (level)
+  {
+    case TRACE:    attrib = DARK;   break;
+    case DEBUG:    attrib = LIGHT;  break;
+    case NORMAL:   attrib = BOLD;   break;
+    case SUCCESS:  attrib = GREEN;  break;
+    case WARNING:  attrib = YELLOW; break;
+    case ERROR:    attrib = RED;    break;
+    case CRITICAL: attrib = BRIGHT_RED; break;
+  }
+}
+
+// Sinks
+//
+// The modules the logger outputs to are resolved in to this table once,
+// rather than looking them up and casting for every character. It is
+// re-bound when the registered modules change.
+
+static log_sink_t log_sinks[LOG_MAX_SINKS];
+static uint32_t log_sink_count = 0;
+static uint32_t log_sinks_generation = 0;
+
+static
+void text_put_char(const log_sink_t* sink, char ch)
+{
+  ((text_display_vtable_t*)sink->module->vtable)->put_char((text_display_t*)sink->module->instance, attrib, ch);
+}
+
+static
+void text_goto_xy(const log_sink_t* sink, unsigned x, unsigned y)
+{
+  ((text_display_vtable_t*)sink->module->vtable)->goto_xy((text_display_t*)sink->module->instance, x, y);
+}
+
+static
+void text_clear(const log_sink_t* sink)
+{
+  ((text_display_vtable_t*)sink->module->vtable)->clear((text_display_t*)sink->module->instance);
+}
+
+static
+void text_flush(const log_sink_t* sink)
+{
+  ((text_display_vtable_t*)sink->module->vtable)->flush((text_display_t*)sink->module->instance);
+}
+
+static
+void serial_send(const log_sink_t* sink, char ch)
+{
+  ((serial_driver_vtable_t*)sink->module->vtable)->send((serial_driver_t*)sink->module->instance, (uint8_t)ch);
+}
+
+static
+void serial_write(const log_sink_t* sink, const uint8_t* data, uint32_t length)
+{
+  for (uint32_t i = 0; i < length; ++i)
+    serial_send(sink, data[i]);
+}
+
+static
+void serial_send_str(const log_sink_t* sink, const char* str)
+{
+  while (*str)
+    serial_send(sink, *str++);
+}
+
+static
+void serial_send_number(const log_sink_t* sink, unsigned val)
+{
+  char buf[12];
+  char* ptr = buf + 11;
+  *ptr = 0;
+  do {
+    *(--ptr) = '0' + (val % 10);
+  } while (val /= 10);
+  serial_send_str(sink, ptr);
+}
 
-  if (both) // TODO: need some more logic here, we could have VT (virtual terminals) where this buffers to
+static
+void serial_put_char(const log_sink_t* sink, char ch1)
+{
+  unsigned char ch = static_cast<unsigned char>(ch1);
+  // These are each 3-bytes in utf-8 (but were a single byte in old DOS code-page / ROM font)
+  const char* charLUT = "│┤╡╢╖╕╣║╗╝╜╛┐└┴┬├─┼╞╟╚╔╩╦╠═╬╧╨╤╥╙╘╒╓╫╪┘┌";
+  if (ch >= 0xB3 && ch <= 0xDA)
   {
-    module_t const* text_display_module = find_module_by_class(module_class::TEXT_DISPLAY);
-    text_display_t*        text_display_data = (text_display_t*)text_display_module->instance;
-    text_display_vtable_t* text_display_functions = (text_display_vtable_t*)text_display_module->vtable;
-    text_display_functions->put_char(text_display_data, attrib, ch1);
+    // This translation logic to escape codes belongs in some kind of TTY driver code (tty logic in both directions, encode and decode, independant of the device)
+    ch -= 0xB3;
+    serial_send(sink, charLUT[ch*3+0]);
+    serial_send(sink, charLUT[ch*3+1]);
+    serial_send(sink, charLUT[ch*3+2]);
   }
+  else if (ch == 0xDB)
+  {
+    serial_send(sink, "▇"[0]);
+  }
+  else
+  {
+    serial_send(sink, ch);
+  }
+}
+
+// send control codes to serial monitor
+static
+void serial_goto_xy(const log_sink_t* sink, unsigned x, unsigned y)
+{
+  serial_send_str(sink, "\033[");
+  serial_send_number(sink, y + 1);
+  serial_send(sink, ';');
+  serial_send_number(sink, x + 1);
+  serial_send(sink, 'H');
+}
+
+static
+void serial_clear(const log_sink_t* sink)
+{
+  serial_send_str(sink, "\033c");
+}
+
+static
+void serial_flush(const log_sink_t*)
+{
+}
 
-  // send to serial monitor
-  const module_t* serial = find_module_by_class(module_class::SERIAL_DRIVER);
-  if (serial) // TODO: We need some kind of kernel parameters/config to say which device is the debug serial device
+// the table before it was last re-bound, to keep the settings of its modules
+static log_sink_t previous_sinks[LOG_MAX_SINKS];
+static uint32_t previous_sink_count = 0;
+
+static
+void add_sink(const module_t* module, bool enabled,
+              void (*put_char)(const log_sink_t*, char),
+              void (*goto_xy)(const log_sink_t*, unsigned, unsigned),
+              void (*clear)(const log_sink_t*),
+              void (*flush)(const log_sink_t*),
+              void (*write)(const log_sink_t*, const uint8_t*, uint32_t))
+{
+  if (log_sink_count >= LOG_MAX_SINKS)
+    return;
+
+  log_sink_t& sink = log_sinks[log_sink_count++];
+  sink.module = module;
+  sink.min_level = TRACE;
+  sink.enabled = enabled;
+  sink.binary = false;
+  // registering modules moves the others along the table, so the settings
+  // from before it was re-bound are found by the module
+  for (uint32_t i = 0; i < previous_sink_count; ++i)
   {
-    unsigned char ch = static_cast<unsigned char>(ch1);
-    // These are each 3-bytes in utf-8 (but were a single byte in old DOS code-page / ROM font)
-    const char* charLUT = "│┤╡╢╖╕╣║╗╝╜╛┐└┴┬├─┼╞╟╚╔╩╦╠═╬╧╨╤╥╙╘╒╓╫╪┘┌";
-    if (ch >= 0xB3 && ch <= 0xDA)
+    if (previous_sinks[i].module == module)
     {
-      // This translation logic to escape codes belongs in some kind of TTY driver code (tty logic in both directions, encode and decode, independant of the device)
-      ch -= 0xB3;
-      char c1 = charLUT[ch*3+0];
-      char c2 = charLUT[ch*3+1];
-      char c3 = charLUT[ch*3+2];
-      ((serial_driver_vtable_t*)(serial->vtable))->send((serial_driver_t*)serial->instance, (uint8_t)c1);
-      ((serial_driver_vtable_t*)(serial->vtable))->send((serial_driver_t*)serial->instance, (uint8_t)c2);
-      ((serial_driver_vtable_t*)(serial->vtable))->send((serial_driver_t*)serial->instance, (uint8_t)c3);
+      sink.min_level = previous_sinks[i].min_level;
+      sink.enabled = previous_sinks[i].enabled;
+      sink.binary = previous_sinks[i].binary;
+      break;
     }
-    else if (ch == 0xDB)
+  }
+  sink.put_char = put_char;
+  sink.goto_xy = goto_xy;
+  sink.clear = clear;
+  sink.flush = flush;
+  sink.write = write;
+}
+
+static
+void bind_sinks()
+{
+  for (uint32_t i = 0; i < log_sink_count; ++i)
+    previous_sinks[i] = log_sinks[i];
+  previous_sink_count = log_sink_count;
+  log_sink_count = 0;
+
+  // Every text display is a sink, but only the first serial port is used by
+  // default, the others can be enabled with k_log_set_sink_level.
+  // TODO: We need some kind of kernel parameters/config to say which device is the debug serial device
+  for (const module_t* module = find_module_by_class(module_class::TEXT_DISPLAY); module; module = module->next)
+    add_sink(module, true, text_put_char, text_goto_xy, text_clear, text_flush, nullptr);
+  bool first = true;
+  for (const module_t* module = find_module_by_class(module_class::SERIAL_DRIVER); module; module = module->next)
+  {
+    add_sink(module, first, serial_put_char, serial_goto_xy, serial_clear, serial_flush, serial_write);
+    first = false;
+  }
+
+  for (uint32_t i = log_sink_count; i < LOG_MAX_SINKS; ++i)
+    log_sinks[i].module = nullptr;
+
+  log_sinks_generation = modules_generation();
+}
+
+// returns false if the modules are not ready to be logged to yet
+static inline
+bool check_sinks()
+{
+  if (!modules_initialized())
+    return false;
+  if (log_sinks_generation != modules_generation())
+    bind_sinks();
+  return true;
+}
+
+bool k_log_set_sink_level(const module_t* module, log_level level, bool enabled)
+{
+  if (!check_sinks())
+    return false;
+  for (uint32_t i = 0; i < log_sink_count; ++i)
+  {
+    if (log_sinks[i].module == module)
     {
-      ((serial_driver_vtable_t*)(serial->vtable))->send((serial_driver_t*)serial->instance, (uint8_t)"▇"[0]);
+      log_sinks[i].min_level = level;
+      log_sinks[i].enabled = enabled;
+      return true;
     }
-    else
+  }
+  return false;
+}
+
+bool k_log_set_sink_binary(const module_t* module, bool binary)
+{
+  if (!check_sinks())
+    return false;
+  for (uint32_t i = 0; i < log_sink_count; ++i)
+  {
+    if (log_sinks[i].module == module && log_sinks[i].write)
     {
-      ((serial_driver_vtable_t*)(serial->vtable))->send((serial_driver_t*)serial->instance, (uint8_t)ch);
+      log_sinks[i].binary = binary;
+      return true;
     }
   }
+  return false;
 }
 
-void clear_screen()
+uint32_t k_log_sinks(const log_sink_t** sinks)
+{
+  if (!check_sinks())
+    return 0;
+  *sinks = log_sinks;
+  return log_sink_count;
+}
+
+// sinks in binary mode are sent records instead of characters
+static inline
+bool is_text_sink(const log_sink_t& sink)
+{
+  return sink.enabled && !sink.binary;
+}
+
+// static
+void log_char(char ch)
+{
+  if (!check_sinks())
+    return;
+
+  for (uint32_t i = 0; i < log_sink_count; ++i)
+  {
+    const log_sink_t& sink = log_sinks[i];
+    if (is_text_sink(sink) && current_level >= sink.min_level)
+      sink.put_char(&sink, ch);
+  }
+}
+
+#ifdef ENABLE_BENCHMARKS
+// The way log_char() used to output, looking up the first text display and
+// serial port and casting their vtables for every character. This is only
+// kept so that benchmark_log_throughput() can compare it with the sinks.
+void log_char_by_lookup(char ch)
 {
+  if (!modules_initialized())
+    return;
+
   module_t const* text_display_module = find_module_by_class(module_class::TEXT_DISPLAY);
-  text_display_t*        text_display_data = (text_display_t*)text_display_module->instance;
-  text_display_vtable_t* text_display_functions = (text_display_vtable_t*)text_display_module->vtable;
-  text_display_functions->clear(text_display_data);
+  if (text_display_module)
+  {
+    text_display_t*        text_display_data = (text_display_t*)text_display_module->instance;
+    text_display_vtable_t* text_display_functions = (text_display_vtable_t*)text_display_module->vtable;
+    text_display_functions->put_char(text_display_data, attrib, ch);
+  }
+
+  module_t const* serial = find_module_by_class(module_class::SERIAL_DRIVER);
+  if (serial)
+  {
+    log_sink_t sink;
+    sink.module = serial;
+    serial_put_char(&sink, ch);
+  }
+}
+#endif
+
+void clear_screen()
+{
+  if (!check_sinks())
+    return;
 
-  // send control codes to serial monitor
-  both = false;
-  log_char('\033');
-  log_char('c');
- // k_log_fmt(TRACE, "\\033[2J");
-  both = true;
+  for (uint32_t i = 0; i < log_sink_count; ++i)
+    if (is_text_sink(log_sinks[i]))
+      log_sinks[i].clear(&log_sinks[i]);
 }
 
 //static
 void goto_xy(unsigned x, unsigned y)
 {
-  module_t const* text_display_module = find_module_by_class(module_class::TEXT_DISPLAY);
-  text_display_t*        text_display_data = (text_display_t*)text_display_module->instance;
-  text_display_vtable_t* text_display_functions = (text_display_vtable_t*)text_display_module->vtable;
-  text_display_functions->goto_xy(text_display_data, x, y);
+  if (!check_sinks())
+    return;
+
+  for (uint32_t i = 0; i < log_sink_count; ++i)
+    if (is_text_sink(log_sinks[i]))
+      log_sinks[i].goto_xy(&log_sinks[i], x, y);
+
+  // putch after moving has always drawn in the TRACE colour
+  set_attrib(TRACE);
+}
+
+// present anything drawn since the last flush
+void flush_screen()
+{
+  if (!check_sinks())
+    return;
 
-  // send control codes to serial monitor
-  both = false;
-  k_log_fmt(TRACE, "\033[%i;%iH", y + 1, x + 1);
-  both = true;
+  for (uint32_t i = 0; i < log_sink_count; ++i)
+    if (is_text_sink(log_sinks[i]))
+      log_sinks[i].flush(&log_sinks[i]);
 }
 
 static
@@ -120,44 +383,75 @@ void log_float(double number)
     number = number / 2.0;
 }
 
-#define   DARK                0x08
-#define   LIGHT               0x07
-#define   BOLD                0x0F
-#define   GREEN               0x0A
-#define   YELLOW              0x0E
-#define   RED                 0x04
-#define   BRIGHT_RED          0x0C
-
-void k_log_vfmt(log_level level, const char* fmt, va_list ap)
+// Copies the arguments referenced by fmt out of the va_list, each widened
+// to 64 bits, so that they can be formatted later from the raw values.
+// Returns the number of arguments captured.
+static
+unsigned capture_args(const char* fmt, va_list ap, uint64_t (&args)[LOG_MAX_ARGS])
 {
-  switch (level)
+  unsigned count = 0;
+  while (*fmt && count < LOG_MAX_ARGS)
   {
-    case TRACE:    attrib = DARK;   break;
-    case DEBUG:    attrib = LIGHT;  break;
-    case NORMAL:   attrib = BOLD;   break;
-    case SUCCESS:  attrib = GREEN;  break;
-    case WARNING:  attrib = YELLOW; break;
-    case ERROR:    attrib = RED;    break;
-    case CRITICAL: attrib = BRIGHT_RED; break;
+    if (*fmt++ != '%')
+      continue;
+    switch (*fmt)
+    {
+        case 'd':
+        case 'i':
+        case 'c': args[count++] = va_arg(ap, int); break;
+        case 'x': args[count++] = va_arg(ap, uint32_t); break;
+        case 'X': args[count++] = va_arg(ap, uint64_t); break;
+        case 's': args[count++] = reinterpret_cast<size_t>(va_arg(ap, const char*)); break;
+        case 'f':
+        {
+          union { double d; uint64_t u; } bits;
+          bits.d = va_arg(ap, double);
+          args[count++] = bits.u;
+          break;
+        }
+        case 0: fmt--; break;
+    }
+    fmt++;
   }
+  return count;
+}
+
+// Formats and outputs a message from previously captured arguments
+static
+void emit_formatted(log_level level, const char* fmt, const uint64_t (&args)[LOG_MAX_ARGS])
+{
+  set_attrib(level);
 
+  unsigned arg = 0;
   while (*fmt)
   {
     switch (*fmt)
     {
         case '%':
             fmt++;
+            if (arg >= LOG_MAX_ARGS && *fmt != '%')
+            {
+              if (*fmt == 0)
+                fmt--;
+              break;
+            }
             switch (*fmt)
             {
                 // TODO: everything is treated as unsigned, also floats not supported yet
-                case 'd': log_number<int, 10>(va_arg(ap, int)); break;
-                case 'i': log_number<int, 10>(va_arg(ap, int)); break;
-                case 'x': log_number<uint32_t, 16, 8>(va_arg(ap, uint32_t)); break;
-                case 'X': log_number<uint64_t, 16, 16>(va_arg(ap, uint64_t)); break;
+                case 'd': log_number<int, 10>(int(args[arg++])); break;
+                case 'i': log_number<int, 10>(int(args[arg++])); break;
+                case 'x': log_number<uint32_t, 16, 8>(uint32_t(args[arg++])); break;
+                case 'X': log_number<uint64_t, 16, 16>(args[arg++]); break;
                 case '%': log_char('%'); break;
-                case 'f': log_float(va_arg(ap, double)); break;
-                case 'c': log_char(va_arg(ap, int)); break;
-                case 's': log_str(va_arg(ap, const char*)); break;
+                case 'f':
+                {
+                  union { uint64_t u; double d; } bits;
+                  bits.u = args[arg++];
+                  log_float(bits.d);
+                  break;
+                }
+                case 'c': log_char(char(args[arg++])); break;
+                case 's': log_str(reinterpret_cast<const char*>(size_t(args[arg++]))); break;
                 case 0: fmt--; break;
             }
             break;
@@ -169,6 +463,269 @@ void k_log_vfmt(log_level level, const char* fmt, va_list ap)
   }
 }
 
+// Binary logging
+//
+// Sinks in binary mode are sent a compact record per message instead of the
+// formatted text, see types/log_record.h for the layout. The text is
+// recovered on the host with tools/binary_log.
+
+struct record_buffer_t
+{
+  uint8_t   data[LOG_RECORD_HEADER_SIZE + LOG_RECORD_MAX_LENGTH];
+  uint32_t  length;
+  bool      overflowed;     // more was written than fits
+};
+
+static inline
+void record_byte(record_buffer_t& record, uint8_t byte)
+{
+  if (record.length < sizeof(record.data))
+    record.data[record.length++] = byte;
+  else
+    record.overflowed = true;
+}
+
+static
+void record_varint(record_buffer_t& record, uint64_t value)
+{
+  while (value >= 0x80)
+  {
+    record_byte(record, uint8_t(value) | 0x80);
+    value >>= 7;
+  }
+  record_byte(record, uint8_t(value));
+}
+
+static
+void emit_binary(log_level level, const char* fmt, const uint64_t (&args)[LOG_MAX_ARGS], tick_t timestamp)
+{
+  record_buffer_t record;
+  record.length = 0;
+  record.overflowed = false;
+  record_byte(record, LOG_RECORD_SYNC);
+  record_byte(record, level);
+  record_byte(record, 0); // length, filled in at the end
+  uint32_t id = log_format_id(fmt);
+  for (int i = 0; i < 4; ++i)
+    record_byte(record, uint8_t(id >> (i * 8)));
+  record_varint(record, timestamp);
+
+  unsigned arg = 0;
+  uint32_t complete_length = record.length;
+  while (*fmt && arg < LOG_MAX_ARGS)
+  {
+    if (*fmt++ != '%')
+      continue;
+    switch (*fmt)
+    {
+        case 'd':
+        case 'i':
+        {
+          int32_t value = int32_t(args[arg++]);
+          record_varint(record, (uint32_t(value) << 1) ^ uint32_t(value >> 31));
+          break;
+        }
+        case 'x':
+        case 'X': record_varint(record, args[arg++]); break;
+        case 'c': record_byte(record, uint8_t(args[arg++])); break;
+        case 's':
+        {
+          const char* str = reinterpret_cast<const char*>(size_t(args[arg++]));
+          uint32_t length = 0;
+          while (str[length] && length < 64)
+            ++length;
+          record_byte(record, uint8_t(length));
+          for (uint32_t i = 0; i < length; ++i)
+            record_byte(record, str[i]);
+          break;
+        }
+        case 'f':
+          for (int i = 0; i < 8; ++i)
+            record_byte(record, uint8_t(args[arg] >> (i * 8)));
+          ++arg;
+          break;
+        case 0: fmt--; break;
+    }
+    fmt++;
+    // an argument is either all there or left out, along with the rest
+    if (record.overflowed)
+    {
+      record.length = complete_length;
+      record.data[1] |= LOG_RECORD_TRUNCATED;
+      break;
+    }
+    complete_length = record.length;
+  }
+
+  record.data[2] = uint8_t(record.length - LOG_RECORD_HEADER_SIZE);
+  for (uint32_t i = 0; i < log_sink_count; ++i)
+  {
+    const log_sink_t& sink = log_sinks[i];
+    if (sink.enabled && sink.binary && level >= sink.min_level)
+      sink.write(&sink, record.data, record.length);
+  }
+}
+
+// Outputs a message to all the sinks, as text or as a binary record
+static
+void emit(log_level level, const char* fmt, const uint64_t (&args)[LOG_MAX_ARGS], tick_t timestamp)
+{
+  if (!check_sinks())
+    return;
+
+  for (uint32_t i = 0; i < log_sink_count; ++i)
+  {
+    if (log_sinks[i].enabled && log_sinks[i].binary)
+    {
+      emit_binary(level, fmt, args, timestamp);
+      break;
+    }
+  }
+  emit_formatted(level, fmt, args);
+}
+
+// Deferred logging
+//
+// Messages are recorded in to a ring of fixed size entries holding the
+// level, the tick it was logged at, the format string pointer and the raw
+// arguments. Nothing is formatted until k_log_drain() is called in slack
+// time, so logging from a task costs only a slot reservation and a copy.
+//
+// There is one CPU, so this is the per-CPU ring. The code logging may be
+// interrupted by the timer and the interrupt handler may also log, so
+// a slot is reserved with a compare-and-swap on the head, and each slot
+// has a sequence number which the writer publishes last so the drain
+// knows when the entry is complete. Only k_log_drain() moves the tail.
+//
+// The sequence numbers are those of a bounded MPMC queue, for the slot
+// of position pos: pos when it is free to be written, pos + 1 once it has
+// been written, and pos + LOG_RING_SIZE once drained, which is the free
+// value for the position on the next lap. No two states are equal, so an
+// entry from a lap before is never taken for a new one.
+
+#define LOG_NO_POSITION     0xFFFF
+
+struct log_entry_t
+{
+  uint32_t     sequence;            // see above
+  uint8_t      level;
+  uint8_t      arg_count;
+  uint16_t     x;
+  uint16_t     y;
+  tick_t       timestamp;
+  const char*  fmt;
+  uint64_t     args[LOG_MAX_ARGS];
+};
+
+static_assert((LOG_RING_SIZE & (LOG_RING_SIZE - 1)) == 0, "LOG_RING_SIZE must be a power of 2");
+
+static log_entry_t log_ring[LOG_RING_SIZE];
+static uint32_t log_head = 0;        // next index to reserve
+static uint32_t log_tail = 0;        // next index to drain
+static bool log_ring_initialized = false;
+static bool log_draining = false;
+static log_statistics_t log_stats;
+
+static
+void initialize_log_ring()
+{
+  for (uint32_t i = 0; i < LOG_RING_SIZE; ++i)
+    log_ring[i].sequence = i;
+  log_ring_initialized = true;
+}
+
+static
+void log_deferred(log_level level, uint16_t x, uint16_t y, const char* fmt, va_list ap)
+{
+  if (!log_ring_initialized)
+    initialize_log_ring();
+
+  uint32_t head = __atomic_load_n(&log_head, __ATOMIC_RELAXED);
+  do
+  {
+    if (head - __atomic_load_n(&log_tail, __ATOMIC_ACQUIRE) >= LOG_RING_SIZE)
+    {
+      __atomic_fetch_add(&log_stats.dropped, 1, __ATOMIC_RELAXED);
+      return;
+    }
+  } while (!__atomic_compare_exchange_n(&log_head, &head, head + 1, true, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+
+  log_entry_t& entry = log_ring[head & (LOG_RING_SIZE - 1)];
+  entry.level = level;
+  entry.x = x;
+  entry.y = y;
+  entry.timestamp = current_tick();
+  entry.fmt = fmt;
+  entry.arg_count = capture_args(fmt, ap, entry.args);
+  __atomic_store_n(&entry.sequence, head + 1, __ATOMIC_RELEASE);
+
+  uint32_t used = head + 1 - __atomic_load_n(&log_tail, __ATOMIC_RELAXED);
+  if (used > log_stats.high_water)
+    log_stats.high_water = used;
+  __atomic_fetch_add(&log_stats.logged, 1, __ATOMIC_RELAXED);
+}
+
+uint32_t k_log_drain(uint32_t max_entries)
+{
+  if (!log_ring_initialized || log_draining)
+    return 0;
+  log_draining = true;
+
+  uint32_t drained = 0;
+  uint32_t dropped = __atomic_exchange_n(&log_stats.dropped, 0, __ATOMIC_RELAXED);
+  if (dropped)
+  {
+    log_stats.total_dropped += dropped;
+    k_log_fmt(WARNING, "\n[log: %i messages dropped]\n", dropped);
+  }
+
+  // only up to what was reserved before starting, so messages logged by
+  // the output, or by interrupts while it is output, can't keep it going
+  uint32_t head = __atomic_load_n(&log_head, __ATOMIC_ACQUIRE);
+  while (drained < max_entries && log_tail != head)
+  {
+    log_entry_t& entry = log_ring[log_tail & (LOG_RING_SIZE - 1)];
+    if (__atomic_load_n(&entry.sequence, __ATOMIC_ACQUIRE) != log_tail + 1)
+      break;  // the writer of the next entry hasn't finished yet
+
+    tick_t latency = current_tick() - entry.timestamp;
+    if (latency > log_stats.max_latency)
+      log_stats.max_latency = latency;
+
+    if (entry.x != LOG_NO_POSITION)
+      goto_xy(entry.x, entry.y);
+    emit(log_level(entry.level), entry.fmt, entry.args, entry.timestamp);
+
+    __atomic_store_n(&entry.sequence, log_tail + LOG_RING_SIZE, __ATOMIC_RELEASE);
+    __atomic_store_n(&log_tail, log_tail + 1, __ATOMIC_RELEASE);
+    ++drained;
+  }
+
+  log_draining = false;
+  return drained;
+}
+
+bool k_log_pending()
+{
+  return __atomic_load_n(&log_head, __ATOMIC_ACQUIRE) != __atomic_load_n(&log_tail, __ATOMIC_ACQUIRE);
+}
+
+const log_statistics_t& k_log_statistics()
+{
+  return log_stats;
+}
+
+void k_log_vfmt(log_level level, const char* fmt, va_list ap)
+{
+  // Anything still queued was logged earlier so needs to come out first
+  if (level == CRITICAL)
+    k_log_drain();
+
+  uint64_t args[LOG_MAX_ARGS];
+  capture_args(fmt, ap, args);
+  emit(level, fmt, args, current_tick());
+}
+
 void k_log_fmt(log_level level, const char* fmt, ...)
 {
   va_list ap;
@@ -176,3 +733,30 @@ void k_log_fmt(log_level level, const char* fmt, ...)
   k_log_vfmt(level, fmt, ap);
   va_end(ap);
 }
+
+void k_log_deferred(log_level level, const char* fmt, ...)
+{
+  va_list ap;
+  va_start(ap, fmt);
+  if (level == CRITICAL)
+    k_log_vfmt(level, fmt, ap);
+  else
+    log_deferred(level, LOG_NO_POSITION, LOG_NO_POSITION, fmt, ap);
+  va_end(ap);
+}
+
+void k_log_deferred_xy(unsigned x, unsigned y, log_level level, const char* fmt, ...)
+{
+  va_list ap;
+  va_start(ap, fmt);
+  if (level == CRITICAL)
+  {
+    goto_xy(x, y);
+    k_log_vfmt(level, fmt, ap);
+  }
+  else
+  {
+    log_deferred(level, x, y, fmt, ap);
+  }
+  va_end(ap);
+}
@@ -0,0 +1,225 @@
+/*
+  Real-time Scheduler
+  Copyright (c) 2023, John Ryland
+  All rights reserved.
+*/
+
+#include "kernel/edf_analysis.h"
+
+// The tasks with their exec_bounds scaled, or one of them replaced, as the
+// searches try out, so the tasks don't need copying for each try
+struct edf_view_t
+{
+  const edf_task_t*  tasks;
+  unsigned           count;
+  uint32_t           scale;         // in EDF_SCALE_ONE units
+  unsigned           index;         // the task with its exec_bound replaced, or count for none
+  ticks_t            exec_bound;
+};
+
+static
+uint64_t exec_bound_of(const edf_view_t& view, unsigned i)
+{
+  uint64_t exec_bound = (i == view.index) ? view.exec_bound : view.tasks[i].exec_bound;
+  // rounded up so the analysis is never optimistic
+  return (exec_bound * view.scale + EDF_SCALE_ONE - 1) / EDF_SCALE_ONE;
+}
+
+static
+uint64_t demand(const edf_view_t& view, uint64_t t)
+{
+  uint64_t total = 0;
+  for (unsigned i = 0; i < view.count; i++)
+  {
+    const edf_task_t& task = view.tasks[i];
+    if (t >= task.deadline)
+      total += ((t - task.deadline) / task.period + 1) * exec_bound_of(view, i);
+  }
+  return total;
+}
+
+// the latest absolute deadline before t, or 0 if there isn't one
+static
+uint64_t deadline_before(const edf_view_t& view, uint64_t t)
+{
+  uint64_t latest = 0;
+  for (unsigned i = 0; i < view.count; i++)
+  {
+    const edf_task_t& task = view.tasks[i];
+    if (t <= task.deadline)
+      continue;
+    uint64_t deadline = task.deadline + (t - 1 - task.deadline) / task.period * task.period;
+    if (deadline > latest)
+      latest = deadline;
+  }
+  return latest;
+}
+
+// The length of the synchronous busy period, or limit if it is longer,
+// as the deadlines past limit don't need checking. Returns false if it
+// is longer than can be checked.
+static
+bool busy_period(const edf_view_t& view, uint64_t limit, uint64_t& length)
+{
+  length = 0;
+  for (unsigned i = 0; i < view.count; i++)
+    length += exec_bound_of(view, i);
+  for (;;)
+  {
+    uint64_t next = 0;
+    for (unsigned i = 0; i < view.count; i++)
+      next += (length + view.tasks[i].period - 1) / view.tasks[i].period * exec_bound_of(view, i);
+    if (next == length)
+      return true;
+    if (next >= limit)
+    {
+      length = limit;
+      return limit <= EDF_MAX_INTERVAL;
+    }
+    length = next;
+  }
+}
+
+static
+uint64_t gcd(uint64_t a, uint64_t b)
+{
+  while (b)
+  {
+    uint64_t remainder = a % b;
+    a = b;
+    b = remainder;
+  }
+  return a;
+}
+
+// Compares the utilization with 100% using the hyperperiod, the least
+// common multiple of the periods, as the denominator. Returns false if
+// it is over 100%, or the hyperperiod is too long to check, otherwise
+// sets hyperperiod.
+static
+bool exact_utilization_at_most_one(const edf_view_t& view, uint64_t& hyperperiod)
+{
+  hyperperiod = 1;
+  for (unsigned i = 0; i < view.count; i++)
+  {
+    hyperperiod = hyperperiod / gcd(hyperperiod, view.tasks[i].period) * view.tasks[i].period;
+    if (hyperperiod > EDF_MAX_INTERVAL)
+      return false;
+  }
+  uint64_t demand = 0;
+  for (unsigned i = 0; i < view.count; i++)
+    demand += hyperperiod / view.tasks[i].period * exec_bound_of(view, i);
+  return demand <= hyperperiod;
+}
+
+static
+bool schedulable(const edf_view_t& view)
+{
+  // In 1/2^32 units. If the density, exec_bound / deadline, is at most 100%
+  // it is schedulable without the demand needing checking, which is always
+  // the case for tasks due by the end of their periods unless they are
+  // within a rounding error of 100%. They are rounded up so that it is
+  // never optimistic.
+  const uint64_t one = 1ULL << 32;
+  uint64_t utilization = 0;
+  uint64_t density = 0;
+  uint64_t laxity = 0;
+  uint64_t min_deadline = EDF_MAX_INTERVAL;
+  uint64_t max_deadline = 0;
+  for (unsigned i = 0; i < view.count; i++)
+  {
+    const edf_task_t& task = view.tasks[i];
+    uint64_t exec_bound = exec_bound_of(view, i);
+    if (task.period == 0 || task.deadline == 0 || exec_bound > task.deadline)
+      return false;
+    utilization += ((exec_bound << 32) + task.period - 1) / task.period;
+    density += ((exec_bound << 32) + task.deadline - 1) / task.deadline;
+    laxity += (uint64_t(task.period - task.deadline) * exec_bound + task.period - 1) / task.period;
+    if (task.deadline < min_deadline)
+      min_deadline = task.deadline;
+    if (task.deadline > max_deadline)
+      max_deadline = task.deadline;
+  }
+  if (density <= one)
+    return true;
+
+  // Only the deadlines up to the busy period need checking, and also only
+  // those up to max(D, sum((T - D) * U) / (1 - U)), which is much shorter
+  // when the utilization is close to 100%. Within a rounding error of 100%
+  // the utilization is worked out exactly over the hyperperiod instead,
+  // which the busy period is no longer than.
+  uint64_t limit = EDF_MAX_INTERVAL + 1;
+  if (utilization >= one)
+  {
+    if (!exact_utilization_at_most_one(view, limit))
+      return false;
+  }
+  else if (laxity < (1ULL << 31))
+  {
+    limit = ((laxity << 32) + (one - utilization) - 1) / (one - utilization);
+    if (limit < max_deadline)
+      limit = max_deadline;
+  }
+  uint64_t length;
+  if (!busy_period(view, limit, length))
+    return false;
+
+  // QPA
+  uint64_t t = deadline_before(view, length + 1);
+  while (t > 0)
+  {
+    uint64_t h = demand(view, t);
+    if (h > t)
+      return false;
+    if (h <= min_deadline)
+      return true;
+    t = (h < t) ? h : deadline_before(view, t);
+  }
+  return true;
+}
+
+uint64_t edf_demand(const edf_task_t* tasks, unsigned count, uint64_t t)
+{
+  return demand({ tasks, count, EDF_SCALE_ONE, count, 0 }, t);
+}
+
+bool edf_schedulable(const edf_task_t* tasks, unsigned count)
+{
+  return schedulable({ tasks, count, EDF_SCALE_ONE, count, 0 });
+}
+
+uint32_t edf_critical_scaling_factor(const edf_task_t* tasks, unsigned count)
+{
+  // no task's exec_bound can be scaled past its deadline
+  uint64_t high = 0xFFFFFFFF;
+  for (unsigned i = 0; i < count; i++)
+    if (tasks[i].exec_bound && uint64_t(tasks[i].deadline) * EDF_SCALE_ONE / tasks[i].exec_bound < high)
+      high = uint64_t(tasks[i].deadline) * EDF_SCALE_ONE / tasks[i].exec_bound;
+
+  // the demand only grows with the scale, so search for where it stops fitting
+  uint64_t low = 0;
+  while (low < high)
+  {
+    uint64_t mid = low + (high - low + 1) / 2;
+    if (schedulable({ tasks, count, uint32_t(mid), count, 0 }))
+      low = mid;
+    else
+      high = mid - 1;
+  }
+  return uint32_t(low);
+}
+
+ticks_t edf_allowable_exec_bound(const edf_task_t* tasks, unsigned count, unsigned index)
+{
+  uint64_t low = 0;
+  uint64_t high = tasks[index].deadline;
+  while (low < high)
+  {
+    uint64_t mid = low + (high - low + 1) / 2;
+    if (schedulable({ tasks, count, EDF_SCALE_ONE, index, ticks_t(mid) }))
+      low = mid;
+    else
+      high = mid - 1;
+  }
+  return ticks_t(low);
+}
@@ -0,0 +1,136 @@
+/*
+  Real-time Scheduler
+  Copyright (c) 2023, John Ryland
+  All rights reserved.
+*/
+
+#include "kernel/elastic.h"
+#include "kernel/task_manager.h"
+
+struct elastic_task_t
+{
+  task_t*   task;
+  uint32_t  max_utilization;    // at its min_period
+  uint32_t  min_utilization;    // at its max_period
+  uint32_t  utilization;
+  bool      fixed;              // compressed as far as it can be
+};
+
+static
+bool _elastic_scheduling = false;
+
+static
+elastic_task_t _elastic_tasks[MAX_TASKS];
+
+void set_elastic_scheduling(bool enabled)
+{
+  _elastic_scheduling = enabled;
+}
+
+bool elastic_scheduling_enabled()
+{
+  return _elastic_scheduling;
+}
+
+// rounded up, so the sum is never less than what the tasks use
+static
+uint32_t utilization(ticks_t exec_bound, ticks_t period)
+{
+  return uint32_t((uint64_t(exec_bound) * ELASTIC_UTILIZATION_SCALE + period - 1) / period);
+}
+
+// the shortest period which uses no more than the utilization
+static
+ticks_t period_for(const elastic_task_t& elastic)
+{
+  const task_t* task = elastic.task;
+  if (elastic.utilization <= elastic.min_utilization)
+    return task->max_period;
+  ticks_t period = ticks_t((uint64_t(task->exec_bound) * ELASTIC_UTILIZATION_SCALE + elastic.utilization - 1) / elastic.utilization);
+  if (period < task->min_period)
+    return task->min_period;
+  if (period > task->max_period)
+    return task->max_period;
+  return period;
+}
+
+// Buttazzo's elastic task model. The utilization over the limit is taken
+// from the elastic tasks in proportion to their elasticity. Any which that
+// would compress past their max_period are fixed there, and the rest is
+// shared out again between the others, until none go past.
+bool compress_elastic_tasks()
+{
+  unsigned count = 0;
+  uint64_t rigid = 0;
+  uint64_t least = 0;
+  for (unsigned i = 0; i < items_in_list; i++)
+  {
+    task_t* task = &task_list[i];
+    if (task->func_ptr == nullptr || task->period == 0)
+      continue;
+    if (task->elasticity == 0 || task->min_period >= task->max_period)
+    {
+      rigid += utilization(task->exec_bound, task->period);
+      continue;
+    }
+    elastic_task_t& elastic = _elastic_tasks[count++];
+    elastic.task = task;
+    elastic.max_utilization = utilization(task->exec_bound, task->min_period);
+    elastic.min_utilization = utilization(task->exec_bound, task->max_period);
+    elastic.utilization = elastic.max_utilization;
+    elastic.fixed = false;
+    least += elastic.min_utilization;
+  }
+
+  if (rigid + least > ELASTIC_UTILIZATION_LIMIT)
+    return false;
+
+  // each pass either fits the rest or fixes at least one more task
+  for (bool compressed = false; !compressed; )
+  {
+    uint64_t fixed = rigid;
+    uint64_t variable = 0;
+    uint64_t elasticity = 0;
+    for (unsigned i = 0; i < count; i++)
+    {
+      if (_elastic_tasks[i].fixed)
+      {
+        fixed += _elastic_tasks[i].utilization;
+      }
+      else
+      {
+        variable += _elastic_tasks[i].max_utilization;
+        elasticity += _elastic_tasks[i].task->elasticity;
+      }
+    }
+
+    compressed = true;
+    uint64_t excess = (fixed + variable > ELASTIC_UTILIZATION_LIMIT) ? fixed + variable - ELASTIC_UTILIZATION_LIMIT : 0;
+    for (unsigned i = 0; i < count; i++)
+    {
+      elastic_task_t& elastic = _elastic_tasks[i];
+      if (elastic.fixed)
+        continue;
+      uint64_t reduction = elasticity ? (excess * elastic.task->elasticity + elasticity - 1) / elasticity : 0;
+      if (elastic.max_utilization < elastic.min_utilization + reduction)
+      {
+        elastic.utilization = elastic.min_utilization;
+        elastic.fixed = true;
+        compressed = false;
+      }
+      else
+      {
+        elastic.utilization = elastic.max_utilization - uint32_t(reduction);
+      }
+    }
+  }
+
+  for (unsigned i = 0; i < count; i++)
+  {
+    task_t* task = _elastic_tasks[i].task;
+    ticks_t period = period_for(_elastic_tasks[i]);
+    if (period != task->period)
+      set_elastic_period(task, period);
+  }
+  return true;
+}
@@ -5,7 +5,7 @@
 */
 
 #include "compatibility.h"
-#include "runtime/utilities.h"
+#include "common/sort.hpp"
 #include "types/symbol.h"
 #include "kernel/debug_logger.h"
 #include "kernel/exception_handler.h"
@@ -151,14 +151,14 @@ void exit(int code)
 extern "C"
 const uint8_t symbol_map_base[32];
 
-int compare_symbols(const void* a, const void* b)
+// matches the symbol whose code the address falls within, up to the next symbol
+static
+int compare_symbols(uint32_t address, const symbol_entry& symbol)
 {
-  const symbol_entry* sym_a = (const symbol_entry*)a;
-  const symbol_entry* sym_b = (const symbol_entry*)b;
-  const symbol_entry* sym_c = &sym_b[1];
-  if (sym_a->address <= sym_b->address)
+  const symbol_entry* next = &symbol + 1;
+  if (address <= symbol.address)
     return -1;
-  if (sym_a->address > sym_c->address)
+  if (address > next->address)
     return 1;
   return 0;
 }
@@ -178,8 +178,7 @@ void dump_callstack(uint32_t* stack_pointer)
     {
       static const char stack_value[] = "0x00000000 ";
 
-      symbol_entry key = { val, 0 };
-      const symbol_entry* ent = (const symbol_entry*)k_bsearch((void*)&key, symbol_entries, symbol_entry_count, sizeof(symbol_entry), compare_symbols);
+      const symbol_entry* ent = binarySearch(symbol_entries, symbol_entry_count, val, compare_symbols);
       
       stamp_hex32((char*)&stack_value[2], (size_t)stack_pointer);
       failsafe_print_n(stack_value, 11);
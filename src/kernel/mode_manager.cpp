@@ -0,0 +1,274 @@
+/*
+  Real-time Scheduler
+  Copyright (c) 2023, John Ryland
+  All rights reserved.
+*/
+
+#include "kernel/mode_manager.h"
+#include "kernel/elastic.h"
+#include "kernel/replay.h"
+#include "kernel/task_manager.h"
+#include "module/timer.h"
+
+static
+operating_mode_t _modes[MAX_MODES];
+
+static
+unsigned _mode_count = 0;
+
+static
+unsigned _current_mode = NO_MODE;
+
+void initialize_modes()
+{
+  _mode_count = 0;
+  _current_mode = NO_MODE;
+}
+
+// The tasks are scheduled earliest deadline first, and each job has to
+// complete within its period, for which the task set is schedulable if
+// the total utilization is at most 1. Some is kept back for the tasks
+// which aren't part of the modes.
+static
+acceptance_codes analyse_mode(const operating_mode_t& mode, mode_analysis_t& analysis)
+{
+  analysis.utilization = 0;
+  analysis.max_period = 0;
+  analysis.schedulable = false;
+  for (unsigned i = 0; i < mode.task_count; i++)
+  {
+    const mode_task_t& task = mode.tasks[i];
+    if (task.period == 0 || task.exec_bound > task.period)
+      return bound_gt_period;
+    if (task.wait_for != 0)
+    {
+      bool earlier = false;
+      for (unsigned j = 0; j < i; j++)
+        if (mode.tasks[j].task_name == task.wait_for)
+          earlier = true;
+      if (!earlier && search_for_task_in_schedule(task.wait_for) == nullptr)
+        return wait_for_not_present;
+    }
+    analysis.utilization += uint32_t((uint64_t(task.exec_bound) * MODE_UTILIZATION_SCALE + task.period - 1) / task.period);
+    if (task.period > analysis.max_period)
+      analysis.max_period = task.period;
+  }
+  if (analysis.utilization > MODE_UTILIZATION_LIMIT)
+    return can_not_be_scheduled_with_the_other_tasks;
+  analysis.schedulable = true;
+  return accepted;
+}
+
+acceptance_codes define_mode(const char* name, const mode_task_t* tasks, unsigned task_count, unsigned& mode_id)
+{
+  if (_mode_count == MAX_MODES || task_count > MAX_MODE_TASKS)
+    return schedule_full;
+
+  operating_mode_t& mode = _modes[_mode_count];
+  mode.name = name;
+  mode.task_count = task_count;
+  for (unsigned i = 0; i < task_count; i++)
+    mode.tasks[i] = tasks[i];
+
+  acceptance_codes status = analyse_mode(mode, mode.analysis);
+  if (status != accepted)
+    return status;
+
+  mode_id = _mode_count++;
+  return accepted;
+}
+
+const operating_mode_t* get_mode(unsigned mode_id)
+{
+  return (mode_id < _mode_count) ? &_modes[mode_id] : nullptr;
+}
+
+unsigned current_mode()
+{
+  return _current_mode;
+}
+
+// if the mode has the same task, it carries on running through the change
+static
+bool mode_has_task(const operating_mode_t& mode, const mode_task_t& task)
+{
+  for (unsigned i = 0; i < mode.task_count; i++)
+  {
+    const mode_task_t& other = mode.tasks[i];
+    if (other.task_name == task.task_name && other.func_ptr == task.func_ptr &&
+        other.period == task.period && other.exec_bound == task.exec_bound &&
+        other.wait_for == task.wait_for)
+      return true;
+  }
+  return false;
+}
+
+// whether the mode has a task of the name, with whatever parameters
+static
+bool mode_has_task_name(const operating_mode_t* mode, id_t task_name)
+{
+  if (mode == nullptr)
+    return false;
+  for (unsigned i = 0; i < mode->task_count; i++)
+    if (mode->tasks[i].task_name == task_name)
+      return true;
+  return false;
+}
+
+// whether the task is one of the old mode's which the change stops
+static
+bool ended_by_change(const operating_mode_t* previous, const operating_mode_t& next, id_t task_name)
+{
+  if (previous == nullptr)
+    return false;
+  for (unsigned i = 0; i < previous->task_count; i++)
+    if (previous->tasks[i].task_name == task_name)
+      return !mode_has_task(next, previous->tasks[i]);
+  return false;
+}
+
+// The new mode was analysed on its own when it was defined, this checks
+// it fits with the tasks which keep running through the change, those
+// outside of the modes included, before anything is changed. The old
+// mode's tasks are left out, the protocol keeps their jobs apart from the
+// new mode's, and elastic tasks are counted at their max_period, which is
+// as far as they can be compressed to make room.
+static
+acceptance_codes check_mode_change(const operating_mode_t* previous, const operating_mode_t& next)
+{
+  uint64_t utilization = next.analysis.utilization;
+  unsigned free_slots = MAX_TASKS - items_in_list;
+  for (unsigned i = 0; i < items_in_list; i++)
+  {
+    const task_t* task = &task_list[i];
+    if (task->func_ptr == nullptr)
+    {
+      free_slots++;
+      continue;
+    }
+    if (task->period == 0 || mode_has_task_name(previous, task->task_name))
+      continue;
+    ticks_t period = (elastic_scheduling_enabled() && task->elasticity) ? task->max_period : task->period;
+    utilization += (uint64_t(task->exec_bound) * MODE_UTILIZATION_SCALE + period - 1) / period;
+  }
+  if (utilization > MODE_UTILIZATION_SCALE)
+    return can_not_be_scheduled_with_the_other_tasks;
+
+  unsigned new_tasks = 0;
+  for (unsigned i = 0; i < next.task_count; i++)
+  {
+    const mode_task_t& task = next.tasks[i];
+    if (previous && mode_has_task(*previous, task))
+      continue;
+    // an old task of the name is still in the task list until its last job has run
+    if (search_for_task_in_schedule(task.task_name) != nullptr)
+      return task_name_in_use;
+    if (task.wait_for != 0 && !mode_has_task_name(&next, task.wait_for) &&
+        (search_for_task_in_schedule(task.wait_for) == nullptr || ended_by_change(previous, next, task.wait_for)))
+      return wait_for_not_present;
+    new_tasks++;
+  }
+  if (new_tasks > free_slots)
+    return schedule_full;
+  return accepted;
+}
+
+// Either the whole change is made or none of it is. What could be checked
+// beforehand has been, and if adding a task fails anyway, such as when the
+// schedule fills up, the new tasks are taken out again and the schedule is
+// put back the way it was, with the old tasks still running.
+static
+acceptance_codes change_mode(unsigned mode_id, mode_change_protocol protocol, tick_t& release_at)
+{
+  release_at = current_tick();
+  const operating_mode_t* next = get_mode(mode_id);
+  if (next == nullptr)
+    return mode_not_defined;
+  if (mode_id == _current_mode)
+    return accepted;
+
+  const operating_mode_t* previous = get_mode(_current_mode);
+  acceptance_codes status = check_mode_change(previous, *next);
+  if (status != accepted)
+    return status;
+
+  save_schedule_list_state();
+
+  // stop the old mode's tasks which aren't in the new mode, working out
+  // when their jobs are all done by
+  tick_t now = current_tick();
+  release_at = now;
+  task_t* ended[MAX_MODE_TASKS];
+  tick_t ended_complete_not_after[MAX_MODE_TASKS];
+  unsigned ended_count = 0;
+  if (previous)
+  {
+    for (unsigned i = 0; i < previous->task_count; i++)
+    {
+      const mode_task_t& old_task = previous->tasks[i];
+      if (mode_has_task(*next, old_task))
+        continue;
+      task_t* task = search_for_task_in_schedule(old_task.task_name);
+      if (task == nullptr)
+        continue;
+      ended[ended_count] = task;
+      ended_complete_not_after[ended_count++] = task->complete_not_after;
+      tick_t done_by = jobs_done_by(task, now);
+      stop_task_at(task, now);
+      if (protocol == mode_change_protocol::MAX_PERIOD_OFFSET)
+        done_by = now + previous->analysis.max_period;
+      if (tick_after(done_by, release_at))
+        release_at = done_by;
+    }
+  }
+
+  // release the new mode's tasks which aren't already running
+  for (unsigned i = 0; i < next->task_count && status == accepted; i++)
+  {
+    const mode_task_t& new_task = next->tasks[i];
+    if (previous && mode_has_task(*previous, new_task))
+      continue;
+    status = request_to_add_task(replay_task_entry(new_task.func_ptr), new_task.task_name, new_task.wait_for,
+                                 release_at, new_task.exec_bound, 0, new_task.period,
+                                 new_task.name, new_task.x_pos, new_task.y_pos);
+  }
+
+  if (status != accepted)
+  {
+    // the names were checked to be free, so those found were added by the change
+    restore_schedule_list_state();
+    for (unsigned i = 0; i < next->task_count; i++)
+    {
+      if (previous && mode_has_task(*previous, next->tasks[i]))
+        continue;
+      task_t* task = search_for_task_in_schedule(next->tasks[i].task_name);
+      if (task)
+        remove_task_from_schedule(task);
+    }
+    for (unsigned i = 0; i < ended_count; i++)
+      ended[i]->complete_not_after = ended_complete_not_after[i];
+    tune_event_horizon();
+    if (elastic_scheduling_enabled())
+      compress_elastic_tasks();
+    release_at = now;
+    return status;
+  }
+
+  // the old tasks with none of their jobs left to run can go now
+  for (unsigned i = 0; i < ended_count; i++)
+    retire_task_if_finished(ended[i]);
+
+  _current_mode = mode_id;
+  return accepted;
+}
+
+// The change is recorded for replaying as a whole, as the tasks it adds
+// and ends can't be replayed one by one in the same order, see replay.h
+acceptance_codes request_mode_change(unsigned mode_id, mode_change_protocol protocol, tick_t& release_at)
+{
+  replay_request_started();
+  acceptance_codes result = change_mode(mode_id, protocol, release_at);
+  uint64_t fields[] = { mode_id, uint64_t(protocol), release_at, result };
+  replay_record_request(REPLAY_MODE_CHANGE, fields, 4, nullptr);
+  return result;
+}
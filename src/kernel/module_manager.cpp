@@ -13,6 +13,9 @@
 static
 bool _modules_initialized = false;
 
+static
+uint32_t _modules_generation = 0;
+
 static
 module_t* module_class_head_ptrs[static_cast<size_t>(module_class::DRIVER_CLASS_COUNT)];
 
@@ -21,11 +24,17 @@ bool modules_initialized()
   return _modules_initialized;
 }
 
+uint32_t modules_generation()
+{
+  return _modules_generation;
+}
+
 void module_register(module_t& driver)
 {
   module_t* head_ptr = module_class_head_ptrs[static_cast<size_t>(driver.type)];
   driver.next        = head_ptr;
   module_class_head_ptrs[static_cast<size_t>(driver.type)] = &driver;
+  _modules_generation++;
 }
 
 // All potentially built-in module register functions
@@ -43,6 +52,7 @@ extern void register_memory_x86_linear_model();
 extern void register_memory_x86_virtual_model();
 extern void register_random_intel_x86_device();
 extern void register_random_generic_device();
+extern void register_scheduler_linux_deadline_module();
 extern void register_scheduler_realtime_module();
 extern void register_ti_16650_uart_driver();
 extern void register_text_dos_display();
@@ -102,6 +112,9 @@ void initialize_modules()
 # ifdef ENABLE_RANDOM_GENERIC
   register_random_generic_device();
 # endif
+# ifdef ENABLE_SCHEDULER_LINUX_DEADLINE
+  register_scheduler_linux_deadline_module();
+# endif
 # ifdef ENABLE_SCHEDULER_REALTIME
   register_scheduler_realtime_module();
 # endif
@@ -137,6 +150,7 @@ void initialize_modules()
 # endif
 
   _modules_initialized = true;
+  _modules_generation++;
 }
 
 module_t const* find_module_by_class(module_class driver_type)
@@ -144,6 +158,19 @@ module_t const* find_module_by_class(module_class driver_type)
   return module_class_head_ptrs[static_cast<size_t>(driver_type)];
 }
 
+module_t const* find_module_by_class_and_name(module_class driver_type, const char* name)
+{
+  for (module_t const* module = find_module_by_class(driver_type); module; module = module->next)
+  {
+    size_t i = 0;
+    while (i < sizeof(module->name.name) && module->name.name[i] && module->name.name[i] == name[i])
+      ++i;
+    if ((i == sizeof(module->name.name)) ? (name[i] == 0) : (module->name.name[i] == name[i]))
+      return module;
+  }
+  return nullptr;
+}
+
 //module_t const* find_driver_by_id(uint32_t id);
 //module_t const* find_driver_by_name(const short_name& name);
 //module_t const* find_driver_by_class_and_id(module_class driver_type, uint32_t id);
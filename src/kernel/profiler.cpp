@@ -0,0 +1,175 @@
+/*
+  Real-time Scheduler
+  Copyright (c) 2023, John Ryland
+  All rights reserved.
+*/
+
+#include "kernel/profiler.h"
+#include "common/sort.hpp"
+
+#define SYMBOL_MAP_MAGIC      0xDDCC
+#define UNKNOWN_SYMBOL        0xFFFF      // above the most symbols the map's count can hold
+#define MAX_SYMBOL_NAME       48
+
+struct profile_sample_t
+{
+  size_t  pc;
+  bool    in_task;
+};
+
+// a sample once it has been looked up
+struct symbol_sample_t
+{
+  uint16_t  symbol;
+  bool      in_task;
+};
+
+static volatile bool _profiling = false;
+static volatile bool _in_task = false;
+
+static
+profile_sample_t _samples[PROFILER_MAX_CPUS][PROFILER_SAMPLES];
+
+// how many samples each cpu has taken, the next goes at this modulo PROFILER_SAMPLES
+static volatile uint32_t _sample_counts[PROFILER_MAX_CPUS];
+
+static
+symbol_sample_t _symbol_samples[PROFILER_MAX_CPUS * PROFILER_SAMPLES];
+
+// appended to the kernel by its linker script, but hosted there isn't one
+extern "C" [[ gnu::weak ]]
+const uint8_t symbol_map_base[32];
+
+static const symbol_table* _symbol_map = (const symbol_table*)&symbol_map_base;
+static size_t _load_base = 0;
+
+static const char _unknown_symbol[] = "[unknown]";
+
+
+static
+bool have_symbol_map()
+{
+  return _symbol_map && _symbol_map->magic == SYMBOL_MAP_MAGIC && _symbol_map->count;
+}
+
+// the symbol whose code the address falls within, assuming it runs up to the next symbol
+static
+uint16_t find_symbol(size_t pc)
+{
+  if (!have_symbol_map() || pc < _load_base || pc - _load_base > 0xFFFFFFFF)
+    return UNKNOWN_SYMBOL;
+  symbol_entry key = { uint32_t(pc - _load_base), 0 };
+  size_t after = upperBound(_symbol_map->entries, _symbol_map->count, key,
+                            [](const symbol_entry& a, const symbol_entry& b) { return a.address < b.address; });
+  return after ? uint16_t(after - 1) : UNKNOWN_SYMBOL;
+}
+
+static
+void name_symbol(uint16_t symbol, profile_entry_t& entry)
+{
+  if (symbol == UNKNOWN_SYMBOL)
+  {
+    entry.name = _unknown_symbol;
+    entry.name_length = sizeof(_unknown_symbol) - 1;
+    return;
+  }
+  const symbol_entry* entries = _symbol_map->entries;
+  const char* strings = (const char*)(entries + _symbol_map->count);
+  entry.name = strings + entries[symbol].symbol_offset;
+  // the names aren't separated, so run to the next name, or a nul after the last
+  if (symbol + 1u < _symbol_map->count)
+    entry.name_length = entries[symbol + 1].symbol_offset - entries[symbol].symbol_offset;
+  else
+    for (entry.name_length = 0; entry.name_length < MAX_SYMBOL_NAME && entry.name[entry.name_length]; ++entry.name_length)
+      ;
+  if (entry.name_length > MAX_SYMBOL_NAME)
+    entry.name_length = MAX_SYMBOL_NAME;
+}
+
+// keeps the entries in order of most samples, dropping the least if it is full
+static
+void insert_entry(profile_entry_t* entries, unsigned& count, unsigned max_entries, const profile_entry_t& entry)
+{
+  unsigned index = count;
+  if (count < max_entries)
+    count++;
+  else if (!max_entries || entries[max_entries - 1].samples >= entry.samples)
+    return;
+  else
+    index = max_entries - 1;
+  for (; index > 0 && entries[index - 1].samples < entry.samples; --index)
+    entries[index] = entries[index - 1];
+  entries[index] = entry;
+}
+
+void profiler_enable(bool enable)
+{
+  if (enable && !_profiling)
+    for (unsigned cpu = 0; cpu < PROFILER_MAX_CPUS; cpu++)
+      _sample_counts[cpu] = 0;
+  _profiling = enable;
+}
+
+bool profiler_enabled()
+{
+  return _profiling;
+}
+
+void profiler_record_sample(size_t pc, unsigned cpu)
+{
+  if (!_profiling || cpu >= PROFILER_MAX_CPUS)
+    return;
+  uint32_t count = _sample_counts[cpu];
+  _samples[cpu][count & (PROFILER_SAMPLES - 1)] = { pc, _in_task };
+  _sample_counts[cpu] = count + 1;
+}
+
+void profiler_task_started()
+{
+  _in_task = true;
+}
+
+void profiler_task_finished()
+{
+  _in_task = false;
+}
+
+void profiler_set_symbol_map(const symbol_table* map, size_t load_base)
+{
+  _symbol_map = map;
+  _load_base = load_base;
+}
+
+// The samples are looked up and sorted by symbol, so each symbol's samples
+// are a run which can be counted in one pass.
+unsigned profiler_report(profile_entry_t* entries, unsigned max_entries, uint32_t& total_samples, uint32_t& total_task_samples)
+{
+  uint32_t count = 0;
+  for (unsigned cpu = 0; cpu < PROFILER_MAX_CPUS; cpu++)
+  {
+    uint32_t samples = _sample_counts[cpu];
+    if (samples > PROFILER_SAMPLES)
+      samples = PROFILER_SAMPLES;
+    for (uint32_t i = 0; i < samples; i++)
+      _symbol_samples[count++] = { find_symbol(_samples[cpu][i].pc), _samples[cpu][i].in_task };
+  }
+  sort(_symbol_samples, count, [](const symbol_sample_t& a, const symbol_sample_t& b) { return a.symbol < b.symbol; });
+
+  unsigned entry_count = 0;
+  total_samples = count;
+  total_task_samples = 0;
+  for (uint32_t start = 0, end = 0; start < count; start = end)
+  {
+    profile_entry_t entry = {};
+    for (end = start; end < count && _symbol_samples[end].symbol == _symbol_samples[start].symbol; ++end)
+    {
+      entry.samples++;
+      if (_symbol_samples[end].in_task)
+        entry.task_samples++;
+    }
+    total_task_samples += entry.task_samples;
+    name_symbol(_symbol_samples[start].symbol, entry);
+    insert_entry(entries, entry_count, max_entries, entry);
+  }
+  return entry_count;
+}
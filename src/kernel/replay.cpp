@@ -0,0 +1,461 @@
+/*
+  Real-time Scheduler
+  Copyright (c) 2023, John Ryland
+  All rights reserved.
+*/
+
+#include "kernel/replay.h"
+#include "kernel/mode_manager.h"
+#include "kernel/schedule.h"
+#include "kernel/task_manager.h"
+#include "module/timer.h"
+
+// the most a record can take, a varint of 64 bits takes 10 bytes
+#define REPLAY_MAX_RECORD_SIZE    (2 + 10 * (1 + REPLAY_MAX_FIELDS) + REPLAY_NAME_LENGTH)
+
+struct replay_record_t
+{
+  replay_record_type_t  type;
+  tick_t                tick;
+  uint64_t              fields[REPLAY_MAX_FIELDS];    // those not in the record are 0
+  char                  name[REPLAY_NAME_LENGTH];
+};
+
+// which field of each type of request is its result
+static const uint8_t result_fields[REPLAY_RECORD_TYPE_COUNT] =
+{
+  0, 0, 0,    // not requests
+  9,          // REPLAY_ADD_TASK
+  9,          // REPLAY_ADD_ELASTIC_TASK
+  1,          // REPLAY_REMOVE_TASK
+  4,          // REPLAY_UPDATE_TASK
+  3,          // REPLAY_SET_FIRM
+  0,          // not a request
+  2,          // REPLAY_END_TASK
+  3           // REPLAY_MODE_CHANGE
+};
+
+static bool _recording = false;
+static bool _replaying = false;
+static bool _diverged = false;
+
+// Requests made while making another, such as the elastic tasks' updates
+// when one is added, aren't recorded as replaying the outer one makes them
+static unsigned _request_depth = 0;
+
+// the ticks are recorded as differences from this
+static tick_t _last_tick = 0;
+
+// shared by recording and replaying, as they aren't done at the same time
+static uint8_t _buffer[REPLAY_BUFFER_SIZE];
+static uint32_t _buffer_size = 0;
+static uint32_t _buffer_read = 0;
+
+static replay_writer_t _write = nullptr;
+static replay_reader_t _read = nullptr;
+static void* _context = nullptr;
+
+// a record read ahead, which is next
+static replay_record_t _unread_record;
+static bool _have_unread_record = false;
+
+static replay_result_t* _result = nullptr;
+
+// the replayed tasks are named from here, round robin, as the names must
+// outlive the records
+static char _task_names[MAX_TASKS][REPLAY_NAME_LENGTH];
+static unsigned _next_task_name = 0;
+
+
+// Local functions
+
+static
+bool is_request(replay_record_type_t type)
+{
+  return (type >= REPLAY_ADD_TASK && type <= REPLAY_SET_FIRM) || type == REPLAY_END_TASK || type == REPLAY_MODE_CHANGE;
+}
+
+static
+bool has_name(replay_record_type_t type)
+{
+  return type == REPLAY_ADD_TASK || type == REPLAY_ADD_ELASTIC_TASK;
+}
+
+static
+uint64_t slot_of(const task_t* task)
+{
+  return uint64_t(task - get_task_list());
+}
+
+static
+void flush_records()
+{
+  if (_buffer_size)
+    _write(_buffer, _buffer_size, _context);
+  _buffer_size = 0;
+}
+
+static
+uint8_t* put_varint(uint8_t* out, uint64_t value)
+{
+  for (; value >= 0x80; value >>= 7)
+    *out++ = uint8_t(value | 0x80);
+  *out++ = uint8_t(value);
+  return out;
+}
+
+static
+void write_record(replay_record_type_t type, const uint64_t* fields, unsigned field_count, const char* name)
+{
+  if (REPLAY_BUFFER_SIZE - _buffer_size < REPLAY_MAX_RECORD_SIZE)
+    flush_records();
+  tick_t tick = current_tick();
+  uint8_t* out = _buffer + _buffer_size;
+  *out++ = type;
+  out = put_varint(out, tick - _last_tick);
+  _last_tick = tick;
+  *out++ = uint8_t(field_count);
+  for (unsigned i = 0; i < field_count; i++)
+    out = put_varint(out, fields[i]);
+  if (has_name(type))
+  {
+    uint8_t* name_length = out++;
+    for (*name_length = 0; name && *name_length < REPLAY_NAME_LENGTH - 1 && name[*name_length]; ++*name_length)
+      *out++ = uint8_t(name[*name_length]);
+  }
+  _buffer_size = uint32_t(out - _buffer);
+}
+
+static
+bool read_byte(uint8_t& byte)
+{
+  if (_buffer_read == _buffer_size)
+  {
+    _buffer_size = _read(_buffer, REPLAY_BUFFER_SIZE, _context);
+    _buffer_read = 0;
+    if (!_buffer_size)
+      return false;
+  }
+  byte = _buffer[_buffer_read++];
+  return true;
+}
+
+static
+bool read_varint(uint64_t& value)
+{
+  value = 0;
+  uint8_t byte = 0x80;
+  for (unsigned shift = 0; byte & 0x80; shift += 7)
+  {
+    if (shift > 63 || !read_byte(byte))
+      return false;
+    value |= uint64_t(byte & 0x7F) << shift;
+  }
+  return true;
+}
+
+// returns false at the end of the recording, or where it is cut short
+static
+bool read_record(replay_record_t& record)
+{
+  if (_have_unread_record)
+  {
+    _have_unread_record = false;
+    record = _unread_record;
+    return true;
+  }
+
+  uint8_t type, field_count;
+  uint64_t tick_delta;
+  if (!read_byte(type) || !read_varint(tick_delta) || !read_byte(field_count) || field_count > REPLAY_MAX_FIELDS)
+    return false;
+  record.type = replay_record_type_t(type);
+  record.tick = _last_tick + tick_delta;
+  _last_tick = record.tick;
+  for (unsigned i = 0; i < REPLAY_MAX_FIELDS; i++)
+    record.fields[i] = 0;
+  for (unsigned i = 0; i < field_count; i++)
+    if (!read_varint(record.fields[i]))
+      return false;
+  record.name[0] = 0;
+  if (has_name(record.type))
+  {
+    uint8_t name_length;
+    if (!read_byte(name_length) || name_length >= REPLAY_NAME_LENGTH)
+      return false;
+    for (unsigned c = 0; c < name_length; c++)
+    {
+      uint8_t ch;
+      if (!read_byte(ch))
+        return false;
+      record.name[c] = char(ch);
+    }
+    record.name[name_length] = 0;
+  }
+  return true;
+}
+
+static
+void unread_record(const replay_record_t& record)
+{
+  _unread_record = record;
+  _have_unread_record = true;
+}
+
+static
+void diverge(tick_t tick)
+{
+  _diverged = true;
+  _result->diverged = true;
+  _result->divergence_tick = tick;
+}
+
+// stands in for each of the tasks, except the online scheduler
+static
+void replayed_task()
+{
+}
+
+static
+const char* copy_task_name(const char* name)
+{
+  char* copy = _task_names[_next_task_name];
+  _next_task_name = (_next_task_name + 1) % MAX_TASKS;
+  for (unsigned c = 0; c < REPLAY_NAME_LENGTH; c++)
+    copy[c] = name[c];
+  return copy;
+}
+
+static
+void replay_request(const replay_record_t& record)
+{
+  const uint64_t* f = record.fields;
+  set_current_tick(record.tick);
+  acceptance_codes result = accepted;
+  tick_t tick = 0;
+  switch (record.type)
+  {
+    case REPLAY_ADD_TASK:
+      result = request_to_add_task((f[8] & REPLAY_TASK_IS_SCHEDULER) ? online_scheduler : replayed_task,
+                                   id_t(f[0]), id_t(f[1]), f[2], f[3], f[4], f[5],
+                                   copy_task_name(record.name), unsigned(f[6]), unsigned(f[7]));
+      break;
+    case REPLAY_ADD_ELASTIC_TASK:
+      result = request_to_add_elastic_task((f[8] & REPLAY_TASK_IS_SCHEDULER) ? online_scheduler : replayed_task,
+                                           id_t(f[0]), id_t(f[1]), f[2], f[3], f[4], uint32_t(f[5]),
+                                           copy_task_name(record.name), unsigned(f[6]), unsigned(f[7]));
+      break;
+    case REPLAY_REMOVE_TASK:
+      result = request_remove_task(id_t(f[0]));
+      break;
+    case REPLAY_UPDATE_TASK:
+      result = request_update_task(id_t(f[0]), f[1], f[2], f[3]);
+      break;
+    case REPLAY_SET_FIRM:
+      result = request_set_firm_constraint(id_t(f[0]), unsigned(f[1]), unsigned(f[2]));
+      break;
+    case REPLAY_END_TASK:
+    {
+      // the result is when the task's jobs are done by
+      task_t* task = search_for_task_in_schedule(id_t(f[0]));
+      if (task == nullptr)
+      {
+        diverge(record.tick);
+        return;
+      }
+      tick = end_task_at(task, f[1]);
+      break;
+    }
+    case REPLAY_MODE_CHANGE:
+      result = request_mode_change(unsigned(f[0]), mode_change_protocol(f[1]), tick);
+      if (result == accepted && tick != f[2])
+        diverge(record.tick);
+      break;
+    default:
+      return;
+  }
+  _result->requests++;
+  uint64_t outcome = (record.type == REPLAY_END_TASK) ? uint64_t(tick) : uint64_t(result);
+  if (outcome != f[result_fields[record.type]])
+    diverge(record.tick);
+}
+
+static
+void replay_dispatch(const replay_record_t& record)
+{
+  unsigned& upto = get_item_upto();
+  if (upto >= get_items_in_scheduled_item_list())
+  {
+    diverge(record.tick);
+    return;
+  }
+  scheduled_item_t* item = &get_scheduled_item_list()[upto];
+  task_t* task = item->task;
+  if (slot_of(task) != record.fields[0])
+  {
+    diverge(record.tick);
+    return;
+  }
+  set_current_tick(record.tick);
+  uint32_t deadline_failures = task->deadline_failures;
+  run_scheduled_item(item);
+  upto++;
+  _result->dispatches++;
+  _result->deadline_misses += task->deadline_failures - deadline_failures;
+}
+
+
+// Implementation
+
+bool replay_start_recording(replay_writer_t write, void* context)
+{
+  if (_recording || _replaying)
+    return false;
+  _write = write;
+  _context = context;
+  _buffer_size = 0;
+  _last_tick = current_tick();
+
+  replay_header_t header = {};
+  header.magic = REPLAY_MAGIC;
+  header.version = REPLAY_VERSION;
+  header.timer_frequency = timer_frequency();
+  header.start_tick = _last_tick;
+  write(&header, sizeof(header), context);
+  _recording = true;
+  return true;
+}
+
+void replay_stop_recording()
+{
+  if (!_recording)
+    return;
+  flush_records();
+  _recording = false;
+}
+
+bool replay_recording()
+{
+  return _recording;
+}
+
+bool replay_replaying()
+{
+  return _replaying;
+}
+
+void replay_request_started()
+{
+  _request_depth++;
+}
+
+void replay_record_request(replay_record_type_t type, const uint64_t* fields, unsigned field_count, const char* name)
+{
+  if (--_request_depth == 0 && _recording)
+    write_record(type, fields, field_count, name);
+}
+
+void replay_dispatched(const task_t* task)
+{
+  if (!_recording)
+    return;
+  uint64_t slot = slot_of(task);
+  write_record(REPLAY_DISPATCH, &slot, 1, nullptr);
+}
+
+void replay_task_ran(task_t* task)
+{
+  if (_recording)
+  {
+    uint64_t fields[2] = { slot_of(task), current_tick() - task->last_exec_start };
+    write_record(REPLAY_EXEC, fields, 2, nullptr);
+    return;
+  }
+  if (!_replaying)
+    return;
+
+  // what the task asked for while it ran is made again, up to its end
+  replay_record_t record;
+  while (!_diverged && read_record(record))
+  {
+    if (record.type == REPLAY_EXEC)
+    {
+      if (record.fields[0] != slot_of(task))
+        diverge(record.tick);
+      task->last_exec_start = record.tick - record.fields[1];
+      set_current_tick(record.tick);
+      return;
+    }
+    if (record.type == REPLAY_DISPATCH)
+    {
+      // the task never finished, such as if it was stopped for overrunning
+      unread_record(record);
+      diverge(record.tick);
+      return;
+    }
+    replay_request(record);
+  }
+}
+
+void replay_record_random(unsigned upper_bound, unsigned value)
+{
+  if (!_recording)
+    return;
+  uint64_t fields[2] = { upper_bound, value };
+  write_record(REPLAY_RANDOM, fields, 2, nullptr);
+}
+
+void replay_record_key(int key)
+{
+  if (!_recording)
+    return;
+  uint64_t field = uint64_t(unsigned(key));
+  write_record(REPLAY_KEY, &field, 1, nullptr);
+}
+
+task_entry_t replay_task_entry(task_entry_t func_ptr)
+{
+  return (_replaying && func_ptr != online_scheduler) ? replayed_task : func_ptr;
+}
+
+// The loop is that of run_on_line_scheduler(), with the waits for the
+// items to be due and the keyboard replaced by the recording.
+bool replay_schedule(replay_reader_t read, void* context, replay_result_t& result)
+{
+  result = {};
+  if (_recording || _replaying)
+    return false;
+  _read = read;
+  _context = context;
+  _buffer_size = 0;
+  _buffer_read = 0;
+  _have_unread_record = false;
+  _diverged = false;
+  _result = &result;
+
+  replay_header_t header;
+  for (uint8_t* out = (uint8_t*)&header; out < (uint8_t*)(&header + 1); out++)
+    if (!read_byte(*out))
+      return false;
+  if (header.magic != REPLAY_MAGIC || header.version != REPLAY_VERSION)
+    return false;
+
+  _replaying = true;
+  _last_tick = header.start_tick;
+  set_current_tick(header.start_tick);
+  get_item_upto() = 0;
+
+  replay_record_t record;
+  while (!_diverged && read_record(record))
+  {
+    if (record.type == REPLAY_DISPATCH)
+      replay_dispatch(record);
+    else if (is_request(record.type))
+      replay_request(record);
+    // the random values and keys were only what the tasks and the user did
+  }
+
+  result.end_tick = current_tick();
+  _replaying = false;
+  return true;
+}
@@ -7,14 +7,34 @@
 #include "conio.h"
 #include "module/timer.h"
 #include "runtime/memory.h"
-#include "runtime/utilities.h"
+#include "common/sort.hpp"
 //#include "runtime.h"
 #include "kernel.h"
 #include "schedule.h"
+#include "elastic.h"
+#include "trace.h"
+#include "replay.h"
 
-#define EVENT_HORIZON          (2 * UPDATE_SCHEDULE_RATE)
 //#define MAX_SCHEDULED_ITEMS    50
 
+// the debug build checks the schedule is sorted each time it is sorted
+#if defined(ENABLE_DEBUG) && !defined(ENABLE_SCHEDULE_VALIDATION)
+#define ENABLE_SCHEDULE_VALIDATION
+#endif
+
+// Limits of how often the online scheduler runs, see tune_event_horizon()
+#define MIN_UPDATE_SCHEDULE_RATE   100
+#define MAX_UPDATE_SCHEDULE_RATE   (10 * UPDATE_SCHEDULE_RATE)
+#define MAX_ITEMS_PER_UPDATE       256   // bounds the work done by each online_scheduler()
+#define DENSITY_SCALE              65536 // job density is in jobs per this many ticks
+
+static
+ticks_t _update_schedule_rate = UPDATE_SCHEDULE_RATE;
+
+// how far ahead periodic tasks are converted to scheduled items
+static
+ticks_t _event_horizon = 2 * UPDATE_SCHEDULE_RATE;
+
 static
 unsigned _items_in_scheduled_item_list = 0;
 
@@ -24,8 +44,32 @@ unsigned _item_upto = 0;
 static
 unsigned _index_sorted_upto = 0;
 
+// while set, new items are appended unsorted and merged in by sort_schedule()
+static
+bool _defer_sorting = false;
+
+// the item being run, which must stay where it is in the list
+static
+scheduled_item_t* _running_item = nullptr;
+
+// The tables of scheduled items are kept together so that they can be backed
+// by a huge page, see get_schedule_tables()
+struct alignas(SCHEDULE_TABLES_ALIGNMENT) schedule_tables_t
+{
+  scheduled_item_t  items[MAX_SCHEDULED_ITEMS];
+  // the batch of new items is copied here to merge it with the sorted items
+  scheduled_item_t  merge_buffer[MAX_SCHEDULED_ITEMS];
+  scheduled_item_t  saved_items[MAX_SCHEDULED_ITEMS];
+};
+
+static
+schedule_tables_t _schedule_tables;
+
 static
-scheduled_item_t _scheduled_item_list[MAX_SCHEDULED_ITEMS - 1];
+scheduled_item_t (&_scheduled_item_list)[MAX_SCHEDULED_ITEMS] = _schedule_tables.items;
+
+static
+scheduled_item_t (&_merge_buffer)[MAX_SCHEDULED_ITEMS] = _schedule_tables.merge_buffer;
 
 unsigned get_items_in_scheduled_item_list()
 {
@@ -47,38 +91,128 @@ scheduled_item_t* get_scheduled_item_list()
   return _scheduled_item_list;
 }
 
+void get_schedule_tables(void*& tables, size_t& size)
+{
+  tables = &_schedule_tables;
+  size = sizeof(_schedule_tables);
+}
+
+// a task is finished once it has no more jobs to convert and its last has run
+static
+bool task_finished(const task_t* task)
+{
+  if (task->pending_jobs)
+    return false;
+  if (task->period == 0)
+    return true;
+  return task->complete_not_after != 0 && !tick_before(task->time_evaluated_upto, task->complete_not_after);
+}
+
+// removes a task, leaving its slot for reuse
+static
+void retire_task(task_t* task)
+{
+  remove_task_from_schedule(task);
+  tune_event_horizon();
+  // the elastic tasks can have back what it was using
+  if (elastic_scheduling_enabled())
+    compress_elastic_tasks();
+}
+
+static
+unsigned count_bits(uint32_t bits)
+{
+  unsigned count = 0;
+  for (; bits; bits &= bits - 1)
+    count++;
+  return count;
+}
+
+static
+uint32_t firm_window_mask(const task_t* task)
+{
+  return (task->firm_k >= MAX_FIRM_WINDOW) ? ~0U : (1U << task->firm_k) - 1;
+}
+
+bool task_can_miss_deadline(const task_t* task)
+{
+  if (task->firm_k == 0)
+    return false;
+  return count_bits((task->deadline_history << 1) & firm_window_mask(task)) >= task->firm_m;
+}
+
+static
+void record_deadline(task_t* task, bool met)
+{
+  task->deadline_history = (task->deadline_history << 1) | (met ? 1 : 0);
+  if (task->firm_k && count_bits(task->deadline_history & firm_window_mask(task)) < task->firm_m)
+    task->firm_violations++;
+}
+
+// Skip-over. An optional job of a firm task is skipped if it is going to
+// miss its deadline anyway, or if running it would make the next job miss
+// a deadline which it could otherwise meet. So under overload the time
+// goes to the jobs which are needed to keep to the constraints.
+static
+bool skip_job(const scheduled_item_t* item)
+{
+  const task_t* task = item->task;
+  if (!task_can_miss_deadline(task))
+    return false;
+
+  tick_t now = current_tick();
+  tick_t end = now + task->exec_bound;
+  if (tick_after(end, item->complete_not_after))
+    return true;
+
+  const scheduled_item_t* next = item + 1;
+  if (next >= &_scheduled_item_list[_items_in_scheduled_item_list] || next->done)
+    return false;
+  tick_t next_start = tick_after(next->start_not_before, now) ? next->start_not_before : now;
+  if (tick_after(next_start + next->task->exec_bound, next->complete_not_after))
+    return false;
+  if (tick_before(next_start, end))
+    next_start = end;
+  return tick_after(next_start + next->task->exec_bound, next->complete_not_after);
+}
+
 void run_scheduled_item(scheduled_item_t *item)
 {
-  run_task(item->task);
-  if (item->task->last_exec_end > item->complete_not_after)
-    item->task->deadline_failures++;
+  bool met = false;
+  replay_dispatched(item->task);
+  trace_event(TRACE_RELEASE, item->task, uint32_t(item->start_not_before));
+  if (skip_job(item))
+  {
+    item->task->jobs_skipped++;
+    trace_event(TRACE_JOB_SKIPPED, item->task, 0);
+  }
+  else
+  {
+    _running_item = item;
+    run_task(item->task);
+    // the list may have been purged while it ran, which moves the item
+    item = _running_item;
+    _running_item = nullptr;
+    met = !tick_after(item->task->last_exec_end, item->complete_not_after);
+    if (!met)
+    {
+      item->task->deadline_failures++;
+      trace_event(TRACE_DEADLINE_MISS, item->task, uint32_t(item->task->last_exec_end - item->complete_not_after));
+    }
+  }
+  record_deadline(item->task, met);
   item->done = true;
+  item->task->pending_jobs--;
+  if (task_finished(item->task))
+    retire_task(item->task);
 }
 
 // compares items using the earliest deadline algorithm
-static
 int scheduled_item_cmp(const void *a, const void *b)
 {
   const scheduled_item_t *a_item = static_cast<const scheduled_item_t*>(a);
   const scheduled_item_t *b_item = static_cast<const scheduled_item_t*>(b);
-/* 
-  // Probably shouldn't need to be sorting done items - that should be an assert
-  if (a_item->done == true)
-    return -1;
-  if (b_item->done == true)
-    return 1;
-*/
-  // having to wait_for another task has precedence over earliest deadline
-  if (a_item->task->wait_for != 0)
-    if (a_item->task->wait_for == b_item->task->task_name)
-      return 1;
-
-  if (b_item->task->wait_for != 0)
-    if (b_item->task->wait_for == a_item->task->task_name)
-      return -1;
-
-  // sort items according to the "earliest deadline" algorithm
-  return (a_item->complete_not_after < b_item->complete_not_after) ? -1 : 1;
+  return scheduled_item_less(*a_item, *b_item) ? -1 : 1;
 
   /*
   // "least slack algorithm"
@@ -100,19 +234,62 @@ int scheduled_item_cmp(const void *a, const void *b)
   return 0;
   return (a_item->start_not_before < b_item->start_not_before) ? -1 : 1;
   */
+}
 
+// the first item which can be reordered, items before it are done or running
+static
+unsigned first_pending_item()
+{
+  unsigned first = _item_upto;
+  // the run loop only moves past an item after it has been run
+  if (first < _items_in_scheduled_item_list && (_running_item == &_scheduled_item_list[first] || _scheduled_item_list[first].done))
+    first++;
+  return first;
 }
 
 // order the schedule by ordering items in the scheduled item list
+//
+// The items from _index_sorted_upto on are a batch which has been added
+// since the last sort. The batch is sorted on its own and then merged
+// in to the sorted items from the back, which is O(n + k log k) instead
+// of resorting everything after where the batch overlaps.
 void sort_schedule()
 {
-  k_qsort(static_cast<void *>(&_scheduled_item_list[_index_sorted_upto]), _items_in_scheduled_item_list - _index_sorted_upto, sizeof(scheduled_item_t), scheduled_item_cmp);
+  unsigned first = first_pending_item();
+  unsigned batch_start = (_index_sorted_upto > first) ? _index_sorted_upto : first;
+  unsigned batch_count = _items_in_scheduled_item_list - batch_start;
+  scheduled_item_t* batch = &_scheduled_item_list[batch_start];
+  sort(batch, batch_count, scheduled_item_less);
+
+  // nothing to do if the whole batch goes after the sorted items
+  if (batch_count && batch_start > first && scheduled_item_less(batch[0], batch[-1]))
+  {
+    // sorted items before where the first of the batch goes stay where they are
+    unsigned merge_start = first + upperBound(&_scheduled_item_list[first], batch_start - first, batch[0], scheduled_item_less);
+    mem_cpy(_merge_buffer, batch, batch_count * sizeof(scheduled_item_t));
+    unsigned out = _items_in_scheduled_item_list;
+    unsigned sorted = batch_start;
+    unsigned batched = batch_count;
+    while (batched)
+    {
+      if (sorted > merge_start && scheduled_item_less(_merge_buffer[batched - 1], _scheduled_item_list[sorted - 1]))
+        _scheduled_item_list[--out] = _scheduled_item_list[--sorted];
+      else
+        _scheduled_item_list[--out] = _merge_buffer[--batched];
+    }
+  }
+
+#ifdef ENABLE_SCHEDULE_VALIDATION
+  // O(n) so only for debugging the scheduler
+  if (!isSorted(&_scheduled_item_list[first], _items_in_scheduled_item_list - first, scheduled_item_less))
+    k_critical_error(129, " ###### not sorted ###### ");
+#endif
   _index_sorted_upto = _items_in_scheduled_item_list;
 }
 
 bool add_to_scheduled_item_list(task_t *task, tick_t start_not_before, tick_t complete_not_after)
 {
-  // due to using qsort as the sorting method, the list is a fixed size
+  // due to sorting the list in place, the list is a fixed size
   // array that will eventually run out
   // one possible way to avoid this is to divide the array into two halves
   // and copy the second half into the first half when the item we are up to
@@ -124,37 +301,35 @@ bool add_to_scheduled_item_list(task_t *task, tick_t start_not_before, tick_t co
     return false;
   }
 
-  scheduled_item_t *new_item = &_scheduled_item_list[_items_in_scheduled_item_list];
-  new_item->done = false;
-  new_item->task = task;
-  new_item->start_not_before = start_not_before;
-  new_item->complete_not_after = complete_not_after;
+  scheduled_item_t new_item;
+  new_item.done = false;
+  new_item.task = task;
+  new_item.start_not_before = start_not_before;
+  new_item.complete_not_after = complete_not_after;
 
-  if (_items_in_scheduled_item_list && _index_sorted_upto)
+  task->pending_jobs++;
+
+  // when adding many items, they are batched up and merged in by sort_schedule()
+  if (_defer_sorting || _index_sorted_upto != _items_in_scheduled_item_list)
   {
-    if (_scheduled_item_list[_index_sorted_upto - 1].complete_not_after > start_not_before)
-    {
-      // find first item (from the one we are up to) which completes before this one can start
-      // this is the first item which doesn't overlap, we then need to re-sort from this first overlapping item to the last item
-      // essentially, this will be doing an insertion, however it might not be as straight forward as doing a bsearch.
-      unsigned old_index_sorted_upto = _index_sorted_upto;
-      _index_sorted_upto = _item_upto;
-      while ((_scheduled_item_list[_index_sorted_upto].complete_not_after < start_not_before) && (_index_sorted_upto <= old_index_sorted_upto))
-      {
-        _index_sorted_upto++;
-      }
-      sort_schedule();
-    }
+    _scheduled_item_list[_items_in_scheduled_item_list++] = new_item;
+    return true;
   }
 
+  // otherwise insert it where it goes, which is usually at or near the end
+  unsigned first = first_pending_item();
+  unsigned index = first + upperBound(&_scheduled_item_list[first], _items_in_scheduled_item_list - first, new_item, scheduled_item_less);
+  mem_move(&_scheduled_item_list[index + 1], &_scheduled_item_list[index], (_items_in_scheduled_item_list - index) * sizeof(scheduled_item_t));
+  _scheduled_item_list[index] = new_item;
   _items_in_scheduled_item_list++;
+  _index_sorted_upto = _items_in_scheduled_item_list;
   return true;
 }
 
 bool convert_periodic_tasks_to_scheduled_items_upto_event_horizon(task_t *item)
 {
   // if item has already been evaluated beyond this event horizon do nothing
-  if (item->time_evaluated_upto > current_tick() + EVENT_HORIZON)
+  if (tick_after(item->time_evaluated_upto, current_tick() + _event_horizon))
   {
     return true;
   }
@@ -164,28 +339,29 @@ bool convert_periodic_tasks_to_scheduled_items_upto_event_horizon(task_t *item)
 
   // evaluate enough forward so the task will be evaluated upto at least
   // the next time the online scheduler will be run
-  tick_t finish_time = item->time_evaluated_upto + UPDATE_SCHEDULE_RATE;
+  tick_t finish_time = item->time_evaluated_upto + _update_schedule_rate;
 
   // if the task is not to run after a given time, don't schedule it past that
   if (item->complete_not_after != 0)
   {
-    if (item->complete_not_after < finish_time)
+    if (tick_before(item->complete_not_after, finish_time))
     {
       finish_time = item->complete_not_after;
 
       // if the task has run it's last execution, remove it from the
-      // task list, or mark it with a boolean as being completed
-      if (schedule_time > finish_time)
+      // task list. Usually this happens when its last job is run, this
+      // is in case it didn't have any jobs left at that point.
+      if (tick_after(schedule_time, finish_time))
       {
-        // remove_task_item(item);
-        // needs to happen after the last time it's to be executed
+        if (task_finished(item))
+          retire_task(item);
         return true;
       }
     }
   }
 
   // convert the periodic task to a series of aperiodic events
-  while (schedule_time < finish_time)
+  while (tick_before(schedule_time, finish_time))
   {
     // its my understanding that a periodic task can be run anytime within
     // its period. I interpret the variables "start_not_before" and
@@ -228,6 +404,8 @@ void purge_completed_scheduled_items()
         k_critical_error(137, "item_upto %i is not equal to %i\n", _item_upto, i);
 
       _item_upto -= i;
+      if (_running_item)
+        _running_item -= i;
       if (_index_sorted_upto >= i)
         _index_sorted_upto -= i;
       else
@@ -241,8 +419,11 @@ void purge_completed_scheduled_items()
 void online_scheduler()
 {
   purge_completed_scheduled_items();
+  // all the new items are merged in to the schedule at once
+  _defer_sorting = true;
   for (unsigned i = 0; i < items_in_list; i++)
   {
+    // removed tasks have a period of 0 so are passed over
     if (task_list[i].period != 0)
     {
       if (!convert_periodic_tasks_to_scheduled_items_upto_event_horizon(&task_list[i]))
@@ -251,6 +432,7 @@ void online_scheduler()
       }
     }
   }
+  _defer_sorting = false;
   sort_schedule();
 
   //  refine_schedule();
@@ -262,16 +444,14 @@ void online_scheduler()
   // repeat until done for all item's in aperiodic list
 }
 
-static tick_t saved_current_tick;
 static unsigned saved_items_in_schedule_list;
 static unsigned saved_item_upto;
 static unsigned saved_index_sorted_upto;
-static scheduled_item_t saved_schedule_list[MAX_SCHEDULED_ITEMS - 1];
+static scheduled_item_t (&saved_schedule_list)[MAX_SCHEDULED_ITEMS] = _schedule_tables.saved_items;
 
 // save the current state of the scheduled list and its variables
 void save_schedule_list_state()
 {
-  saved_current_tick = current_tick();
   saved_items_in_schedule_list = _items_in_scheduled_item_list;
   saved_item_upto = _item_upto;
   saved_index_sorted_upto = _index_sorted_upto;
@@ -282,10 +462,10 @@ void save_schedule_list_state()
     task_list[item].saved_time_evaluated_upto = task_list[item].time_evaluated_upto;
 }
 
-// restore the state of the scheduled list and its variables
+// restore the state of the scheduled list and its variables, the clock
+// carries on from where it is as it can't be wound back while running
 void restore_schedule_list_state()
 {
-  set_current_tick(saved_current_tick);
   _items_in_scheduled_item_list = saved_items_in_schedule_list;
   _item_upto = saved_item_upto;
   _index_sorted_upto = saved_index_sorted_upto;
@@ -300,7 +480,13 @@ void restore_schedule_list_state()
   //items_in_list--;
 
   for (unsigned item = 0; item < items_in_list; item++)
+  {
     task_list[item].time_evaluated_upto = task_list[item].saved_time_evaluated_upto;
+    task_list[item].pending_jobs = 0;
+  }
+  for (unsigned item = _item_upto; item < _items_in_scheduled_item_list; item++)
+    if (!_scheduled_item_list[item].done)
+      _scheduled_item_list[item].task->pending_jobs++;
 }
 
 // trys to work out if there is a viable schedule
@@ -413,11 +599,110 @@ acceptance_codes off_line_scheduler(task_t *task)
   return accepted;
 }
 
+ticks_t schedule_update_rate()
+{
+  return _update_schedule_rate;
+}
+
+ticks_t event_horizon()
+{
+  return _event_horizon;
+}
+
+static
+unsigned remove_pending_items(task_t* task, tick_t from, tick_t* earliest_start);
+
+// Works out how often the online scheduler needs to run, and so how far
+// ahead the event horizon is, from the periodic tasks.
+//
+// Each run converts the jobs of the next update period, while the list
+// holds the jobs up to the horizon, two update periods, plus the period
+// being converted. With D jobs per tick, a run adds D * rate items and
+// the list holds about 3 * D * rate, so the rate is the largest which
+// keeps both of those within bounds. A light load gets a long period,
+// so the scheduler runs less often, and a heavy one a short period, so
+// the list doesn't fill with short period jobs.
+void tune_event_horizon()
+{
+  ticks_t previous_rate = _update_schedule_rate;
+  task_t* scheduler_task = nullptr;
+  uint32_t density = 0;          // jobs per DENSITY_SCALE ticks
+  unsigned aperiodic_items = 0;
+  for (unsigned i = 0; i < items_in_list; i++)
+  {
+    task_t* task = &task_list[i];
+    if (task->func_ptr == online_scheduler)
+      scheduler_task = task;
+    else if (task->period != 0)
+      density += uint32_t((DENSITY_SCALE + task->period - 1) / task->period);
+    else if (tick_after(task->complete_not_after, current_tick()))
+      aperiodic_items++;
+  }
+
+  // items are purged once the list is half full, so that is the capacity
+  uint32_t capacity = MAX_SCHEDULED_ITEMS / 2;
+  capacity = (aperiodic_items < capacity) ? capacity - aperiodic_items : 0;
+
+  uint64_t rate = MAX_UPDATE_SCHEDULE_RATE;
+  if (density)
+  {
+    uint64_t per_update_limit = (uint64_t(MAX_ITEMS_PER_UPDATE) * DENSITY_SCALE) / density;
+    uint64_t capacity_limit = (uint64_t(capacity) * DENSITY_SCALE) / (3 * density);
+    rate = (per_update_limit < capacity_limit) ? per_update_limit : capacity_limit;
+  }
+  if (rate < MIN_UPDATE_SCHEDULE_RATE)
+    rate = MIN_UPDATE_SCHEDULE_RATE;
+  if (rate > MAX_UPDATE_SCHEDULE_RATE)
+    rate = MAX_UPDATE_SCHEDULE_RATE;
+
+  _update_schedule_rate = ticks_t(rate);
+  _event_horizon = 2 * _update_schedule_rate;
+
+  // the online scheduler runs a little more often than the rate so the
+  // next period is always converted before it starts
+  if (scheduler_task)
+    scheduler_task->period = _update_schedule_rate - 1;
+
+  // The jobs are only converted a new period ahead, so when the rate is
+  // shortened the online scheduler's next run, which was a whole old
+  // period away, is brought forward to now. Otherwise there would be no
+  // jobs between the end of what is converted and that run.
+  if (scheduler_task && _update_schedule_rate < previous_rate)
+  {
+    remove_pending_items(scheduler_task, 0, nullptr);
+    scheduler_task->time_evaluated_upto = current_tick();
+    convert_periodic_tasks_to_scheduled_items_upto_event_horizon(scheduler_task);
+  }
+}
+
+static
+acceptance_codes admit_task(task_t* task);
+
+// records the outcome of asking to add a task, the task is nullptr if it
+// was turned away before it was added
+static
+acceptance_codes trace_admission(const task_t* task, acceptance_codes code)
+{
+  trace_event(TRACE_ADMISSION, task, code);
+  return code;
+}
+
+// records the request if it isn't made by another, its result in the last field
+static
+acceptance_codes record_request(replay_record_type_t type, uint64_t* fields, unsigned field_count,
+                                const char* name, acceptance_codes result)
+{
+  fields[field_count - 1] = result;
+  replay_record_request(type, fields, field_count, name);
+  return result;
+}
+
 // returns true if it aded task else it returns an error code
-acceptance_codes request_to_add_task(void (*func_ptr)(), id_t task_name,
-                                     id_t wait_for, tick_t start_not_before, ticks_t exec_bound,
-                                     tick_t complete_not_after, ticks_t period,
-                                     const char *name, unsigned x_pos, unsigned y_pos)
+static
+acceptance_codes add_task(void (*func_ptr)(), id_t task_name,
+                          id_t wait_for, tick_t start_not_before, ticks_t exec_bound,
+                          tick_t complete_not_after, ticks_t period,
+                          const char *name, unsigned x_pos, unsigned y_pos)
 {
 
   // reject tasks that obviously will fail and then use the
@@ -433,15 +718,227 @@ acceptance_codes request_to_add_task(void (*func_ptr)(), id_t task_name,
 
   if (wait_for != 0)
   {
-    if (search_for_task_in_schedule(task_name) == nullptr)
+    if (search_for_task_in_schedule(wait_for) == nullptr)
     {
-      return wait_for_not_present;
+      return trace_admission(nullptr, wait_for_not_present);
     }
   }
 
   if ((start_not_before != 0) && (complete_not_after != 0))
   {
-    if (start_not_before + exec_bound > complete_not_after)
+    if (tick_after(start_not_before + exec_bound, complete_not_after))
+    {
+      return trace_admission(nullptr, bound_gt_start_to_complete);
+    }
+  }
+
+  if (period != 0)
+  {
+    if (exec_bound > period)
+    {
+      return trace_admission(nullptr, bound_gt_period);
+    }
+  }
+
+  task_t* task = add_task_to_schedule(func_ptr, task_name, wait_for, start_not_before,
+                                      exec_bound, complete_not_after, period, name, x_pos, y_pos);
+  if (task == nullptr)
+  {
+    return trace_admission(nullptr, schedule_full);
+  }
+
+  return admit_task(task);
+}
+
+acceptance_codes request_to_add_task_ns(void (*func_ptr)(), id_t task_name,
+                                        id_t wait_for, uint64_t start_not_before_ns, uint64_t exec_bound_ns,
+                                        uint64_t complete_not_after_ns, uint64_t period_ns,
+                                        const char *name, unsigned x_pos, unsigned y_pos)
+{
+  uint32_t frequency = timer_frequency();
+  ticks_t period = ns_to_ticks(period_ns, frequency);
+  if (period_ns != 0 && period == 0)
+  {
+    return trace_admission(nullptr, bound_gt_period);
+  }
+
+  // times of 0 mean not set, so those are kept as 0
+  tick_t start_not_before = ns_to_ticks_rounded_up(start_not_before_ns, frequency);
+  tick_t complete_not_after = ns_to_ticks(complete_not_after_ns, frequency);
+  if (complete_not_after_ns != 0 && complete_not_after == 0)
+  {
+    return trace_admission(nullptr, bound_gt_start_to_complete);
+  }
+
+  return request_to_add_task(func_ptr, task_name, wait_for, start_not_before,
+                             ns_to_ticks_rounded_up(exec_bound_ns, frequency),
+                             complete_not_after, period, name, x_pos, y_pos);
+}
+
+static
+acceptance_codes add_elastic_task(void (*func_ptr)(), id_t task_name, id_t wait_for,
+                                  ticks_t exec_bound, ticks_t min_period, ticks_t max_period,
+                                  uint32_t elasticity, const char *name, unsigned x_pos, unsigned y_pos)
+{
+  if (min_period == 0 || min_period > max_period)
+  {
+    return trace_admission(nullptr, bound_gt_period);
+  }
+
+  if (exec_bound > min_period)
+  {
+    return trace_admission(nullptr, bound_gt_period);
+  }
+
+  if (wait_for != 0)
+  {
+    if (search_for_task_in_schedule(wait_for) == nullptr)
+    {
+      return trace_admission(nullptr, wait_for_not_present);
+    }
+  }
+
+  task_t* task = add_task_to_schedule(func_ptr, task_name, wait_for, 0,
+                                      exec_bound, 0, min_period, name, x_pos, y_pos);
+  if (task == nullptr)
+  {
+    return trace_admission(nullptr, schedule_full);
+  }
+  task->min_period = min_period;
+  task->max_period = max_period;
+  task->elasticity = elasticity;
+
+  return admit_task(task);
+}
+
+// Admits a task which has been added to the task list, converting its jobs
+// in to the schedule. In elastic scheduling, if the new task would overload
+// the system the elastic tasks' periods are stretched to make room, or if
+// they can't stretch enough the task is rejected.
+static
+acceptance_codes admit_task(task_t* task)
+{
+  if (elastic_scheduling_enabled() && task->period != 0)
+  {
+    if (!compress_elastic_tasks())
+    {
+      remove_task_from_schedule(task);
+      return trace_admission(task, can_not_be_scheduled_with_the_other_tasks);
+    }
+  }
+
+  // before it is converted, so it is converted with the new horizon
+  tune_event_horizon();
+  return trace_admission(task, off_line_scheduler(task));
+}
+
+// Removes the task's jobs which haven't started and start from the given
+// tick from the schedule, keeping the order of the rest. Returns how many
+// were removed, and the earliest start of them in earliest_start if it is
+// given.
+static
+unsigned remove_pending_items(task_t* task, tick_t from, tick_t* earliest_start)
+{
+  unsigned first = first_pending_item();
+  unsigned out = first;
+  unsigned removed = 0;
+  unsigned removed_sorted = 0;
+  for (unsigned i = first; i < _items_in_scheduled_item_list; i++)
+  {
+    const scheduled_item_t& item = _scheduled_item_list[i];
+    if (item.task == task && !item.done && !tick_before(item.start_not_before, from))
+    {
+      if (earliest_start && (!removed || tick_before(item.start_not_before, *earliest_start)))
+        *earliest_start = item.start_not_before;
+      if (i < _index_sorted_upto)
+        removed_sorted++;
+      removed++;
+      continue;
+    }
+    if (out != i)
+      _scheduled_item_list[out] = item;
+    out++;
+  }
+  _items_in_scheduled_item_list = out;
+  _index_sorted_upto -= removed_sorted;
+  task->pending_jobs -= removed;
+  return removed;
+}
+
+static
+acceptance_codes remove_task(id_t task_name)
+{
+  task_t* task = search_for_task_in_schedule(task_name);
+  if (task == nullptr)
+  {
+    return task_not_present;
+  }
+
+  remove_pending_items(task, 0, nullptr);
+
+  // a task removing itself is retired once its current job has finished
+  task->period = 0;
+  if (task_finished(task))
+    retire_task(task);
+  return accepted;
+}
+
+// replaces the jobs of the task which haven't started with ones for its new
+// period, exec_bound and deadline
+static
+acceptance_codes reschedule_task(task_t* task, ticks_t period, ticks_t exec_bound, tick_t complete_not_after)
+{
+  // only the jobs of this task which haven't started are replaced
+  tick_t earliest_start = 0;
+  unsigned removed = remove_pending_items(task, 0, &earliest_start);
+
+  task->period = period;
+  task->exec_bound = exec_bound;
+  task->complete_not_after = complete_not_after;
+  tune_event_horizon();
+
+  if (period != 0)
+  {
+    // convert again from the first of the jobs which were removed
+    if (removed)
+      task->time_evaluated_upto = earliest_start;
+    if (!convert_periodic_tasks_to_scheduled_items_upto_event_horizon(task))
+    {
+      return scheduled_item_buffer_too_small;
+    }
+  }
+  else if (removed && (task->start_not_before != 0) && (complete_not_after != 0))
+  {
+    if (!add_to_scheduled_item_list(task, task->start_not_before, complete_not_after))
+    {
+      return scheduled_item_buffer_too_small;
+    }
+  }
+  else if (task_finished(task))
+  {
+    retire_task(task);
+  }
+
+  return accepted;
+}
+
+acceptance_codes set_elastic_period(task_t* task, ticks_t period)
+{
+  return reschedule_task(task, period, task->exec_bound, task->complete_not_after);
+}
+
+static
+acceptance_codes update_task(id_t task_name, ticks_t period, ticks_t exec_bound, tick_t complete_not_after)
+{
+  task_t* task = search_for_task_in_schedule(task_name);
+  if (task == nullptr)
+  {
+    return task_not_present;
+  }
+
+  if ((task->start_not_before != 0) && (complete_not_after != 0))
+  {
+    if (tick_after(task->start_not_before + exec_bound, complete_not_after))
     {
       return bound_gt_start_to_complete;
     }
@@ -455,13 +952,162 @@ acceptance_codes request_to_add_task(void (*func_ptr)(), id_t task_name,
     }
   }
 
-  if (add_task_to_schedule(func_ptr, task_name, wait_for, start_not_before,
-        exec_bound, complete_not_after, period, name, x_pos, y_pos) == false)
+  // The period asked for is the one an elastic task would like, its
+  // min_period, which it can still be stretched from up to its max_period.
+  // As the exec_bound is checked against it, it fits in the min_period.
+  bool elastic = (task->elasticity != 0) && (task->min_period < task->max_period) && (period != 0);
+  if (elastic && period > task->max_period)
   {
-    return schedule_full;
+    return bound_gt_period;
   }
+  ticks_t min_period = period;
+  ticks_t max_period = elastic ? task->max_period : period;
 
-  return off_line_scheduler(&task_list[items_in_list - 1]);
+  // in elastic scheduling the periodic tasks are fitted in again, which is
+  // checked before any of the task's jobs are replaced
+  if (elastic_scheduling_enabled() && (period != 0 || task->period != 0))
+  {
+    task_t previous = *task;
+    task->period = period;
+    task->exec_bound = exec_bound;
+    task->complete_not_after = complete_not_after;
+    task->min_period = min_period;
+    task->max_period = max_period;
+    if (!compress_elastic_tasks())
+    {
+      *task = previous;
+      return can_not_be_scheduled_with_the_other_tasks;
+    }
+    // it may have been stretched
+    period = task->period;
+  }
+  task->min_period = min_period;
+  task->max_period = max_period;
+  return reschedule_task(task, period, exec_bound, complete_not_after);
+}
+
+static
+acceptance_codes set_firm_constraint(id_t task_name, unsigned m, unsigned k)
+{
+  task_t* task = search_for_task_in_schedule(task_name);
+  if (task == nullptr)
+  {
+    return task_not_present;
+  }
+
+  if (k != 0 && (m == 0 || m > k || k > MAX_FIRM_WINDOW))
+  {
+    return firm_constraint_invalid;
+  }
+
+  task->firm_m = (k != 0) ? m : 0;
+  task->firm_k = k;
+  // the jobs before the constraint was set count as having met their deadlines
+  task->deadline_history = ~0U;
+  return accepted;
+}
+
+// The requests are recorded for replaying, see replay.h
+
+acceptance_codes request_to_add_task(void (*func_ptr)(), id_t task_name,
+                                     id_t wait_for, tick_t start_not_before, ticks_t exec_bound,
+                                     tick_t complete_not_after, ticks_t period,
+                                     const char *name, unsigned x_pos, unsigned y_pos)
+{
+  uint64_t flags = (func_ptr == online_scheduler) ? REPLAY_TASK_IS_SCHEDULER : 0;
+  uint64_t fields[] = { task_name, wait_for, start_not_before, exec_bound, complete_not_after, period, x_pos, y_pos, flags, 0 };
+  replay_request_started();
+  acceptance_codes result = add_task(func_ptr, task_name, wait_for, start_not_before, exec_bound,
+                                     complete_not_after, period, name, x_pos, y_pos);
+  return record_request(REPLAY_ADD_TASK, fields, 10, name, result);
+}
+
+acceptance_codes request_to_add_elastic_task(void (*func_ptr)(), id_t task_name, id_t wait_for,
+                                             ticks_t exec_bound, ticks_t min_period, ticks_t max_period,
+                                             uint32_t elasticity, const char *name, unsigned x_pos, unsigned y_pos)
+{
+  uint64_t flags = (func_ptr == online_scheduler) ? REPLAY_TASK_IS_SCHEDULER : 0;
+  uint64_t fields[] = { task_name, wait_for, exec_bound, min_period, max_period, elasticity, x_pos, y_pos, flags, 0 };
+  replay_request_started();
+  acceptance_codes result = add_elastic_task(func_ptr, task_name, wait_for, exec_bound, min_period,
+                                             max_period, elasticity, name, x_pos, y_pos);
+  return record_request(REPLAY_ADD_ELASTIC_TASK, fields, 10, name, result);
+}
+
+acceptance_codes request_remove_task(id_t task_name)
+{
+  uint64_t fields[] = { task_name, 0 };
+  replay_request_started();
+  acceptance_codes result = remove_task(task_name);
+  return record_request(REPLAY_REMOVE_TASK, fields, 2, nullptr, result);
+}
+
+acceptance_codes request_update_task(id_t task_name, ticks_t period, ticks_t exec_bound, tick_t complete_not_after)
+{
+  uint64_t fields[] = { task_name, period, exec_bound, complete_not_after, 0 };
+  replay_request_started();
+  acceptance_codes result = update_task(task_name, period, exec_bound, complete_not_after);
+  return record_request(REPLAY_UPDATE_TASK, fields, 5, nullptr, result);
+}
+
+acceptance_codes request_set_firm_constraint(id_t task_name, unsigned m, unsigned k)
+{
+  uint64_t fields[] = { task_name, m, k, 0 };
+  replay_request_started();
+  acceptance_codes result = set_firm_constraint(task_name, m, k);
+  return record_request(REPLAY_SET_FIRM, fields, 4, nullptr, result);
+}
+
+tick_t jobs_done_by(const task_t* task, tick_t end)
+{
+  // the jobs which are kept are those already released, which may not have run yet
+  tick_t last_deadline = end;
+  for (unsigned i = first_pending_item(); i < _items_in_scheduled_item_list; i++)
+  {
+    const scheduled_item_t& item = _scheduled_item_list[i];
+    if (item.task == task && !item.done && tick_before(item.start_not_before, end) &&
+        tick_after(item.complete_not_after, last_deadline))
+      last_deadline = item.complete_not_after;
+  }
+  return last_deadline;
+}
+
+void stop_task_at(task_t* task, tick_t end)
+{
+  remove_pending_items(task, end, nullptr);
+
+  // no more jobs are converted
+  task->complete_not_after = end ? end : 1;
+  if (tick_before(task->time_evaluated_upto, task->complete_not_after))
+    task->time_evaluated_upto = task->complete_not_after;
+}
+
+bool retire_task_if_finished(task_t* task)
+{
+  if (!task_finished(task))
+    return false;
+  retire_task(task);
+  return true;
+}
+
+static
+tick_t end_task(task_t* task, tick_t end)
+{
+  tick_t last_deadline = jobs_done_by(task, end);
+  stop_task_at(task, end);
+  // it is retired after the last has run
+  retire_task_if_finished(task);
+  return last_deadline;
+}
+
+tick_t end_task_at(task_t* task, tick_t end)
+{
+  uint64_t fields[] = { task->task_name, end, 0 };
+  replay_request_started();
+  tick_t last_deadline = end_task(task, end);
+  fields[2] = last_deadline;
+  replay_record_request(REPLAY_END_TASK, fields, 3, nullptr);
+  return last_deadline;
 }
 
 void initialize_scheduler()
@@ -469,5 +1115,7 @@ void initialize_scheduler()
   _items_in_scheduled_item_list = 0;
   _item_upto = 0;
   _index_sorted_upto = 0;
+  _update_schedule_rate = UPDATE_SCHEDULE_RATE;
+  _event_horizon = 2 * UPDATE_SCHEDULE_RATE;
   // _scheduled_item_list[MAX_SCHEDULED_ITEMS - 1];
 }
@@ -0,0 +1,35 @@
+/*
+  Real-time Scheduler
+  Copyright (c) 2023, John Ryland
+  All rights reserved.
+*/
+
+#include "kernel/sensitivity.h"
+#include "kernel/task_manager.h"
+
+static
+edf_task_t _edf_tasks[MAX_TASKS];
+
+void analyse_task_sensitivity(sensitivity_analysis_t& analysis)
+{
+  unsigned count = 0;
+  for (unsigned i = 0; i < items_in_list; i++)
+  {
+    task_t* task = &task_list[i];
+    if (task->func_ptr == nullptr || task->period == 0)
+      continue;
+    _edf_tasks[count] = { uint32_t(task->exec_bound), uint32_t(task->period), uint32_t(task->period) };
+    analysis.tasks[count].task = task;
+    count++;
+  }
+
+  analysis.task_count = count;
+  analysis.schedulable = edf_schedulable(_edf_tasks, count);
+  analysis.critical_scaling_factor = edf_critical_scaling_factor(_edf_tasks, count);
+  for (unsigned i = 0; i < count; i++)
+  {
+    task_sensitivity_t& result = analysis.tasks[i];
+    result.allowable_exec_bound = edf_allowable_exec_bound(_edf_tasks, count, i);
+    result.slack = (result.allowable_exec_bound > _edf_tasks[i].exec_bound) ? result.allowable_exec_bound - _edf_tasks[i].exec_bound : 0;
+  }
+}
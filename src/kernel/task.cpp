@@ -4,21 +4,47 @@
   All rights reserved.
 */
 
+#include <config.h>
 #include "conio.h"
 #include "kernel/debug_logger.h"
+#include "kernel/profiler.h"
+#include "kernel/replay.h"
 #include "kernel/task_manager.h"
+#include "kernel/trace.h"
 #include "module/timer.h"
+#include "common/hash_map.hpp"
+
+#ifdef ENABLE_PERF_COUNTERS_LINUX
+#include "module/perf_counters.h"
+#endif
+
+// Power of 2 and at least twice MAX_TASKS to keep the probes short
+#define TASK_INDEX_CAPACITY   256
 
 // Because i'm lazy I thought it easiest to use a constant length array
 // for my schedule_list instead of using a linked list or other data struct
 static
 unsigned _items_in_list = 0;
 static
-task_t _task_list[MAX_TASKS - 1];
+task_t _task_list[MAX_TASKS];
+
+// Slots of removed tasks, which are reused before the list grows, so with
+// tasks coming and going the list only grows to the most tasks at once.
+// Scheduled items point at tasks, so tasks can't be moved to fill the gaps.
+static
+unsigned _free_task_slots[MAX_TASKS];
+static
+unsigned _free_task_count = 0;
+
+// task_name to task, so looking up a task doesn't search the list
+static
+HashMap<id_t, task_t*, TASK_INDEX_CAPACITY> _task_index;
 
 void initialize_tasks()
 {
   _items_in_list = 0;
+  _free_task_count = 0;
+  _task_index.clear();
 }
 
 unsigned get_items_in_list()
@@ -31,15 +57,28 @@ task_t* get_task_list()
   return _task_list;
 }
 
-bool add_task_to_schedule(void (*func_ptr)(), id_t task_name, id_t wait_for,
+task_t* add_task_to_schedule(void (*func_ptr)(), id_t task_name, id_t wait_for,
 			     tick_t start_not_before, ticks_t exec_bound,
 			     tick_t complete_not_after, ticks_t period,
 			     const char *name, unsigned x_pos, unsigned y_pos)
 {
-  if (items_in_list == MAX_TASKS)
-    return false;
+  // resolved now so the scheduler doesn't need to look it up when sorting
+  task_t* wait_for_task = nullptr;
+  if (wait_for != 0)
+  {
+    wait_for_task = search_for_task_in_schedule(wait_for);
+    if (wait_for_task == nullptr)
+      return nullptr;
+  }
+
+  task_t* new_item;
+  if (_free_task_count)
+    new_item = &_task_list[_free_task_slots[--_free_task_count]];
+  else if (_items_in_list < MAX_TASKS)
+    new_item = &_task_list[_items_in_list++];
+  else
+    return nullptr;
 
-  task_t* new_item = &task_list[items_in_list];
   new_item->func_ptr = func_ptr;
   new_item->task_name = task_name;
   new_item->wait_for = wait_for;
@@ -47,6 +86,12 @@ bool add_task_to_schedule(void (*func_ptr)(), id_t task_name, id_t wait_for,
   new_item->exec_bound = exec_bound;
   new_item->complete_not_after = complete_not_after;
   new_item->period = period;
+  new_item->wait_for_task = wait_for_task;
+  new_item->min_period = period;
+  new_item->max_period = period;
+  new_item->elasticity = 0;
+  new_item->firm_m = 0;
+  new_item->firm_k = 0;
 
   if (start_not_before == 0)
     new_item->time_evaluated_upto = current_tick();
@@ -63,24 +108,49 @@ bool add_task_to_schedule(void (*func_ptr)(), id_t task_name, id_t wait_for,
   new_item->average_exec_time = 0;
   new_item->times_called = 0;
   new_item->deadline_failures = 0;
+  new_item->pending_jobs = 0;
+  new_item->deadline_history = ~0U;
+  new_item->jobs_skipped = 0;
+  new_item->firm_violations = 0;
 
   new_item->name = name;
   new_item->x_pos = x_pos;
   new_item->y_pos = y_pos;
 
-  _items_in_list++;
-  return true;
+  // a task with the same name replaces the old one in the index
+  _task_index.insert(task_name, new_item);
+  return new_item;
+}
+
+void remove_task_from_schedule(task_t* task)
+{
+  task_t** indexed = _task_index.find(task->task_name);
+  if (indexed && *indexed == task)
+    _task_index.remove(task->task_name);
+
+  // tasks waiting for this one no longer have anything to wait for
+  for (unsigned i = 0; i < _items_in_list; i++)
+    if (_task_list[i].wait_for_task == task)
+      _task_list[i].wait_for_task = nullptr;
+
+  // cleared so that loops over the task list pass over it
+  task->func_ptr = nullptr;
+  task->task_name = 0;
+  task->wait_for = 0;
+  task->wait_for_task = nullptr;
+  task->period = 0;
+  task->start_not_before = 0;
+  task->complete_not_after = 0;
+  task->pending_jobs = 0;
+  _free_task_slots[_free_task_count++] = task - _task_list;
 }
 
 task_t *search_for_task_in_schedule(id_t task_name)
 {
-  for (unsigned i = 0; i < items_in_list; i++)
-    if (task_list[i].task_name == task_name)
-      return &task_list[i];
-  return nullptr;
+  task_t** task = _task_index.find(task_name);
+  return task ? *task : nullptr;
 }
 
-static
 void calculate_stats(task_t *item)
 {
   item->last_exec_time = item->last_exec_end - item->last_exec_start;
@@ -116,9 +186,21 @@ void display_item(task_t *item)
 
 void run_task(task_t *item)
 {
+#ifdef ENABLE_PERF_COUNTERS_LINUX
+  perf_sample_t counters;
+  read_perf_counters(counters);
+#endif
   item->last_exec_start = current_tick();
+  trace_event(TRACE_START, item, 0);
+  profiler_task_started();
   item->func_ptr();
+  profiler_task_finished();
+  replay_task_ran(item);
   item->last_exec_end = current_tick();
+  trace_event(TRACE_FINISH, item, uint32_t(item->last_exec_end - item->last_exec_start));
+#ifdef ENABLE_PERF_COUNTERS_LINUX
+  account_perf_counters(item, counters);
+#endif
   item->times_called++;
   calculate_stats(item);
   display_item(item);
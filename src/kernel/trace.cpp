@@ -0,0 +1,161 @@
+/*
+  Real-time Scheduler
+  Copyright (c) 2023, John Ryland
+  All rights reserved.
+*/
+
+#include <config.h>
+#include "kernel/trace.h"
+#include "kernel/task_manager.h"
+#include "module/timer.h"
+
+#if defined(ENABLE_TIMER_LINUX) || defined(ENABLE_TIMER_LINUX_TIMERFD)
+#  include "module/precise_sleep.h"
+#  define TRACE_MONOTONIC_CLOCK
+#elif defined(__i386__) || defined(__x86_64__)
+#  include "arch/x86/intrinsics.h"
+#  define TRACE_TSC_CLOCK
+#endif
+
+static volatile uint32_t _event_mask = 0;
+
+static
+trace_event_t _events[TRACE_MAX_CPUS][TRACE_EVENTS];
+
+// how many events each cpu has recorded, the next goes at this modulo TRACE_EVENTS
+static uint32_t _event_counts[TRACE_MAX_CPUS];
+
+// the tasks which have been in each slot since tracing started, as the
+// tasks may have gone by the time of the dump
+static const char* _task_names[MAX_TASKS];
+static id_t _task_ids[MAX_TASKS];
+
+#ifdef TRACE_TSC_CLOCK
+static uint64_t _start_tsc = 0;
+static tick_t _start_tick = 0;
+#endif
+
+
+// Local functions
+
+static
+uint64_t timestamp()
+{
+#if defined(TRACE_MONOTONIC_CLOCK)
+  return monotonic_ns();
+#elif defined(TRACE_TSC_CLOCK)
+  return rdtsc();
+#else
+  return current_tick();
+#endif
+}
+
+// The TSC's rate isn't known, so it is worked out from how far it has
+// counted over the ticks since tracing started
+static
+uint64_t timestamp_frequency()
+{
+#if defined(TRACE_MONOTONIC_CLOCK)
+  return 1000000000;
+#elif defined(TRACE_TSC_CLOCK)
+  ticks_t ticks = current_tick() - _start_tick;
+  return ticks ? (rdtsc() - _start_tsc) * timer_frequency() / ticks : 0;
+#else
+  return timer_frequency();
+#endif
+}
+
+static
+void dump_tasks(trace_writer_t write, void* context)
+{
+  for (unsigned slot = 0; slot < MAX_TASKS; slot++)
+  {
+    const char* name = _task_names[slot];
+    if (!name)
+      continue;
+    trace_task_record_t record = {};
+    record.slot = uint16_t(slot);
+    record.task_name = _task_ids[slot];
+    for (unsigned c = 0; c < TRACE_TASK_NAME_LENGTH - 1 && name[c]; c++)
+      record.name[c] = name[c];
+    write(&record, sizeof(record), context);
+  }
+}
+
+
+// Implementation
+
+void trace_enable(uint32_t event_mask)
+{
+  if (event_mask && !_event_mask)
+  {
+    for (unsigned cpu = 0; cpu < TRACE_MAX_CPUS; cpu++)
+      __atomic_store_n(&_event_counts[cpu], 0, __ATOMIC_RELEASE);
+    for (unsigned slot = 0; slot < MAX_TASKS; slot++)
+      _task_names[slot] = nullptr;
+#ifdef TRACE_TSC_CLOCK
+    _start_tick = current_tick();
+    _start_tsc = rdtsc();
+#endif
+  }
+  _event_mask = event_mask;
+}
+
+uint32_t trace_event_mask()
+{
+  return _event_mask;
+}
+
+void trace_event(trace_event_type_t type, const task_t* task, uint32_t arg)
+{
+  if (!(_event_mask & TRACE_EVENT_MASK(type)))
+    return;
+  const unsigned cpu = 0;
+  uint32_t index = __atomic_fetch_add(&_event_counts[cpu], 1, __ATOMIC_RELAXED);
+  trace_event_t& event = _events[cpu][index & (TRACE_EVENTS - 1)];
+  event.timestamp = timestamp();
+  event.type = type;
+  event.cpu = uint8_t(cpu);
+  event.task = TRACE_NO_TASK;
+  event.arg = arg;
+  size_t slot = task ? size_t(task - get_task_list()) : MAX_TASKS;
+  if (slot < MAX_TASKS)
+  {
+    event.task = uint16_t(slot);
+    _task_names[slot] = task->name ? task->name : "";
+    _task_ids[slot] = task->task_name;
+  }
+}
+
+uint32_t trace_dump(trace_writer_t write, void* context)
+{
+  trace_dump_header_t header = {};
+  header.magic = TRACE_DUMP_MAGIC;
+  header.version = TRACE_DUMP_VERSION;
+  header.timestamp_frequency = timestamp_frequency();
+  for (unsigned slot = 0; slot < MAX_TASKS; slot++)
+    if (_task_names[slot])
+      header.task_count++;
+  uint32_t counts[TRACE_MAX_CPUS];
+  uint32_t kept[TRACE_MAX_CPUS];
+  for (unsigned cpu = 0; cpu < TRACE_MAX_CPUS; cpu++)
+  {
+    counts[cpu] = __atomic_load_n(&_event_counts[cpu], __ATOMIC_ACQUIRE);
+    kept[cpu] = (counts[cpu] < TRACE_EVENTS) ? counts[cpu] : TRACE_EVENTS;
+    header.event_count += kept[cpu];
+    header.lost_events += counts[cpu] - kept[cpu];
+  }
+
+  write(&header, sizeof(header), context);
+  dump_tasks(write, context);
+  // the oldest event is where the next would go, once the ring has wrapped
+  for (unsigned cpu = 0; cpu < TRACE_MAX_CPUS; cpu++)
+  {
+    uint32_t oldest = (counts[cpu] - kept[cpu]) & (TRACE_EVENTS - 1);
+    uint32_t first_part = (oldest + kept[cpu] > TRACE_EVENTS) ? TRACE_EVENTS - oldest : kept[cpu];
+    write(&_events[cpu][oldest], first_part * sizeof(trace_event_t), context);
+    if (first_part < kept[cpu])
+      write(&_events[cpu][0], (kept[cpu] - first_part) * sizeof(trace_event_t), context);
+  }
+  return header.event_count;
+}
@@ -9,18 +9,43 @@
 #ifdef ENABLE_CPU_GENERIC
 
 #include "module/cpu.h"
+#include "module/timer.h"
 #include "module_manager.h"
 
+// The generic cpu module is used for hosted builds, which on an x86 host
+// can still use the time stamp counter and query the instruction set
+#if defined(__i386__) || defined(__x86_64__)
+#  include "arch/x86/cpu_features.h"
+#  define X86_HOST
+#endif
+
 static
 void initialize()
 {
 }
 
+static
+cpu_idle_policy_t idle_policy = CPU_IDLE_WAIT;
+
 static
 void halt()
 {
-  for(;;)
-    /* do nothing */;
+  if (idle_policy == CPU_IDLE_WAIT)
+    wait_for_timer_event();
+#ifdef X86_HOST
+  else
+    asm volatile ( "pause" : : : "memory" );
+#endif
+}
+
+// When hosted, hlt is privileged, so it would only trap
+static
+bool set_idle_policy(cpu_idle_policy_t policy)
+{
+  if (policy == CPU_IDLE_HALT)
+    return false;
+  idle_policy = policy;
+  return true;
 }
 
 static
@@ -67,8 +92,14 @@ void outport_dword(uint32_t /*port*/, uint32_t /*dword*/)
 }
 
 static
-uint64_t read_cpu_register(cpu_register_t /*reg*/)
+uint64_t read_cpu_register(cpu_register_t reg)
 {
+#ifdef X86_HOST
+  if (reg == cpu_register_t::TSC)
+    return rdtsc();
+#else
+  (void)reg;
+#endif
   return 0;
 }
 
@@ -77,11 +108,22 @@ void write_cpu_register(cpu_register_t /*reg*/, uint64_t /*value*/)
 {
 }
 
+static
+uint32_t features()
+{
+#ifdef X86_HOST
+  return x86_cpu_features();
+#else
+  return 0;
+#endif
+}
+
 static
 cpu_state_vtable_t cpu_state_vtable =
 {
   .initialize         = initialize,
   .halt               = halt,
+  .set_idle_policy    = set_idle_policy,
   .enable_interrupts  = enable_interrupts,
   .disable_interrupts = disable_interrupts,
   .inport_byte        = inport_byte,
@@ -92,6 +134,7 @@ cpu_state_vtable_t cpu_state_vtable =
   .outport_dword      = outport_dword,
   .read_cpu_register  = read_cpu_register,
   .write_cpu_register = write_cpu_register,
+  .features           = features,
 };
 
 static
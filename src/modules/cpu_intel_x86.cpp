@@ -10,17 +10,33 @@
 
 #include "module/cpu.h"
 #include "module_manager.h"
+#include "arch/x86/cpu_features.h"
 
 static
 void initialize()
 {
 }
 
+static
+cpu_idle_policy_t idle_policy = CPU_IDLE_HALT;
+
 static
 void halt()
 {
-  for(;;)
-    /* do nothing */;
+  if (idle_policy == CPU_IDLE_HALT)
+    asm volatile ( "hlt" );
+  else
+    asm volatile ( "pause" : : : "memory" );
+}
+
+// On bare metal the timer is an interrupt, so halting already waits for it
+static
+bool set_idle_policy(cpu_idle_policy_t policy)
+{
+  if (policy == CPU_IDLE_WAIT)
+    return false;
+  idle_policy = policy;
+  return true;
 }
 
 static
@@ -67,8 +83,10 @@ void outport_dword(uint32_t /*port*/, uint32_t /*dword*/)
 }
 
 static
-uint64_t read_cpu_register(cpu_register_t /*reg*/)
+uint64_t read_cpu_register(cpu_register_t reg)
 {
+  if (reg == cpu_register_t::TSC)
+    return rdtsc();
   return 0;
 }
 
@@ -77,11 +95,23 @@ void write_cpu_register(cpu_register_t /*reg*/, uint64_t /*value*/)
 {
 }
 
+static
+uint32_t features()
+{
+  uint32_t supported = x86_cpu_features();
+#ifdef __i386__
+  // The kernel doesn't enable or save the SSE state (CR4.OSFXSR) on 32-bit
+  supported &= ~(CPU_FEATURE_SSE2 | CPU_FEATURE_AVX2);
+#endif
+  return supported;
+}
+
 static
 cpu_state_vtable_t cpu_state_vtable =
 {
   .initialize         = initialize,
   .halt               = halt,
+  .set_idle_policy    = set_idle_policy,
   .enable_interrupts  = enable_interrupts,
   .disable_interrupts = disable_interrupts,
   .inport_byte        = inport_byte,
@@ -92,6 +122,7 @@ cpu_state_vtable_t cpu_state_vtable =
   .outport_dword      = outport_dword,
   .read_cpu_register  = read_cpu_register,
   .write_cpu_register = write_cpu_register,
+  .features           = features,
 };
 
 static
@@ -12,26 +12,42 @@
 #include "module_manager.h"
 
 #include <cstdio>
+#include <cstdlib>
 #include <sys/ioctl.h>
 #include <sys/termios.h>
 #include <termios.h>
 
 static
-void enable_raw_mode()
+bool raw_mode = false;
+
+static
+void disable_raw_mode()
 {
   termios term;
   tcgetattr(0, &term);
-  term.c_lflag &= static_cast<unsigned>(~(ICANON | ECHO)); // Disable echo as well
+  term.c_lflag |= ICANON | ECHO;
   tcsetattr(0, TCSANOW, &term);
+  raw_mode = false;
 }
 
+// Raw mode is entered once and left again at exit, so polling the keyboard
+// is a single ioctl instead of switching the terminal's mode back and forth
 static
-void disable_raw_mode()
+void enable_raw_mode()
 {
+  static bool restore_at_exit = false;
+  if (raw_mode)
+    return;
   termios term;
   tcgetattr(0, &term);
-  term.c_lflag |= ICANON | ECHO;
+  term.c_lflag &= static_cast<unsigned>(~(ICANON | ECHO)); // Disable echo as well
   tcsetattr(0, TCSANOW, &term);
+  raw_mode = true;
+  if (!restore_at_exit)
+  {
+    restore_at_exit = true;
+    atexit(disable_raw_mode);
+  }
 }
 
 static
@@ -40,7 +56,6 @@ bool kbhit()
   enable_raw_mode();
   int byteswaiting;
   ioctl(0, FIONREAD, &byteswaiting);
-  disable_raw_mode();
   return byteswaiting > 0;
 }
 
@@ -48,9 +63,7 @@ static
 int getch()
 {
   enable_raw_mode();
-  int ch = getchar();
-  disable_raw_mode();
-  return ch;
+  return getchar();
 }
 
 static
@@ -0,0 +1,212 @@
+/*
+  Real-time Scheduler
+  Copyright (c) 2023, John Ryland
+  All rights reserved.
+*/
+
+#include <config.h>
+
+#ifdef ENABLE_PERF_COUNTERS_LINUX
+
+#include "module/perf_counters.h"
+#include "kernel/debug_logger.h"
+#include "kernel/task_manager.h"
+
+#if defined(__i386__) || defined(__x86_64__)
+#  include "arch/x86/intrinsics.h"
+#  define X86_HOST
+#endif
+
+// the POSIX timer_t would conflict with the kernel's
+#define timer_t posix_timer_t
+#include <cerrno>
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#undef timer_t
+
+
+struct perf_counter_desc_t
+{
+  const char*  name;
+  uint32_t     type;
+  uint64_t     config;
+};
+
+// The context switches aren't counted with perf, as a software event only
+// sees them with exclude_kernel clear, which perf_event_paranoid 2 doesn't
+// allow, instead they come from getrusage() which is always allowed.
+#define PERF_EVENT_COUNT    PERF_CONTEXT_SWITCHES
+
+static const perf_counter_desc_t counter_descs[PERF_EVENT_COUNT] =
+{
+  { "cycles",           PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+  { "instructions",     PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+  { "LLC misses",       PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+};
+
+static int counter_fds[PERF_EVENT_COUNT] = { -1, -1, -1 };
+// the user pages of the counters which can be read with rdpmc
+static volatile perf_event_mmap_page* counter_pages[PERF_EVENT_COUNT];
+static bool profiling = false;
+
+// indexed by the tasks' slots in the task list
+static task_perf_profile_t task_profiles[MAX_TASKS];
+
+
+// Local functions
+
+static
+int open_counter(const perf_counter_desc_t& desc)
+{
+  perf_event_attr attr = {};
+  attr.size = sizeof(attr);
+  attr.type = desc.type;
+  attr.config = desc.config;
+  attr.exclude_kernel = 1;    // allowed at the default perf_event_paranoid of 2
+  attr.exclude_hv = 1;
+  // this thread only, on any cpu
+  return int(syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC));
+}
+
+static
+volatile perf_event_mmap_page* map_user_page(int fd)
+{
+#ifdef X86_HOST
+  void* page = mmap(nullptr, size_t(sysconf(_SC_PAGESIZE)), PROT_READ, MAP_SHARED, fd, 0);
+  if (page == MAP_FAILED)
+    return nullptr;
+  volatile perf_event_mmap_page* user_page = (volatile perf_event_mmap_page*)page;
+  if (user_page->cap_user_rdpmc)
+    return user_page;
+  munmap(page, size_t(sysconf(_SC_PAGESIZE)));
+#else
+  (void)fd;
+#endif
+  return nullptr;
+}
+
+static
+uint64_t read_counter_syscall(int fd)
+{
+  uint64_t value = 0;
+  if (read(fd, &value, sizeof(value)) != sizeof(value))
+    return 0;
+  return value;
+}
+
+#ifdef X86_HOST
+// The kernel's sequence for reading a counter from user space, retried if
+// the thread was switched out part way. The hardware counter is only as
+// wide as pmc_width, so it is sign extended before adding the offset.
+static
+uint64_t read_counter_rdpmc(volatile perf_event_mmap_page* page, int fd)
+{
+  uint32_t seq;
+  uint64_t count;
+  do
+  {
+    seq = page->lock;
+    asm volatile ( "" : : : "memory" );
+    uint32_t index = page->index;
+    // not on the PMU at the moment, such as when the counters are multiplexed
+    if (!page->cap_user_rdpmc || index == 0)
+      return read_counter_syscall(fd);
+    int64_t pmc = int64_t(rdpmc(index - 1));
+    unsigned shift = 64 - page->pmc_width;
+    count = page->offset + uint64_t((pmc << shift) >> shift);
+    asm volatile ( "" : : : "memory" );
+  } while (page->lock != seq);
+  return count;
+}
+#endif
+
+static
+uint64_t context_switches()
+{
+  struct rusage usage;
+  getrusage(RUSAGE_THREAD, &usage);
+  return uint64_t(usage.ru_nvcsw) + uint64_t(usage.ru_nivcsw);
+}
+
+static
+task_perf_profile_t* profile_of(const task_t* task)
+{
+  size_t slot = size_t(task - get_task_list());
+  return (slot < MAX_TASKS) ? &task_profiles[slot] : nullptr;
+}
+
+
+// Implementation
+
+bool initialize_perf_counters()
+{
+  bool any_counters = false;
+  for (unsigned i = 0; i < PERF_EVENT_COUNT; i++)
+  {
+    if (counter_fds[i] != -1)
+      continue;
+    counter_fds[i] = open_counter(counter_descs[i]);
+    if (counter_fds[i] == -1)
+    {
+      k_log_fmt(WARNING, "[ ] No perf counter for %s: %s.\n", counter_descs[i].name, strerror(errno));
+      continue;
+    }
+    any_counters = true;
+    counter_pages[i] = map_user_page(counter_fds[i]);
+    k_log_fmt(SUCCESS, "[X] Opened perf counter for %s%s.\n", counter_descs[i].name,
+              counter_pages[i] ? ", read with rdpmc" : "");
+  }
+  profiling = true;
+  return any_counters;
+}
+
+bool perf_counter_available(perf_counter_t counter)
+{
+  return (counter == PERF_CONTEXT_SWITCHES) || counter_fds[counter] != -1;
+}
+
+void read_perf_counters(perf_sample_t& sample)
+{
+  sample.values[PERF_CONTEXT_SWITCHES] = profiling ? context_switches() : 0;
+  for (unsigned i = 0; i < PERF_EVENT_COUNT; i++)
+  {
+    sample.values[i] = 0;
+    if (counter_fds[i] == -1)
+      continue;
+#ifdef X86_HOST
+    if (counter_pages[i])
+    {
+      sample.values[i] = read_counter_rdpmc(counter_pages[i], counter_fds[i]);
+      continue;
+    }
+#endif
+    sample.values[i] = read_counter_syscall(counter_fds[i]);
+  }
+}
+
+void account_perf_counters(const task_t* task, const perf_sample_t& before)
+{
+  task_perf_profile_t* profile = profile_of(task);
+  if (!profiling || !profile)
+    return;
+  // a task in a reused slot starts a new profile
+  if (task->times_called == 0)
+    *profile = {};
+  perf_sample_t after;
+  read_perf_counters(after);
+  profile->runs++;
+  for (unsigned i = 0; i < PERF_COUNTER_COUNT; i++)
+    profile->totals[i] += after.values[i] - before.values[i];
+}
+
+const task_perf_profile_t* task_perf_profile(const task_t* task)
+{
+  const task_perf_profile_t* profile = profile_of(task);
+  return (profile && profile->runs) ? profile : nullptr;
+}
+
+#endif // ENABLE_PERF_COUNTERS_LINUX
@@ -0,0 +1,106 @@
+/*
+  Real-time Scheduler
+  Copyright (c) 2023, John Ryland
+  All rights reserved.
+*/
+
+#include <config.h>
+
+#if defined(ENABLE_TIMER_LINUX) || defined(ENABLE_TIMER_LINUX_TIMERFD)
+
+#include "module/precise_sleep.h"
+
+// the POSIX timer_t would conflict with the kernel's
+#define timer_t posix_timer_t
+#include <cerrno>
+#include <ctime>
+#include <atomic>
+#undef timer_t
+
+
+#define SPIN_MARGIN_MIN_NS        2000       // always spin at least this long
+#define SPIN_MARGIN_MAX_NS        250000     // never spin more than 250us of a wait
+#define CALIBRATION_SLEEPS        16
+#define CALIBRATION_SLEEP_NS      100000
+
+
+// The wakeup latency is tracked like a TCP round trip time, as a moving
+// average and mean deviation, with the margin being the average plus 4
+// deviations. So it follows the usual latency closely but backs off
+// quickly when the host gets busy. These are only estimates so sleeps
+// on different threads racing to update them doesn't matter.
+static std::atomic<int64_t> latency_average_ns(50000);
+static std::atomic<int64_t> latency_deviation_ns(10000);
+static std::atomic<int64_t> spin_margin_ns(90000);
+
+
+static
+void record_latency(int64_t latency)
+{
+  int64_t average = latency_average_ns.load(std::memory_order_relaxed);
+  int64_t deviation = latency_deviation_ns.load(std::memory_order_relaxed);
+  int64_t error = latency - average;
+  average += error / 8;
+  deviation += ((error < 0 ? -error : error) - deviation) / 4;
+  int64_t margin = average + 4 * deviation;
+  margin = (margin < SPIN_MARGIN_MIN_NS) ? SPIN_MARGIN_MIN_NS : ((margin > SPIN_MARGIN_MAX_NS) ? SPIN_MARGIN_MAX_NS : margin);
+  latency_average_ns.store(average, std::memory_order_relaxed);
+  latency_deviation_ns.store(deviation, std::memory_order_relaxed);
+  spin_margin_ns.store(margin, std::memory_order_relaxed);
+}
+
+static inline
+void spin_pause()
+{
+#if defined(__i386__) || defined(__x86_64__)
+  asm volatile ("pause" : : : "memory");
+#endif
+}
+
+uint64_t monotonic_ns()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return uint64_t(ts.tv_sec) * 1000000000 + uint64_t(ts.tv_nsec);
+}
+
+// Returns how late it woke up
+static
+int64_t sleep_until_absolute(uint64_t wake_at)
+{
+  struct timespec ts;
+  ts.tv_sec = time_t(wake_at / 1000000000);
+  ts.tv_nsec = long(wake_at % 1000000000);
+  // signals, such as the timer_linux ticks, interrupt the sleep, but as the
+  // time is absolute it can just be continued
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+    ;
+  return int64_t(monotonic_ns() - wake_at);
+}
+
+void sleep_until_ns(uint64_t deadline_ns)
+{
+  uint64_t margin = uint64_t(spin_margin_ns.load(std::memory_order_relaxed));
+  if (monotonic_ns() + margin < deadline_ns)
+    record_latency(sleep_until_absolute(deadline_ns - margin));
+  while (monotonic_ns() < deadline_ns)
+    spin_pause();
+}
+
+void sleep_ns(uint64_t duration_ns)
+{
+  sleep_until_ns(monotonic_ns() + duration_ns);
+}
+
+void calibrate_precise_sleep()
+{
+  for (int i = 0; i < CALIBRATION_SLEEPS; ++i)
+    record_latency(sleep_until_absolute(monotonic_ns() + CALIBRATION_SLEEP_NS));
+}
+
+uint64_t precise_sleep_spin_margin_ns()
+{
+  return uint64_t(spin_margin_ns.load(std::memory_order_relaxed));
+}
+
+#endif // ENABLE_TIMER_LINUX || ENABLE_TIMER_LINUX_TIMERFD
@@ -0,0 +1,130 @@
+/*
+  Real-time Scheduler
+  Copyright (c) 2023, John Ryland
+  All rights reserved.
+*/
+
+#include <config.h>
+
+#ifdef ENABLE_PROFILER_LINUX
+
+#include "module/profiler_linux.h"
+#include "kernel/debug_logger.h"
+#include "kernel/profiler.h"
+
+// the POSIX timer_t would conflict with the kernel's
+#define timer_t posix_timer_t
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <link.h>
+#include <ucontext.h>
+#include <unistd.h>
+#undef timer_t
+
+
+#define SYMBOL_MAP_MAGIC      0xDDCC
+
+
+// Local functions
+
+// The first object is the executable, whose address is where a PIE was
+// loaded, which nm's addresses are relative to, or 0 for one which isn't.
+static
+int first_object_address(struct dl_phdr_info* info, size_t, void* data)
+{
+  *(size_t*)data = size_t(info->dlpi_addr);
+  return 1;
+}
+
+static
+bool symbol_map_path(char* path, size_t size)
+{
+  const char* setting = getenv("RTS_SYMBOL_MAP");
+  if (setting && *setting)
+  {
+    snprintf(path, size, "%s", setting);
+    return true;
+  }
+  ssize_t length = readlink("/proc/self/exe", path, size - 5);
+  if (length <= 0)
+    return false;
+  strcpy(path + length, ".sym");
+  return true;
+}
+
+// Reads the whole file with a nul after it, so the last name, which runs
+// to the end of the file, is terminated.
+static
+uint8_t* read_file(const char* path, size_t& size)
+{
+  FILE* file = fopen(path, "rb");
+  if (!file)
+    return nullptr;
+  uint8_t* data = nullptr;
+  if (fseek(file, 0, SEEK_END) == 0)
+  {
+    long length = ftell(file);
+    rewind(file);
+    data = (length > 0) ? (uint8_t*)malloc(size_t(length) + 1) : nullptr;
+    if (data && fread(data, 1, size_t(length), file) == size_t(length))
+    {
+      data[length] = 0;
+      size = size_t(length);
+    }
+    else
+    {
+      free(data);
+      data = nullptr;
+    }
+  }
+  fclose(file);
+  return data;
+}
+
+
+// Implementation
+
+size_t signal_interrupted_pc(const void* ucontext)
+{
+  const ucontext_t* context = (const ucontext_t*)ucontext;
+#if defined(__x86_64__)
+  return size_t(context->uc_mcontext.gregs[REG_RIP]);
+#elif defined(__i386__)
+  return size_t(context->uc_mcontext.gregs[REG_EIP]);
+#elif defined(__aarch64__)
+  return size_t(context->uc_mcontext.pc);
+#else
+  (void)context;
+  return 0;
+#endif
+}
+
+bool load_profiler_symbol_map()
+{
+  char path[512];
+  if (!symbol_map_path(path, sizeof(path)))
+    return false;
+  size_t size = 0;
+  uint8_t* data = read_file(path, size);
+  if (!data)
+  {
+    k_log_fmt(WARNING, "[ ] No symbol map for the profiler at %s.\n", path);
+    return false;
+  }
+  const symbol_table* map = (const symbol_table*)data;
+  if (size < sizeof(symbol_table) || map->magic != SYMBOL_MAP_MAGIC ||
+      size < sizeof(symbol_table) + map->count * sizeof(symbol_entry))
+  {
+    k_log_fmt(WARNING, "[ ] %s isn't a symbol map.\n", path);
+    free(data);
+    return false;
+  }
+  size_t load_address = 0;
+  dl_iterate_phdr(first_object_address, &load_address);
+  profiler_set_symbol_map(map, load_address);
+  k_log_fmt(SUCCESS, "[X] Loaded %i symbols for the profiler.\n", map->count);
+  return true;
+}
+
+#endif // ENABLE_PROFILER_LINUX
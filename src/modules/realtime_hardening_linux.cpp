@@ -0,0 +1,250 @@
+/*
+  Real-time Scheduler
+  Copyright (c) 2023, John Ryland
+  All rights reserved.
+*/
+
+#include <config.h>
+
+#ifdef ENABLE_REALTIME_HARDENING_LINUX
+
+#include "module/realtime_hardening.h"
+#include "kernel/debug_logger.h"
+#include "kernel/schedule.h"
+
+// the POSIX timer_t would conflict with the kernel's
+#define timer_t posix_timer_t
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <alloca.h>
+#include <malloc.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#undef timer_t
+
+
+#define DEFAULT_STACK_PREFAULT_KB   256
+#define DEFAULT_HEAP_PREFAULT_KB    4096
+#define HUGE_PAGE_SIZE              (2 * 1024 * 1024)
+
+// glibc's defaults, which are put back by soften_realtime()
+#define DEFAULT_TRIM_THRESHOLD      (128 * 1024)
+#define DEFAULT_MMAP_THRESHOLD      (128 * 1024)
+#define DEFAULT_MMAP_MAX            65536
+
+
+static bool pinned = false;
+static cpu_set_t unpinned_cpus;
+
+
+// Local functions
+
+static
+int32_t environment_setting(const char* name, int32_t default_value)
+{
+  const char* value = getenv(name);
+  return (value && *value) ? int32_t(strtol(value, nullptr, 10)) : default_value;
+}
+
+// reads the first line of a file, returning false if it can't be read
+static
+bool read_line(const char* path, char* line, size_t size)
+{
+  FILE* file = fopen(path, "r");
+  if (!file)
+    return false;
+  bool read = fgets(line, int(size), file) != nullptr;
+  fclose(file);
+  if (read)
+    line[strcspn(line, "\n")] = 0;
+  return read;
+}
+
+// true if the cpu is in a list such as "1,3-5", as used by sysfs
+static
+bool in_cpu_list(const char* list, int32_t cpu)
+{
+  while (*list)
+  {
+    char* end;
+    long first = strtol(list, &end, 10);
+    if (end == list)
+      return false;
+    long last = (*end == '-') ? strtol(end + 1, &end, 10) : first;
+    if (cpu >= first && cpu <= last)
+      return true;
+    list = (*end == ',') ? end + 1 : end;
+  }
+  return false;
+}
+
+static
+void pin_to_cpu(int32_t cpu)
+{
+  if (cpu < 0)
+  {
+    k_log_fmt(NORMAL, "[ ] Not pinned to a CPU, set RTS_CPU to pin it.\n");
+    return;
+  }
+
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  CPU_SET(cpu, &cpus);
+  if (!pinned)
+    sched_getaffinity(0, sizeof(unpinned_cpus), &unpinned_cpus);
+  if (sched_setaffinity(0, sizeof(cpus), &cpus) != 0)
+  {
+    k_log_fmt(WARNING, "[ ] Couldn't pin to CPU %i: %s.\n", cpu, strerror(errno));
+    return;
+  }
+  pinned = true;
+
+  // Pinning only keeps it from migrating, other work can still run on the
+  // CPU unless the kernel is booted keeping it for pinned threads only
+  char isolated[256] = "";
+  char nohz_full[256] = "";
+  read_line("/sys/devices/system/cpu/isolated", isolated, sizeof(isolated));
+  read_line("/sys/devices/system/cpu/nohz_full", nohz_full, sizeof(nohz_full));
+  if (in_cpu_list(isolated, cpu))
+    k_log_fmt(SUCCESS, "[X] Pinned to CPU %i, which is isolated%s.\n", cpu,
+              in_cpu_list(nohz_full, cpu) ? " and tickless" : "");
+  else
+    k_log_fmt(WARNING, "[X] Pinned to CPU %i, which isn't isolated, boot with isolcpus=%i nohz_full=%i to isolate it.\n",
+              cpu, cpu, cpu);
+}
+
+// true if the memory at the address is in a mapping with huge pages
+static
+bool backed_by_huge_pages(void* address)
+{
+  FILE* smaps = fopen("/proc/self/smaps", "r");
+  if (!smaps)
+    return false;
+  char line[256];
+  bool in_mapping = false;
+  bool huge = false;
+  while (fgets(line, sizeof(line), smaps))
+  {
+    unsigned long start, end;
+    if (sscanf(line, "%lx-%lx ", &start, &end) == 2)
+      in_mapping = (size_t)address >= start && (size_t)address < end;
+    else if (in_mapping && !strncmp(line, "AnonHugePages:", 14))
+      huge = strtol(line + 14, nullptr, 10) > 0;
+  }
+  fclose(smaps);
+  return huge;
+}
+
+// Transparent huge pages are used for the tables if they are advised to be
+// before they are first touched. They are aligned to a huge page for this.
+static
+void back_schedule_tables_with_huge_pages()
+{
+  void* tables;
+  size_t size;
+  get_schedule_tables(tables, size);
+  if (madvise(tables, size, MADV_HUGEPAGE) != 0)
+  {
+    k_log_fmt(WARNING, "[ ] Couldn't advise huge pages for the schedule tables: %s.\n", strerror(errno));
+    return;
+  }
+  for (size_t offset = 0; offset < size; offset += HUGE_PAGE_SIZE)
+    ((volatile uint8_t*)tables)[offset] = 0;
+
+  char mode[128] = "unknown";
+  read_line("/sys/kernel/mm/transparent_hugepage/enabled", mode, sizeof(mode));
+  if (backed_by_huge_pages(tables))
+    k_log_fmt(SUCCESS, "[X] Backed the schedule tables with huge pages.\n");
+  else
+    k_log_fmt(WARNING, "[ ] The schedule tables didn't get huge pages, transparent huge pages are %s.\n", mode);
+}
+
+static
+void lock_memory()
+{
+  if (mlockall(MCL_CURRENT | MCL_FUTURE) == 0)
+    k_log_fmt(SUCCESS, "[X] Locked memory.\n");
+  else
+    k_log_fmt(WARNING, "[ ] Couldn't lock memory: %s, it needs CAP_IPC_LOCK or a larger RLIMIT_MEMLOCK.\n", strerror(errno));
+}
+
+// Touches the stack below this frame, so it has been faulted in before the
+// tasks need it. It isn't inlined so the space is freed again on return.
+[[ gnu::noinline ]]
+static
+void prefault_stack(uint32_t kb)
+{
+  size_t size = size_t(kb) * 1024;
+  volatile uint8_t* stack = (volatile uint8_t*)alloca(size);
+  for (size_t offset = 0; offset < size; offset += 4096)
+    stack[offset] = 0;
+  k_log_fmt(SUCCESS, "[X] Prefaulted %iKB of stack.\n", kb);
+}
+
+// Faults in a block of the heap and keeps malloc from giving it back or
+// using mmap for large blocks, so allocations come from the faulted pages.
+static
+void prefault_heap(uint32_t kb)
+{
+  mallopt(M_TRIM_THRESHOLD, -1);
+  mallopt(M_MMAP_MAX, 0);
+  size_t size = size_t(kb) * 1024;
+  volatile uint8_t* heap = (volatile uint8_t*)malloc(size);
+  if (!heap)
+  {
+    k_log_fmt(WARNING, "[ ] Couldn't prefault %iKB of heap.\n", kb);
+    return;
+  }
+  for (size_t offset = 0; offset < size; offset += 4096)
+    heap[offset] = 0;
+  free((void*)heap);
+  k_log_fmt(SUCCESS, "[X] Prefaulted %iKB of heap.\n", kb);
+}
+
+
+// Implementation
+
+realtime_hardening_t realtime_hardening_settings()
+{
+  realtime_hardening_t settings;
+  settings.cpu = environment_setting("RTS_CPU", -1);
+  settings.lock_memory = environment_setting("RTS_LOCK_MEMORY", 1) != 0;
+  settings.huge_pages = environment_setting("RTS_HUGE_PAGES", 0) != 0;
+  settings.stack_prefault_kb = uint32_t(environment_setting("RTS_STACK_PREFAULT_KB", DEFAULT_STACK_PREFAULT_KB));
+  settings.heap_prefault_kb = uint32_t(environment_setting("RTS_HEAP_PREFAULT_KB", DEFAULT_HEAP_PREFAULT_KB));
+  return settings;
+}
+
+// This is done before the timer is started so its thread, and any other
+// threads started after, inherit the affinity. The huge pages are advised
+// before locking, as locking faults everything in.
+void harden_realtime(const realtime_hardening_t& settings)
+{
+  pin_to_cpu(settings.cpu);
+  if (settings.huge_pages)
+    back_schedule_tables_with_huge_pages();
+  if (settings.lock_memory)
+    lock_memory();
+  if (settings.stack_prefault_kb)
+    prefault_stack(settings.stack_prefault_kb);
+  if (settings.heap_prefault_kb)
+    prefault_heap(settings.heap_prefault_kb);
+}
+
+// The schedule tables keep any huge pages they were given
+void soften_realtime()
+{
+  if (pinned)
+    sched_setaffinity(0, sizeof(unpinned_cpus), &unpinned_cpus);
+  pinned = false;
+  munlockall();
+  mallopt(M_TRIM_THRESHOLD, DEFAULT_TRIM_THRESHOLD);
+  mallopt(M_MMAP_THRESHOLD, DEFAULT_MMAP_THRESHOLD);
+  mallopt(M_MMAP_MAX, DEFAULT_MMAP_MAX);
+  malloc_trim(0);
+}
+
+#endif // ENABLE_REALTIME_HARDENING_LINUX
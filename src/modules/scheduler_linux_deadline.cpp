@@ -0,0 +1,371 @@
+/*
+  Real-time Scheduler
+  Copyright (c) 2023, John Ryland
+  All rights reserved.
+*/
+
+#include <config.h>
+
+#ifdef ENABLE_SCHEDULER_LINUX_DEADLINE
+
+// Runs each periodic task on a thread of its own which the Linux kernel
+// schedules with SCHED_DEADLINE, so the kernel enforces the exec_bound as
+// the thread's runtime budget each period, and a task which overruns is
+// throttled instead of delaying the others. The deadline is the period.
+//
+// This is only for measuring how a task fares when the Linux kernel
+// schedules it, as benchmark_deadline_scheduler() does, and it isn't one
+// of the ways request_to_add_task() can schedule a task. The tasks which
+// are admitted all run on the one thread with the built-in dispatcher,
+// and share the kernel's state without locking, which the tasks here,
+// each on a thread of its own, can't do. So its tasks are only those
+// added to it directly, which aren't in the task list, and it is only
+// built, and registered, in the profile build with the benchmarks.
+//
+// A task is only admitted if it passes both the EDF test over the tasks
+// already on its threads, which doesn't include the dispatcher's tasks,
+// and the kernel's own admission control, which rejects it with EBUSY if
+// there isn't the CPU bandwidth for it.
+//
+// SCHED_DEADLINE needs CAP_SYS_NICE, so without it the threads fall back
+// to SCHED_FIFO, with priorities by period as in rate monotonic, and if
+// that isn't allowed either, to normal threads. Neither of those enforce
+// the budgets and the normal threads are only best effort.
+//
+// The tasks' statistics are worked out as run_task() does, in ticks, in
+// a copy of the task_t which only its thread writes to, and are copied
+// to the task_t once the thread has stopped, so the task_t is only ever
+// written by the thread which added it. The release latency of each
+// thread, how long after the release the task was started, is logged
+// when the task is removed.
+// The releases are timed with precise_sleep's monotonic_ns(), so this needs
+// one of the Linux timers too.
+
+#include "module/scheduler.h"
+#include "module/timer.h"
+#include "module/precise_sleep.h"
+#include "module_manager.h"
+#include "debug_logger.h"
+#include "kernel/edf_analysis.h"
+#include "kernel/task_manager.h"
+
+// the POSIX timer_t would conflict with the kernel's
+#define timer_t posix_timer_t
+#include <cerrno>
+#include <ctime>
+#include <atomic>
+
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#undef timer_t
+
+#ifndef SCHED_DEADLINE
+#define SCHED_DEADLINE            6
+#endif
+
+#define MAX_DEADLINE_TASKS        16
+#define MIN_DEADLINE_RUNTIME_NS   1024       // the kernel's smallest budget
+
+
+enum deadline_mode_t : uint8_t
+{
+  MODE_DEADLINE,
+  MODE_FIFO,
+  MODE_NORMAL,
+  MODE_REJECTED
+};
+
+static const char* mode_names[] = { "SCHED_DEADLINE", "SCHED_FIFO", "normal", "rejected" };
+
+// glibc doesn't declare sched_setattr, so this is the kernel's struct
+struct deadline_attr_t
+{
+  uint32_t  size;
+  uint32_t  sched_policy;
+  uint64_t  sched_flags;
+  int32_t   sched_nice;
+  uint32_t  sched_priority;
+  uint64_t  sched_runtime;
+  uint64_t  sched_deadline;
+  uint64_t  sched_period;
+};
+
+struct deadline_thread_t
+{
+  task_t*           task;
+  task_t            run;          // the thread's copy of the task, for its statistics
+  pthread_t         thread;
+  sem_t             started;      // posted once the thread knows its mode
+  sem_t             wake;         // posted to stop the thread early
+  std::atomic_bool  stopping;
+  deadline_mode_t   mode;
+  uint64_t          first_release_ns;
+  uint64_t          runtime_ns;
+  uint64_t          period_ns;
+  uint32_t          ticks_per_second;
+
+  // release latency and the copy's statistics, written by the thread and
+  // read once it has stopped
+  uint64_t          releases;
+  uint64_t          total_latency_ns;
+  uint64_t          max_latency_ns;
+};
+
+static deadline_thread_t deadline_threads[MAX_DEADLINE_TASKS];
+static bool thread_used[MAX_DEADLINE_TASKS];
+static edf_task_t edf_tasks[MAX_DEADLINE_TASKS];
+
+// the fallbacks are only warned about once
+static deadline_mode_t warned_mode = MODE_DEADLINE;
+
+
+// Local functions
+
+static
+int set_deadline_attr(uint64_t runtime_ns, uint64_t period_ns)
+{
+  deadline_attr_t attr = {};
+  attr.size = sizeof(attr);
+  attr.sched_policy = SCHED_DEADLINE;
+  attr.sched_runtime = runtime_ns;
+  attr.sched_deadline = period_ns;
+  attr.sched_period = period_ns;
+  return (syscall(SYS_sched_setattr, 0, &attr, 0) == 0) ? 0 : errno;
+}
+
+// Shorter periods get higher priorities, a level for each doubling of the
+// period from 1us, below the timer thread's priority so it can still tick.
+static
+int fifo_priority(uint64_t period_ns)
+{
+  int priority = sched_get_priority_max(SCHED_FIFO) - 1;
+  for (uint64_t us = period_ns / 1000; us > 1; us /= 2)
+    priority--;
+  int lowest = sched_get_priority_min(SCHED_FIFO);
+  return (priority < lowest) ? lowest : priority;
+}
+
+static
+deadline_mode_t set_thread_mode(deadline_thread_t* dt)
+{
+  int error = set_deadline_attr(dt->runtime_ns, dt->period_ns);
+  if (error == 0)
+    return MODE_DEADLINE;
+  // the kernel's admission test failed
+  if (error == EBUSY)
+    return MODE_REJECTED;
+
+  // not permitted, or SCHED_DEADLINE isn't supported
+  struct sched_param param = {};
+  param.sched_priority = fifo_priority(dt->period_ns);
+  if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0)
+    return MODE_FIFO;
+  return MODE_NORMAL;
+}
+
+// sleeps until the absolute monotonic time, returning false if woken to stop
+static
+bool wait_for_release(deadline_thread_t* dt, uint64_t release_ns)
+{
+  struct timespec ts;
+  ts.tv_sec = time_t(release_ns / NS_PER_SECOND);
+  ts.tv_nsec = long(release_ns % NS_PER_SECOND);
+  while (!dt->stopping)
+  {
+    if (sem_clockwait(&dt->wake, CLOCK_MONOTONIC, &ts) == -1 && errno == ETIMEDOUT)
+      return !dt->stopping;
+  }
+  return false;
+}
+
+static
+void* deadline_thread_main(void* arg)
+{
+  deadline_thread_t* dt = (deadline_thread_t*)arg;
+  task_t* task = &dt->run;
+  dt->mode = set_thread_mode(dt);
+  sem_post(&dt->started);
+  if (dt->mode == MODE_REJECTED)
+    return nullptr;
+
+  // Sleeping right up to the release rather than spinning the end of it as
+  // sleep_until_ns() does, as spinning would use up the runtime budget
+  for (uint64_t release = dt->first_release_ns; wait_for_release(dt, release); release += dt->period_ns)
+  {
+    uint64_t latency = monotonic_ns() - release;
+    dt->releases++;
+    dt->total_latency_ns += latency;
+    if (latency > dt->max_latency_ns)
+      dt->max_latency_ns = latency;
+
+    task->last_exec_start = current_tick();
+    task->func_ptr();
+    task->last_exec_end = current_tick();
+    task->times_called++;
+    calculate_stats(task);
+    if (monotonic_ns() > release + dt->period_ns)
+      task->deadline_failures++;
+  }
+  return nullptr;
+}
+
+// gives the task the statistics of its runs on the thread, which has stopped
+static
+void copy_stats(task_t* task, const task_t& run)
+{
+  task->last_exec_start = run.last_exec_start;
+  task->last_exec_end = run.last_exec_end;
+  task->last_exec_time = run.last_exec_time;
+  task->min_exec_time = run.min_exec_time;
+  task->max_exec_time = run.max_exec_time;
+  task->total_exec_time = run.total_exec_time;
+  task->average_exec_time = run.average_exec_time;
+  task->times_called = run.times_called;
+  task->deadline_failures = run.deadline_failures;
+}
+
+// fills in edf_tasks from the admitted tasks and returns how many there are
+static
+unsigned collect_edf_tasks()
+{
+  unsigned count = 0;
+  for (unsigned i = 0; i < MAX_DEADLINE_TASKS; i++)
+  {
+    if (!thread_used[i])
+      continue;
+    task_t* task = deadline_threads[i].task;
+    edf_tasks[count++] = { uint32_t(task->exec_bound), uint32_t(task->period), uint32_t(task->period) };
+  }
+  return count;
+}
+
+static
+void release_slot(unsigned slot)
+{
+  deadline_thread_t* dt = &deadline_threads[slot];
+  sem_destroy(&dt->started);
+  sem_destroy(&dt->wake);
+  thread_used[slot] = false;
+}
+
+
+// Implementation
+
+static
+bool initialize()
+{
+  return true;
+}
+
+static
+task_acceptance_t add_task(task_t* task)
+{
+  // only periodic tasks can be run on threads
+  if (task->period == 0 || task->exec_bound > task->period)
+    return task_acceptance_t::bound_gt_period;
+
+  unsigned slot = 0;
+  while (slot < MAX_DEADLINE_TASKS && thread_used[slot])
+    slot++;
+  if (slot == MAX_DEADLINE_TASKS)
+    return task_acceptance_t::schedule_full;
+
+  // the EDF test over the admitted tasks and this one
+  unsigned count = collect_edf_tasks();
+  edf_tasks[count++] = { uint32_t(task->exec_bound), uint32_t(task->period), uint32_t(task->period) };
+  if (!edf_schedulable(edf_tasks, count))
+    return task_acceptance_t::can_not_be_scheduled_with_the_other_tasks;
+
+  deadline_thread_t* dt = &deadline_threads[slot];
+  dt->task = task;
+  dt->run = *task;
+  dt->stopping = false;
+  dt->releases = 0;
+  dt->total_latency_ns = 0;
+  dt->max_latency_ns = 0;
+  dt->ticks_per_second = timer_frequency();
+  dt->runtime_ns = ticks_to_ns(task->exec_bound, dt->ticks_per_second);
+  dt->period_ns = ticks_to_ns(task->period, dt->ticks_per_second);
+  if (dt->runtime_ns < MIN_DEADLINE_RUNTIME_NS)
+    dt->runtime_ns = MIN_DEADLINE_RUNTIME_NS;
+  // the first release is at start_not_before, or straight away if that's passed
+  tick_t now = current_tick();
+  dt->first_release_ns = monotonic_ns();
+  if (tick_before(now, task->start_not_before))
+    dt->first_release_ns += ticks_to_ns(task->start_not_before - now, dt->ticks_per_second);
+
+  sem_init(&dt->started, 0, 0);
+  sem_init(&dt->wake, 0, 0);
+  if (pthread_create(&dt->thread, NULL, deadline_thread_main, dt) != 0)
+  {
+    release_slot(slot);
+    return task_acceptance_t::schedule_full;
+  }
+  thread_used[slot] = true;
+  while (sem_wait(&dt->started) == -1 && errno == EINTR)
+    ;
+
+  if (dt->mode == MODE_REJECTED)
+  {
+    pthread_join(dt->thread, NULL);
+    release_slot(slot);
+    return task_acceptance_t::can_not_be_scheduled_with_the_other_tasks;
+  }
+  if (dt->mode > warned_mode)
+  {
+    warned_mode = dt->mode;
+    k_log_fmt(WARNING, "sched_linux_dl: no permission for SCHED_DEADLINE, tasks are running as %s threads without budgets\n",
+              mode_names[dt->mode]);
+  }
+  return task_acceptance_t::accepted;
+}
+
+static
+void remove_task(task_t* task)
+{
+  for (unsigned i = 0; i < MAX_DEADLINE_TASKS; i++)
+  {
+    deadline_thread_t* dt = &deadline_threads[i];
+    if (!thread_used[i] || dt->task != task)
+      continue;
+    dt->stopping = true;
+    sem_post(&dt->wake);
+    pthread_join(dt->thread, NULL);
+    copy_stats(task, dt->run);
+
+    k_log_fmt(NORMAL, "sched_linux_dl: %s as %s, %i releases, latency mean %ins, max %ins\n",
+              task->name ? task->name : "task", mode_names[dt->mode], uint32_t(dt->releases),
+              uint32_t(dt->releases ? dt->total_latency_ns / dt->releases : 0), uint32_t(dt->max_latency_ns));
+    release_slot(i);
+    return;
+  }
+}
+
+scheduler_vtable_t scheduler_linux_deadline_vtable =
+{
+  .initialize = initialize,
+  .add_task = add_task,
+  .remove_task = remove_task,
+};
+
+static
+module_t scheduler_linux_deadline_module =
+{
+  .type    = module_class::SCHEDULER_MODULE,
+  .id      = 0x12025,
+  .name    = { "sched_linux_dl" },
+  .next    = nullptr,
+  .prev    = nullptr,
+  .vtable  = &scheduler_linux_deadline_vtable,
+  .instance = nullptr,
+};
+
+void register_scheduler_linux_deadline_module()
+{
+  module_register(scheduler_linux_deadline_module);
+}
+
+#endif // ENABLE_SCHEDULER_LINUX_DEADLINE
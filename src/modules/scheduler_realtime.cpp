@@ -23,10 +23,16 @@ task_acceptance_t add_task(task_t* /*task*/)
   return task_acceptance_t::schedule_full;
 }
 
+static
+void remove_task(task_t* /*task*/)
+{
+}
+
 scheduler_vtable_t scheduler_realtime_vtable =
 {
   .initialize = initialize,
   .add_task = add_task,
+  .remove_task = remove_task,
 };
 
 static
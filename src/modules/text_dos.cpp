@@ -60,6 +60,12 @@ void clear(text_display_t*)
   clrscr();
 }
 
+static
+void flush(text_display_t*)
+{
+  // writes go directly to the screen, nothing is buffered
+}
+
 static
 text_display_vtable_t text_dos_vtable =
 {
@@ -69,7 +75,8 @@ text_display_vtable_t text_dos_vtable =
   .goto_xy    = goto_xy,
   .put_char   = put_char,
   .put_string = put_string,
-  .clear      = clear
+  .clear      = clear,
+  .flush      = flush
 };
 
 module_t text_dos_module =
@@ -10,38 +10,121 @@
 
 #include "module/text.h"
 #include "module_manager.h"
+#include "runtime/memory.h"
 #include <cstdio>
-#include <sys/ioctl.h>
-#include <sys/termios.h>
-#include <termios.h>
+#include <unistd.h>
+
+#define TTY_COLUMNS          80
+#define TTY_ROWS             50
+#define TTY_OUTPUT_SIZE      (32 * 1024)
+#define TTY_BLANK_ATTRIB     0x07
+#define TTY_UNKNOWN          0xFFFFFFFF
+
+// A character cell, the same as the VGA text mode layout of a
+// character and its attribute (foreground and background colour).
+struct text_cell_t
+{
+  char     ch;
+  uint8_t  attrib;
+};
+
+// Drawing goes in to the back buffer, and flush() sends to the terminal
+// only the cells which differ from the front buffer, which is what was
+// last presented. This avoids a printf per character and re-sending the
+// same cells each frame, which is what most of a redraw ends up being.
+struct text_display_t
+{
+  uint32_t     cur_x;
+  uint32_t     cur_y;
+  bool         dirty;
+
+  // what we believe the terminal's state is currently
+  uint32_t     term_x;
+  uint32_t     term_y;
+  uint32_t     term_attrib;
+
+  text_cell_t  back[TTY_ROWS][TTY_COLUMNS];
+  text_cell_t  front[TTY_ROWS][TTY_COLUMNS];
+};
+
+// Escape sequences are accumulated here so a frame is a single write()
+struct output_buffer_t
+{
+  size_t   length;
+  char     data[TTY_OUTPUT_SIZE];
+};
+
+static
+text_display_t text_tty_instance;
+
+static
+output_buffer_t output;
 
 static
-void initialize(text_display_t*)
+void output_write()
 {
+  // anything written with printf needs to go out before this
+  fflush(stdout);
+  size_t offset = 0;
+  while (offset < output.length)
+  {
+    ssize_t written = write(STDOUT_FILENO, output.data + offset, output.length - offset);
+    if (written <= 0)
+      break;
+    offset += written;
+  }
+  output.length = 0;
 }
 
 static
-uint32_t width(text_display_t*)
+void output_bytes(const char* str, size_t length)
 {
-  // TODO: query
-  return 80;
+  if (output.length + length > TTY_OUTPUT_SIZE)
+    output_write();
+  mem_cpy(output.data + output.length, str, length);
+  output.length += length;
 }
 
 static
-uint32_t height(text_display_t*)
+void output_number(uint32_t val)
 {
-  // TODO: query
-  return 50;
+  char buf[10];
+  char* ptr = buf + sizeof(buf);
+  do {
+    *(--ptr) = '0' + (val % 10);
+  } while (val /= 10);
+  output_bytes(ptr, buf + sizeof(buf) - ptr);
+}
+
+static
+void output_goto_xy(text_display_t* disp, uint32_t x, uint32_t y)
+{
+  output_bytes("\033[", 2);
+  output_number(y + 1);
+  output_bytes(";", 1);
+  output_number(x + 1);
+  output_bytes("H", 1);
+  disp->term_x = x;
+  disp->term_y = y;
 }
 
 static
-void goto_xy(text_display_t*, uint32_t x, uint32_t y)
+void output_attrib(text_display_t* disp, uint8_t attrib)
 {
-  printf("\033[%i;%iH", y + 1, x + 1);
+  // VGA colour order is BGR, ANSI is RGB, so swap the red and blue bits
+  static const uint8_t vga_to_ansi[] = { 0, 4, 2, 6, 1, 5, 3, 7 };
+  uint8_t fg = attrib & 0x0F;
+  uint8_t bg = (attrib >> 4) & 0x07;
+  output_bytes("\033[", 2);
+  output_number(((fg & 0x08) ? 90 : 30) + vga_to_ansi[fg & 0x07]);
+  output_bytes(";", 1);
+  output_number(bg ? (40 + vga_to_ansi[bg]) : 49);
+  output_bytes("m", 1);
+  disp->term_attrib = attrib;
 }
 
 static
-void put_char(text_display_t*, uint8_t /*attrib*/, char ch1)
+void output_char(char ch1)
 {
   unsigned char ch = static_cast<unsigned char>(ch1);
   // These are each 3-bytes in utf-8 (but were a single byte in old DOS code-page / ROM font)
@@ -49,21 +132,105 @@ void put_char(text_display_t*, uint8_t /*attrib*/, char ch1)
   if (ch >= 0xB3 && ch <= 0xDA)
   {
     ch -= 0xB3;
-    char c1 = charLUT[ch*3+0];
-    char c2 = charLUT[ch*3+1];
-    char c3 = charLUT[ch*3+2];
-    printf("%c%c%c", c1, c2, c3);
+    output_bytes(&charLUT[ch*3], 3);
   }
   else if (ch == 0xDB)
   {
-    printf("▇");
+    output_bytes("▇", 3);
   }
   else
   {
-    printf("%c", ch);
+    output_bytes(&ch1, 1);
+  }
+}
+
+static
+void fill_cells(text_cell_t (&cells)[TTY_ROWS][TTY_COLUMNS])
+{
+  for (unsigned y = 0; y < TTY_ROWS; ++y)
+    for (unsigned x = 0; x < TTY_COLUMNS; ++x)
+      cells[y][x] = { ' ', TTY_BLANK_ATTRIB };
+}
+
+static
+void scroll_up(text_display_t* disp)
+{
+  mem_move(&disp->back[0][0], &disp->back[1][0], sizeof(disp->back[0]) * (TTY_ROWS - 1));
+  for (unsigned x = 0; x < TTY_COLUMNS; ++x)
+    disp->back[TTY_ROWS - 1][x] = { ' ', TTY_BLANK_ATTRIB };
+}
+
+static
+void new_line(text_display_t* disp)
+{
+  disp->cur_x = 0;
+  disp->cur_y++;
+  if (disp->cur_y >= TTY_ROWS)
+  {
+    disp->cur_y = TTY_ROWS - 1;
+    scroll_up(disp);
   }
 }
 
+static
+void initialize(text_display_t* disp)
+{
+  fill_cells(disp->back);
+  fill_cells(disp->front);
+  disp->cur_x = 0;
+  disp->cur_y = 0;
+  disp->dirty = false;
+  disp->term_x = TTY_UNKNOWN;
+  disp->term_y = TTY_UNKNOWN;
+  disp->term_attrib = TTY_UNKNOWN;
+}
+
+static
+uint32_t width(text_display_t*)
+{
+  // TODO: query
+  return TTY_COLUMNS;
+}
+
+static
+uint32_t height(text_display_t*)
+{
+  // TODO: query
+  return TTY_ROWS;
+}
+
+static
+void goto_xy(text_display_t* disp, uint32_t x, uint32_t y)
+{
+  disp->cur_x = (x < TTY_COLUMNS) ? x : TTY_COLUMNS - 1;
+  disp->cur_y = (y < TTY_ROWS) ? y : TTY_ROWS - 1;
+}
+
+static
+void put_char(text_display_t* disp, uint8_t attrib, char ch)
+{
+  if (ch == '\n')
+  {
+    new_line(disp);
+    return;
+  }
+  if (ch == '\r')
+  {
+    disp->cur_x = 0;
+    return;
+  }
+
+  // control characters would upset the terminal's idea of the cursor
+  if (static_cast<unsigned char>(ch) < ' ')
+    ch = ' ';
+
+  disp->back[disp->cur_y][disp->cur_x] = { ch, attrib };
+  disp->dirty = true;
+  disp->cur_x++;
+  if (disp->cur_x >= TTY_COLUMNS)
+    new_line(disp);
+}
+
 static
 void put_string(text_display_t* disp, uint8_t attrib, const char* str)
 {
@@ -76,9 +243,57 @@ void put_string(text_display_t* disp, uint8_t attrib, const char* str)
 }
 
 static
-void clear(text_display_t*)
+void clear(text_display_t* disp)
+{
+  // Clearing is done straight away so it is ordered with any printf output
+  initialize(disp);
+  output_bytes("\033c", 2);
+  output_write();
+}
+
+static
+void flush(text_display_t* disp)
 {
-  printf("\033c");
+  if (!disp->dirty)
+    return;
+
+  for (uint32_t y = 0; y < TTY_ROWS; ++y)
+  {
+    for (uint32_t x = 0; x < TTY_COLUMNS; ++x)
+    {
+      const text_cell_t& cell = disp->back[y][x];
+      text_cell_t& presented = disp->front[y][x];
+      if (cell.ch == presented.ch && cell.attrib == presented.attrib)
+        continue;
+
+      // A short gap on the same row is cheaper to re-send than to jump over
+      if (disp->term_y == y && disp->term_x < x && x - disp->term_x <= 3)
+      {
+        for (uint32_t i = disp->term_x; i < x; ++i)
+        {
+          if (disp->back[y][i].attrib != disp->term_attrib)
+            output_attrib(disp, disp->back[y][i].attrib);
+          output_char(disp->back[y][i].ch);
+        }
+      }
+      else if (disp->term_y != y || disp->term_x != x)
+      {
+        output_goto_xy(disp, x, y);
+      }
+
+      if (cell.attrib != disp->term_attrib)
+        output_attrib(disp, cell.attrib);
+      output_char(cell.ch);
+      presented = cell;
+
+      // The terminal might wrap or not at the last column, so after that
+      // the cursor position is not known until it is next explicitly set.
+      disp->term_x = (x + 1 < TTY_COLUMNS) ? x + 1 : TTY_UNKNOWN;
+    }
+  }
+
+  output_write();
+  disp->dirty = false;
 }
 
 static
@@ -90,7 +305,8 @@ text_display_vtable_t text_tty_vtable =
   .goto_xy    = goto_xy,
   .put_char   = put_char,
   .put_string = put_string,
-  .clear      = clear
+  .clear      = clear,
+  .flush      = flush
 };
 
 module_t text_tty_module =
@@ -101,7 +317,7 @@ module_t text_tty_module =
   .next       = nullptr,
   .prev       = nullptr,
   .vtable     = &text_tty_vtable,
-  .instance   = nullptr,
+  .instance   = &text_tty_instance,
 };
 
 void register_text_tty_display()
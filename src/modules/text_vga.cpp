@@ -113,6 +113,12 @@ void clear(text_display_t* disp)
   disp->cur_y = 0;
 }
 
+static
+void flush(text_display_t*)
+{
+  // writes go directly to the screen, nothing is buffered
+}
+
 static
 text_display_vtable_t text_vga_vtable =
 {
@@ -122,7 +128,8 @@ text_display_vtable_t text_vga_vtable =
   .goto_xy    = goto_xy,
   .put_char   = put_char,
   .put_string = put_string,
-  .clear      = clear
+  .clear      = clear,
+  .flush      = flush
 };
 
 static
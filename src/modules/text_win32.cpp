@@ -54,6 +54,12 @@ void clear(text_display_t*)
 {
 }
 
+static
+void flush(text_display_t*)
+{
+  // writes go directly to the screen, nothing is buffered
+}
+
 static
 text_display_vtable_t text_win32_vtable =
 {
@@ -63,7 +69,8 @@ text_display_vtable_t text_win32_vtable =
   .goto_xy    = goto_xy,
   .put_char   = put_char,
   .put_string = put_string,
-  .clear      = clear
+  .clear      = clear,
+  .flush      = flush
 };
 
 module_t text_win32_module =
@@ -217,4 +217,10 @@ void set_current_tick(tick_t tick)
   current_tick_ = tick;
 }
 
+uint32_t timer_frequency()
+{
+  // the PIT's input clock is 1193182 Hz, and a rate of 0 divides it by 65536
+  return 1193182UL / (timer_speed ? timer_speed : 0x10000UL);
+}
+
 #endif // ENABLE_TIMER_DOS
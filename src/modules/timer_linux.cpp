@@ -8,35 +8,46 @@
 
 #ifdef ENABLE_TIMER_LINUX
 
+#include "conio.h"
 #include "module/timer.h"
+#include "module/precise_sleep.h"
 #include "module_manager.h"
+#include "kernel/trace.h"
 
+#ifdef ENABLE_PROFILER_LINUX
+#include "kernel/profiler.h"
+#include "module/profiler_linux.h"
+#endif
+
+// the POSIX timer_t would conflict with the kernel's
+#define timer_t posix_timer_t
 #include <cstdio>
 #include <cstdlib>
 #include <csignal>
-#include <cstdint>
 #include <ctime>
 #include <atomic>
+#include <climits>
 
+#include <linux/futex.h>
+#include <sys/syscall.h>
 #include <unistd.h>
+#undef timer_t
 
 //#include "timer.h"
 
 
 // Global variables
-static volatile tick_t current_tick_ = 0;   // number of ticks since timer was enabled
+static std::atomic<tick_t> current_tick_(0);   // number of ticks since timer was enabled
 static unsigned timer_speed = 1000;
 static std::atomic_bool timer_active(false);
 static tick_t preempt_at_tick = 0;
 static preemptor_t user_preemptor = nullptr;
 static void* user_preemptor_data = nullptr;
 static std::atomic_bool preemptor_active(false);
+static std::atomic<uint32_t> tick_event_(0);   // futex word which changes every tick
+static std::atomic<uint32_t> idle_waiters(0);
 static std::atomic_bool installed_timer_interrupt_in_service(false);
-static timer_t timerid;
-
-
-// Externs
-extern void draw_tasks();
+static posix_timer_t timerid;
 
 
 static void block_timer()
@@ -72,6 +83,14 @@ static void sigtrap(int /*sig*/)
   exit(EXIT_SUCCESS);
 }
 
+static void wake_idle_waiters()
+{
+  tick_event_++;
+  // the system call is only made when something is waiting
+  if (idle_waiters)
+    syscall(SYS_futex, &tick_event_, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+}
+
 static void preemptor()
 {
   if ((preempt_at_tick == 0) || (user_preemptor == nullptr) || (preemptor_active == true))
@@ -79,7 +98,7 @@ static void preemptor()
     return;
   }
 
-  if (current_tick_ >= preempt_at_tick)
+  if (!tick_before(current_tick_, preempt_at_tick))
   {
     preemptor_active = true;
     // run the user function
@@ -91,12 +110,19 @@ static void preemptor()
   }
 }
 
-static void vector(int, siginfo_t*, void*)
+static void vector(int, siginfo_t*, void* context)
 {
+#ifdef ENABLE_PROFILER_LINUX
+  profiler_record_sample(signal_interrupted_pc(context), 0);
+#else
+  (void)context;
+#endif
   if (installed_timer_interrupt_in_service == true)
     return;
   installed_timer_interrupt_in_service = true;
   current_tick_++;
+  trace_event(TRACE_TIMER_TICK, nullptr, uint32_t(current_tick_));
+  wake_idle_waiters();
   preemptor();
   installed_timer_interrupt_in_service = false;
 }
@@ -106,12 +132,12 @@ static void vector(int, siginfo_t*, void*)
 // sets the speed at which timer interrupts are made
 static void set_timer_speed()
 {
-  // clamp timer_speed to be between 1 and 10000
-  timer_speed = (timer_speed <= 0) ? 1 : ((timer_speed >= 10000) ? 10000 : timer_speed);
+  // clamp timer_speed to be between 1 and 100000
+  timer_speed = (timer_speed <= 0) ? 1 : ((timer_speed >= 100000) ? 100000 : timer_speed);
 
   struct itimerspec its;
-  its.it_value.tv_sec = 0;
-  its.it_value.tv_nsec = 1000000000 / timer_speed;
+  its.it_value.tv_sec = 1 / timer_speed;
+  its.it_value.tv_nsec = (1000000000 / timer_speed) % 1000000000;
   its.it_interval.tv_sec = its.it_value.tv_sec;
   its.it_interval.tv_nsec = its.it_value.tv_nsec;
   if (timer_settime(timerid, 0, &its, NULL) == -1)
@@ -167,6 +193,9 @@ static void enable_timer()
   // catch ctrl-c
   signal(SIGINT, &sigtrap);
 
+  // before there are ticks interrupting it
+  calibrate_precise_sleep();
+
   // Set up handler for timer
   struct sigaction sa;
   sa.sa_flags = SA_SIGINFO;
@@ -228,13 +257,16 @@ static void slow_down_timer()
   set_timer_speed();
 }
 
-// delay() causes the computer to idle for the given number of ticks.
-// It works by the fact that timer updates current_tick.
+// delay() causes the computer to idle for the given number of ticks, at
+// the current timer speed. Rather than polling for current_tick to change,
+// which could overshoot by up to a tick, it sleeps until the time the ticks
+// are up, so the CPU is free while waiting. Redrawing is left to the
+// "Visualize Schedule" task, so the deadline isn't needed.
 // The function could be re-written as a pre-empt routine, except this
 // function couldn't be pre-empted because currently only one pre-empt
 // function can be installed at a time.
 // The pre-emptor should be reserved for use by the scheduler only.
-void delay(ticks_t number_of_ticks, tick_t deadline)
+void delay(ticks_t number_of_ticks, tick_t /*deadline*/)
 {
   // must not call this if timer handler isn't installed
   if (timer_active == false)
@@ -243,36 +275,7 @@ void delay(ticks_t number_of_ticks, tick_t deadline)
     exit(0);
   }
 
-  tick_t finish_at = current_tick_ + number_of_ticks;
-  if (deadline == 0)
-    deadline = finish_at;
-
-  if (current_tick_ > finish_at)
-  {
-    printf("error: overflow condition in delay\n");
-    exit(0);
-  }
-
-  while (current_tick_ < finish_at)
-  {
-    // wait for next tick
-    tick_t next_tick = current_tick_ + 1;
-
-    // If enough slack to do some screen refresh
-    if (current_tick_ + 40 < deadline)
-    {
-      // update the bar view of the tasks every tick
-      draw_tasks();
-    }
-
-    while (current_tick_ < next_tick)
-    {
-      /* do nothing */
-
-      // avoid busy loop when on hosted OS
-      usleep(10);
-    }
-  }
+  sleep_ns(uint64_t(number_of_ticks) * 1000000000 / timer_speed);
 }
 
 tick_t current_tick()
@@ -285,10 +288,24 @@ void set_current_tick(tick_t tick)
   current_tick_ = tick;
 }
 
+uint32_t timer_frequency()
+{
+  return timer_speed;
+}
+
+void wait_for_timer_event()
+{
+  uint32_t seen = tick_event_;
+  idle_waiters++;
+  // doesn't sleep if there has been a tick since it was read
+  syscall(SYS_futex, &tick_event_, FUTEX_WAIT_PRIVATE, seen, NULL, NULL, 0);
+  idle_waiters--;
+}
+
 static
-timer_driver_t macos_timer =
+timer_driver_t linux_timer =
 {
-  "macos_timer",
+  "linux_timer",
   install_preempt_func,
   uninstall_preempt_func,
   enable_timer,
@@ -299,11 +316,19 @@ timer_driver_t macos_timer =
   slow_down_timer
 };
 
-timer_driver_t timer;
+timer_driver_t& get_timer_ref()
+{
+  return linux_timer;
+}
 
 void initialize_timer_driver()
 {
-  timer = macos_timer;
+  timer = linux_timer;
+}
+
+void start_timer()
+{
+  enable_timer();
 }
 
 #endif // ENABLE_TIMER_LINUX
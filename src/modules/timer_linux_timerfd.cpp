@@ -0,0 +1,392 @@
+/*
+  Real-time Scheduler
+  Copyright (c) 2023, John Ryland
+  All rights reserved.
+*/
+
+#include <config.h>
+
+#ifdef ENABLE_TIMER_LINUX_TIMERFD
+
+// The ticks come from a timerfd on CLOCK_MONOTONIC which a thread of its
+// own blocks on, instead of a POSIX timer signal. So the ticks don't jump
+// when the wall clock is stepped, the tasks' system calls aren't
+// interrupted by signals, and suspending and resuming doesn't need the
+// signal mask changing. Reading the timerfd gives how many times it has
+// expired since it was last read, so if the thread is held up the ticks
+// it missed are still counted.
+//
+// While profiling, the thread sends the tasks' thread a SIGPROF each tick,
+// so the profiler sees where that thread was and not the timer thread.
+// In the same way, once the preemptor is due the thread sends the tasks'
+// thread PREEMPT_SIGNAL, so the preemptor runs on the thread of the task
+// it stops, between the task's instructions, as it does with the signal
+// driven timer. The install and uninstall are then only ever interrupted
+// by it on the same thread, which preemptor_active guards against.
+//
+// The thread asks for SCHED_FIFO so it isn't held up by the other threads,
+// which needs CAP_SYS_NICE or an RLIMIT_RTPRIO, and runs at the normal
+// priority if it can't have it.
+
+#include "conio.h"
+#include "module/timer.h"
+#include "module/precise_sleep.h"
+#include "kernel/trace.h"
+
+#ifdef ENABLE_PROFILER_LINUX
+#include "kernel/profiler.h"
+#include "module/profiler_linux.h"
+#endif
+
+// the POSIX timer_t would conflict with the kernel's
+#define timer_t posix_timer_t
+#include <cstdio>
+#include <cstdlib>
+#include <csignal>
+#include <atomic>
+#include <climits>
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/timerfd.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#undef timer_t
+
+#define PREEMPT_SIGNAL   SIGRTMIN
+
+
+// Global variables
+static std::atomic<tick_t> current_tick_(0);   // number of ticks since timer was enabled
+static unsigned timer_speed = 1000;
+static std::atomic_bool timer_active(false);
+static bool thread_started = false;
+// read by the timer thread to know when to signal
+static std::atomic<tick_t> preempt_at_tick(0);
+static std::atomic<preemptor_t> user_preemptor(nullptr);
+static std::atomic<void*> user_preemptor_data(nullptr);
+static std::atomic_bool preemptor_active(false);
+static std::atomic<uint32_t> tick_event_(0);   // futex word which changes every tick
+static std::atomic<uint32_t> idle_waiters(0);
+static int timer_fd = -1;
+static pthread_t timer_thread;
+static pthread_t tasks_thread;     // the thread which enabled the timer
+
+
+[[ noreturn ]]
+static void sigtrap(int /*sig*/)
+{
+  timer_active = false;
+  clrscr();
+  printf("CTRL-C received, exiting program\n");
+  exit(EXIT_SUCCESS);
+}
+
+static void wake_idle_waiters()
+{
+  tick_event_++;
+  // the system call is only made when something is waiting
+  if (idle_waiters)
+    syscall(SYS_futex, &tick_event_, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+}
+
+// run on the tasks' thread, by PREEMPT_SIGNAL
+static void preemptor()
+{
+  if ((preempt_at_tick == 0) || (user_preemptor == nullptr) || (preemptor_active == true))
+  {
+    return;
+  }
+
+  if (!tick_before(current_tick_, preempt_at_tick))
+  {
+    preemptor_active = true;
+    // run the user function
+    user_preemptor(user_preemptor_data);
+    // uninstall it when done
+    preempt_at_tick = 0;
+    user_preemptor = nullptr;
+    preemptor_active = false;
+  }
+}
+
+static void preempt_vector(int)
+{
+  preemptor();
+}
+
+// restarting, so the tasks' system calls aren't interrupted by it
+static void install_preempt_vector()
+{
+  struct sigaction sa;
+  sa.sa_flags = SA_RESTART;
+  sa.sa_handler = preempt_vector;
+  sigemptyset(&sa.sa_mask);
+  if (sigaction(PREEMPT_SIGNAL, &sa, NULL) == -1)
+  {
+    perror("sigaction");
+    exit(EXIT_FAILURE);
+  }
+}
+
+#ifdef ENABLE_PROFILER_LINUX
+static void profile_vector(int, siginfo_t*, void* context)
+{
+  profiler_record_sample(signal_interrupted_pc(context), 0);
+}
+
+// restarting, so the tasks' system calls aren't interrupted by it
+static void install_profile_vector()
+{
+  struct sigaction sa;
+  sa.sa_flags = SA_SIGINFO | SA_RESTART;
+  sa.sa_sigaction = profile_vector;
+  sigemptyset(&sa.sa_mask);
+  if (sigaction(SIGPROF, &sa, NULL) == -1)
+  {
+    perror("sigaction");
+    exit(EXIT_FAILURE);
+  }
+}
+#endif
+
+static void* timer_thread_main(void*)
+{
+  for (;;)
+  {
+    uint64_t expirations = 0;
+    if (read(timer_fd, &expirations, sizeof(expirations)) != sizeof(expirations))
+      continue;
+    // an expiration from before the timer was disabled
+    if (!timer_active)
+      continue;
+    current_tick_ += tick_t(expirations);
+    trace_event(TRACE_TIMER_TICK, nullptr, uint32_t(current_tick_));
+#ifdef ENABLE_PROFILER_LINUX
+    if (profiler_enabled())
+      pthread_kill(tasks_thread, SIGPROF);
+#endif
+    wake_idle_waiters();
+    // it is sent again each tick until the preemptor has run or is uninstalled
+    tick_t preempt_at = preempt_at_tick;
+    if (preempt_at != 0 && !tick_before(current_tick_, preempt_at))
+      pthread_kill(tasks_thread, PREEMPT_SIGNAL);
+  }
+}
+
+// Local functions
+
+// sets the timer to expire at timer_speed a second, or disarms it for 0
+static void arm_timer(unsigned speed)
+{
+  struct itimerspec its = {};
+  if (speed)
+  {
+    its.it_value.tv_sec = 1 / speed;
+    its.it_value.tv_nsec = (1000000000 / speed) % 1000000000;
+    its.it_interval = its.it_value;
+  }
+  if (timerfd_settime(timer_fd, 0, &its, NULL) == -1)
+  {
+    perror("timerfd_settime");
+    exit(EXIT_FAILURE);
+  }
+}
+
+// sets the speed at which timer interrupts are made
+static void set_timer_speed()
+{
+  // clamp timer_speed to be between 1 and 100000
+  timer_speed = (timer_speed <= 0) ? 1 : ((timer_speed >= 100000) ? 100000 : timer_speed);
+  if (timer_active)
+    arm_timer(timer_speed);
+}
+
+static void start_timer_thread()
+{
+  thread_started = true;
+  if (pthread_create(&timer_thread, NULL, timer_thread_main, NULL) != 0)
+  {
+    perror("pthread_create");
+    exit(EXIT_FAILURE);
+  }
+
+  struct sched_param param = {};
+  param.sched_priority = sched_get_priority_max(SCHED_FIFO);
+  if (pthread_setschedparam(timer_thread, SCHED_FIFO, &param) != 0)
+    fprintf(stderr, "timer: no permission for SCHED_FIFO, the timer thread is running at normal priority\n");
+}
+
+
+// Implementation
+
+// installs a user function that will get called at the given tick
+static bool install_preempt_func(tick_t event_time, preemptor_t user_func, void* user_data)
+{
+  // if it's unsafe to install a user_func or one is already installed
+  // then return false
+  if ((user_func == nullptr) || (user_preemptor != nullptr) || (true == preemptor_active))
+    return false;
+  preemptor_active = true;
+  preempt_at_tick = event_time;
+  user_preemptor = user_func;
+  user_preemptor_data = user_data;
+  preemptor_active = false;
+  return true;
+}
+
+// uninstalls an installed user function
+static bool uninstall_preempt_func()
+{
+  // if it's unsafe to uninstall a user_func then return false
+  if (preemptor_active == true)
+    return false;
+  preemptor_active = true;
+  preempt_at_tick = 0;
+  user_preemptor = nullptr;
+  user_preemptor_data = nullptr;
+  preemptor_active = false;
+  return true;
+}
+
+// resumes timer so current_tick resumes updating from where it was suspended
+static void resume_timer()
+{
+  timer_active = true;
+  arm_timer(timer_speed);
+}
+
+// starts timer so that current_tick will automatically update
+static void enable_timer()
+{
+  // catch ctrl-c
+  signal(SIGINT, &sigtrap);
+
+  // before there are ticks interrupting it
+  calibrate_precise_sleep();
+
+  if (timer_fd == -1)
+  {
+    timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    if (timer_fd == -1)
+    {
+      perror("timerfd_create");
+      exit(EXIT_FAILURE);
+    }
+  }
+  tasks_thread = pthread_self();
+  install_preempt_vector();
+#ifdef ENABLE_PROFILER_LINUX
+  install_profile_vector();
+#endif
+  if (!thread_started)
+    start_timer_thread();
+
+  timer_speed = 1000;
+  current_tick_ = 0;
+  resume_timer();
+}
+
+// stops timer
+static void disable_timer()
+{
+  timer_active = false;
+  arm_timer(0);
+}
+
+// suspends timer so current_tick can be temporarily made to stop updating
+static void suspend_timer()
+{
+  disable_timer();
+}
+
+// speeds up timer so current_tick updates faster
+static void speed_up_timer()
+{
+  timer_speed = timer_speed * 2;
+  set_timer_speed();
+}
+
+// slows timer so current_tick updating more slowly
+static void slow_down_timer()
+{
+  timer_speed = timer_speed / 2;
+  set_timer_speed();
+}
+
+// delay() causes the computer to idle for the given number of ticks, at
+// the current timer speed. Rather than polling for current_tick to change,
+// which could overshoot by up to a tick, it sleeps until the time the ticks
+// are up, so the CPU is free while waiting. Redrawing is left to the
+// "Visualize Schedule" task, so the deadline isn't needed.
+// The function could be re-written as a pre-empt routine, except this
+// function couldn't be pre-empted because currently only one pre-empt
+// function can be installed at a time.
+// The pre-emptor should be reserved for use by the scheduler only.
+void delay(ticks_t number_of_ticks, tick_t /*deadline*/)
+{
+  // must not call this if timer handler isn't installed
+  if (timer_active == false)
+  {
+    printf("error: cannot call delay unless timer is enabled\n");
+    exit(0);
+  }
+
+  sleep_ns(uint64_t(number_of_ticks) * 1000000000 / timer_speed);
+}
+
+tick_t current_tick()
+{
+  return current_tick_;
+}
+
+void set_current_tick(tick_t tick)
+{
+  current_tick_ = tick;
+}
+
+uint32_t timer_frequency()
+{
+  return timer_speed;
+}
+
+void wait_for_timer_event()
+{
+  uint32_t seen = tick_event_;
+  idle_waiters++;
+  // doesn't sleep if there has been a tick since it was read
+  syscall(SYS_futex, &tick_event_, FUTEX_WAIT_PRIVATE, seen, NULL, NULL, 0);
+  idle_waiters--;
+}
+
+static
+timer_driver_t linux_timerfd_timer =
+{
+  "linux_timerfd_timer",
+  install_preempt_func,
+  uninstall_preempt_func,
+  enable_timer,
+  disable_timer,
+  suspend_timer,
+  resume_timer,
+  speed_up_timer,
+  slow_down_timer
+};
+
+timer_driver_t& get_timer_ref()
+{
+  return linux_timerfd_timer;
+}
+
+void initialize_timer_driver()
+{
+  // nothing is set up until the timer is enabled
+}
+
+void start_timer()
+{
+  enable_timer();
+}
+
+#endif // ENABLE_TIMER_LINUX_TIMERFD
@@ -510,6 +510,17 @@ void set_current_tick(tick_t tick)
   current_tick_ = tick;
 }
 
+uint32_t timer_frequency()
+{
+  return timer_speed;
+}
+
+// there isn't a futex to wait on the tick with, so this just naps briefly
+void wait_for_timer_event()
+{
+  usleep(10);
+}
+
 static
 timer_driver_t macos_timer =
 {
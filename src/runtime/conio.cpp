@@ -132,6 +132,7 @@ void puts2(const char* str)
 struct conio_data
 {
   bool                    init;
+  uint32_t                generation;
   text_display_t*         text_display_data;
   text_display_vtable_t*  text_display_functions;
   keyboard_vtable_t*      keyboard_functions;
@@ -143,6 +144,7 @@ conio_data state;
 void initialize_conio()
 {
   state.init = false;
+  state.generation = modules_generation();
   module_t const* keyboard_module = find_module_by_class(module_class::KEYBOARD_DRIVER);
   module_t const* text_display_module = find_module_by_class(module_class::TEXT_DISPLAY);
   if (keyboard_module && text_display_module)
@@ -154,8 +156,18 @@ void initialize_conio()
   }
 }
 
+// the modules looked up are cached, so only look again if they have changed
+static inline
+bool conio_ready()
+{
+  if (state.generation != modules_generation())
+    initialize_conio();
+  return state.init;
+}
+
 extern void goto_xy(unsigned x, unsigned y);
 extern void clear_screen();
+extern void flush_screen();
 extern void log_char(char ch);
 
 extern "C"
@@ -163,14 +175,16 @@ extern "C"
 
 bool kbhit()
 {
-  if (state.init == false)
+  if (!conio_ready())
     return true;
+  // polling for input is a good time to present what has been drawn
+  flush_screen();
   return state.keyboard_functions->key_pressed();
 }
 
 void clrscr()
 {
-  if (state.init == false)
+  if (!conio_ready())
     return;
   clear_screen();
   // state.text_display_functions->clear(state.text_display_data);
@@ -178,7 +192,7 @@ void clrscr()
 
 void gotoxy(unsigned x, unsigned y)
 {
-  if (state.init == false)
+  if (!conio_ready())
     return;
   goto_xy(x, y);
   // state.text_display_functions->goto_xy(state.text_display_data, x, y);
@@ -186,21 +200,22 @@ void gotoxy(unsigned x, unsigned y)
 
 void textmode(int)
 {
-  if (state.init == false)
+  if (!conio_ready())
     return;
   state.text_display_functions->initialize(state.text_display_data);
 }
 
 int getch()
 {
-  if (state.init == false)
+  if (!conio_ready())
     return 0;
+  flush_screen();
   return state.keyboard_functions->get_char();
 }
 
 void putch(char ch)
 {
-  if (state.init == false)
+  if (!conio_ready())
     return;
   log_char(ch);
   // state.text_display_functions->put_char(state.text_display_data, 0x08, ch);
@@ -208,7 +223,7 @@ void putch(char ch)
 
 void puts2(const char* str)
 {
-  if (state.init == false)
+  if (!conio_ready())
     return;
   state.text_display_functions->put_string(state.text_display_data, 0x08, str);
 }
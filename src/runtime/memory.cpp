@@ -5,6 +5,8 @@
 */
 
 #include "runtime/memory.h"
+#include "module/cpu.h"
+#include "module_manager.h"
 
 // Safer versions
 
@@ -31,23 +33,14 @@ struct array
 
 void mem_set(mem dst, int val)
 {
-  uint8_t* dstc = (uint8_t*)dst.ptr;
-  for (size_t i = 0; i < dst.size; ++i)
-    dstc[i] = val;
+  mem_set(dst.ptr, val, dst.size);
 }
 
 bool mem_move(mem dst, const mem src)
 {
   if (dst.size < src.size)
     return false;
-  uint8_t* dstc = (uint8_t*)dst.ptr;
-  uint8_t* srcc = (uint8_t*)src.ptr;
-  if (dstc < srcc)
-    for (size_t i = 0; i < src.size; ++i)
-      dstc[i] = srcc[i];
-  else
-    for (size_t i = src.size-1; (i+1) >= 1; --i)
-      dstc[i] = srcc[i];
+  mem_move(dst.ptr, src.ptr, src.size);
   return true;
 }
 
@@ -61,15 +54,9 @@ int mem_cmp(const mem dst, const mem src)
   if ((dst.ptr == src.ptr) || (!dst.size && !src.size))
     return 0;
   size_t cmp_len = (dst.size < src.size) ? dst.size : src.size;
-  uint8_t* dstc = (uint8_t*)dst.ptr;
-  uint8_t* srcc = (uint8_t*)src.ptr;
-  for (size_t i = 0; i < cmp_len; ++i)
-  {
-    if (dstc[i] < srcc[i])
-      return -1;
-    else if (dstc[i] > srcc[i])
-      return 1;
-  }
+  int result = mem_cmp(dst.ptr, src.ptr, cmp_len);
+  if (result)
+    return result;
   if (dst.size < src.size)
     return -1;
   else if (dst.size > src.size)
@@ -81,16 +68,7 @@ bool mem_swap(mem first, mem second)
 {
   if (first.size != second.size)
     return false;
-  if (first.ptr == second.ptr)
-    return true;
-  uint8_t* left = (uint8_t*)first.ptr;
-  uint8_t* right = (uint8_t*)second.ptr;
-  for (size_t i = 0; i < first.size; ++i)
-  {
-    uint8_t tmp = left[i];
-    left[i] = right[i];
-    right[i] = tmp;
-  }
+  mem_swap(first.ptr, second.ptr, first.size);
   return true;
 }
 
@@ -111,60 +89,204 @@ bool mem_swap(mem first, mem second)
   Then everywhere void* is used, replace with ref to mem.
 */
 
-void* mem_set(void* dst, int val, size_t len)
+// Word at a time versions
+//
+// These work a machine word at a time, with byte loops for the unaligned
+// head and tail. Stores are aligned, loads from the source may not be.
+// They are portable so are used before the cpu specific ones are picked,
+// and for small sizes where calling through the table costs more than
+// it saves.
+
+typedef size_t word_t __attribute__((may_alias));
+typedef size_t unaligned_word_t __attribute__((aligned(1), may_alias));
+
+#define WORD_SIZE                 sizeof(size_t)
+#define WORD_MASK                 (WORD_SIZE - 1)
+#define MEM_DISPATCH_THRESHOLD    64
+
+static
+void* word_set(void* dst, int val, size_t len)
 {
   uint8_t* dstc = (uint8_t*)dst;
-  for (size_t i = 0; i < len; ++i)
-    dstc[i] = val;
+  while (len && (size_t(dstc) & WORD_MASK))
+  {
+    *dstc++ = val;
+    --len;
+  }
+  size_t pattern = uint8_t(val) * (~size_t(0) / 0xFF);  // val repeated in each byte
+  for (; len >= WORD_SIZE; len -= WORD_SIZE, dstc += WORD_SIZE)
+    *(word_t*)dstc = pattern;
+  while (len--)
+    *dstc++ = val;
   return dst;
 }
 
-void* mem_move(void* dst, const void* src, size_t len)
+// Copying a word at a time keeps the memmove semantics, each word is read before
+// it is written so when copying forwards the write can only overlap source
+// bytes already read, and the same when copying backwards.
+static
+void* word_move(void* dst, const void* src, size_t len)
 {
   uint8_t* dstc = (uint8_t*)dst;
-  uint8_t* srcc = (uint8_t*)src;
-  if (dst < src)
-    for (size_t i = 0; i < len; ++i)
-      dstc[i] = srcc[i];
+  const uint8_t* srcc = (const uint8_t*)src;
+  if (dstc == srcc || !len)
+    return dst;
+  if (dstc < srcc || dstc >= srcc + len)
+  {
+    while (len && (size_t(dstc) & WORD_MASK))
+    {
+      *dstc++ = *srcc++;
+      --len;
+    }
+    for (; len >= WORD_SIZE; len -= WORD_SIZE, dstc += WORD_SIZE, srcc += WORD_SIZE)
+      *(word_t*)dstc = *(const unaligned_word_t*)srcc;
+    while (len--)
+      *dstc++ = *srcc++;
+  }
   else
-    for (size_t i = len-1; (i+1) >= 1; --i)
-      dstc[i] = srcc[i];
+  {
+    // dst overlaps the end of src, so copy backwards
+    dstc += len;
+    srcc += len;
+    while (len && (size_t(dstc) & WORD_MASK))
+    {
+      *--dstc = *--srcc;
+      --len;
+    }
+    for (; len >= WORD_SIZE; len -= WORD_SIZE)
+    {
+      dstc -= WORD_SIZE;
+      srcc -= WORD_SIZE;
+      *(word_t*)dstc = *(const unaligned_word_t*)srcc;
+    }
+    while (len--)
+      *--dstc = *--srcc;
+  }
   return dst;
 }
 
-void* mem_cpy(void* dst, const void* src, size_t len)
-{
-  return mem_move(dst, src, len);
-}
-
-int mem_cmp(const void* dst, const void* src, size_t len)
+static
+int word_cmp(const void* dst, const void* src, size_t len)
 {
   if (dst == src || !len)
     return 0;
-  uint8_t* dstc = (uint8_t*)dst;
-  uint8_t* srcc = (uint8_t*)src;
-  for (size_t i = 0; i < len; ++i)
+  const uint8_t* dstc = (const uint8_t*)dst;
+  const uint8_t* srcc = (const uint8_t*)src;
+  // skip the words which are the same, then find which byte differs
+  while (len >= WORD_SIZE && *(const unaligned_word_t*)dstc == *(const unaligned_word_t*)srcc)
   {
-    if (dstc[i] < srcc[i])
-      return -1;
-    else if (dstc[i] > srcc[i])
-      return 1;
+    dstc += WORD_SIZE;
+    srcc += WORD_SIZE;
+    len -= WORD_SIZE;
   }
+  for (; len; --len, ++dstc, ++srcc)
+    if (*dstc != *srcc)
+      return (*dstc < *srcc) ? -1 : 1;
   return 0;
 }
 
-void mem_swap(void* first, void* second, size_t len)
+static
+void word_swap(void* first, void* second, size_t len)
 {
   if (first == second || !len)
     return;
   uint8_t* left = (uint8_t*)first;
   uint8_t* right = (uint8_t*)second;
-  for (size_t i = 0; i < len; ++i)
+  for (; len >= WORD_SIZE; len -= WORD_SIZE, left += WORD_SIZE, right += WORD_SIZE)
   {
-    uint8_t tmp = left[i];
-    left[i] = right[i];
-    right[i] = tmp;
+    size_t tmp = *(unaligned_word_t*)left;
+    *(unaligned_word_t*)left = *(unaligned_word_t*)right;
+    *(unaligned_word_t*)right = tmp;
   }
+  for (; len; --len, ++left, ++right)
+  {
+    uint8_t tmp = *left;
+    *left = *right;
+    *right = tmp;
+  }
+}
+
+const
+mem_routines_t mem_routines_word =
+{
+  .name = "word",
+  .set  = word_set,
+  .move = word_move,
+  .cmp  = word_cmp,
+  .swap = word_swap,
+};
+
+static const
+mem_routines_t* mem_routines = &mem_routines_word;
+
+#if defined(__i386__) || defined(__x86_64__)
+extern uint32_t x86_memory_routines(uint32_t features, const mem_routines_t** routines, uint32_t max_routines);
+#endif
+
+uint32_t supported_memory_routines(const mem_routines_t** routines, uint32_t max_routines)
+{
+  uint32_t count = 0;
+  if (count < max_routines)
+    routines[count++] = &mem_routines_word;
+
+#if defined(__i386__) || defined(__x86_64__)
+  module_t const* cpu_module = find_module_by_class(module_class::CPU_STATE);
+  cpu_state_vtable_t* cpu = cpu_module ? (cpu_state_vtable_t*)cpu_module->vtable : nullptr;
+  if (cpu && cpu->features)
+    count += x86_memory_routines(cpu->features(), routines + count, max_routines - count);
+#endif
+
+  return count;
+}
+
+void initialize_memory_routines()
+{
+  const mem_routines_t* routines[8];
+  uint32_t count = supported_memory_routines(routines, 8);
+  mem_routines = routines[count - 1];
+}
+
+const mem_routines_t& current_memory_routines()
+{
+  return *mem_routines;
+}
+
+void select_memory_routines(const mem_routines_t& routines)
+{
+  mem_routines = &routines;
+}
+
+void* mem_set(void* dst, int val, size_t len)
+{
+  if (len < MEM_DISPATCH_THRESHOLD)
+    return word_set(dst, val, len);
+  return mem_routines->set(dst, val, len);
+}
+
+void* mem_move(void* dst, const void* src, size_t len)
+{
+  if (len < MEM_DISPATCH_THRESHOLD)
+    return word_move(dst, src, len);
+  return mem_routines->move(dst, src, len);
+}
+
+void* mem_cpy(void* dst, const void* src, size_t len)
+{
+  return mem_move(dst, src, len);
+}
+
+int mem_cmp(const void* dst, const void* src, size_t len)
+{
+  if (len < MEM_DISPATCH_THRESHOLD)
+    return word_cmp(dst, src, len);
+  return mem_routines->cmp(dst, src, len);
+}
+
+void mem_swap(void* first, void* second, size_t len)
+{
+  if (len < MEM_DISPATCH_THRESHOLD)
+    return word_swap(first, second, len);
+  mem_routines->swap(first, second, len);
 }
 
 
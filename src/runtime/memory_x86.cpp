@@ -0,0 +1,248 @@
+/*
+  RTOS Runtime
+  Copyright (c) 2023, John Ryland
+  All rights reserved.
+*/
+
+#if defined(__i386__) || defined(__x86_64__)
+
+#include "runtime/memory.h"
+#include "module/cpu.h"
+
+// x86 versions of the memory routines, selected by initialize_memory_routines()
+// from the features the cpu module reports.
+
+// Using rep movs and rep stos a dword at a time
+
+static
+void* rep_set(void* dst, int val, size_t len)
+{
+  uint8_t* dstc = (uint8_t*)dst;
+  while (len && (size_t(dstc) & 3))
+  {
+    *dstc++ = val;
+    --len;
+  }
+  size_t words = len / 4;
+  size_t bytes = len % 4;
+  uint32_t pattern = uint8_t(val) * 0x01010101;
+  asm volatile ( "rep stosl\n\t"
+                 "mov %3, %1\n\t"
+                 "rep stosb"
+                 : "+D"(dstc), "+c"(words)
+                 : "a"(pattern), "r"(bytes)
+                 : "memory" );
+  return dst;
+}
+
+static
+void* rep_move(void* dst, const void* src, size_t len)
+{
+  uint8_t* dstc = (uint8_t*)dst;
+  const uint8_t* srcc = (const uint8_t*)src;
+  if (dstc == srcc || !len)
+    return dst;
+  size_t words = len / 4;
+  size_t bytes = len % 4;
+  if (dstc < srcc || dstc >= srcc + len)
+  {
+    asm volatile ( "rep movsl\n\t"
+                   "mov %3, %2\n\t"
+                   "rep movsb"
+                   : "+D"(dstc), "+S"(srcc), "+c"(words)
+                   : "r"(bytes)
+                   : "memory" );
+  }
+  else
+  {
+    // dst overlaps the end of src, so copy backwards with the direction flag
+    // set, the odd bytes at the end first and then the dwords before them
+    dstc += len - 1;
+    srcc += len - 1;
+    asm volatile ( "std\n\t"
+                   "rep movsb\n\t"
+                   "sub $3, %0\n\t"
+                   "sub $3, %1\n\t"
+                   "mov %3, %2\n\t"
+                   "rep movsl\n\t"
+                   "cld"
+                   : "+D"(dstc), "+S"(srcc), "+c"(bytes)
+                   : "r"(words)
+                   : "memory" );
+  }
+  return dst;
+}
+
+static const
+mem_routines_t mem_routines_rep =
+{
+  .name = "rep movs/stos",
+  .set  = rep_set,
+  .move = rep_move,
+  .cmp  = mem_routines_word.cmp,
+  .swap = mem_routines_word.swap,
+};
+
+// Using SSE2 and AVX2 registers
+//
+// These are written with the compiler's vector extensions, so the same
+// code is used for both with a different vector size, and the target
+// attribute lets the compiler use those instructions in just these
+// functions. No headers are needed, which the freestanding build lacks.
+
+// Attributes are dropped from template arguments, so the vector types
+// are passed in wrapped in a struct
+struct vec16_t { typedef uint64_t type __attribute__((vector_size(16), aligned(1), may_alias)); };
+struct vec32_t { typedef uint64_t type __attribute__((vector_size(32), aligned(1), may_alias)); };
+#define VECTOR_INLINE   static inline __attribute__((always_inline))
+
+template <typename Vec>
+VECTOR_INLINE
+void* vector_set(void* dst, int val, size_t len)
+{
+  typedef typename Vec::type V;
+  uint8_t* dstc = (uint8_t*)dst;
+  while (len && (size_t(dstc) & (sizeof(V) - 1)))
+  {
+    *dstc++ = val;
+    --len;
+  }
+  V pattern = V{} + uint64_t(uint8_t(val)) * 0x0101010101010101ULL;
+  for (; len >= sizeof(V); len -= sizeof(V), dstc += sizeof(V))
+    *(V*)dstc = pattern;
+  while (len--)
+    *dstc++ = val;
+  return dst;
+}
+
+// The same as word_move in memory.cpp, with each vector read before
+// it is written so that overlapping copies are still correct
+template <typename Vec>
+VECTOR_INLINE
+void* vector_move(void* dst, const void* src, size_t len)
+{
+  typedef typename Vec::type V;
+  uint8_t* dstc = (uint8_t*)dst;
+  const uint8_t* srcc = (const uint8_t*)src;
+  if (dstc == srcc || !len)
+    return dst;
+  if (dstc < srcc || dstc >= srcc + len)
+  {
+    while (len && (size_t(dstc) & (sizeof(V) - 1)))
+    {
+      *dstc++ = *srcc++;
+      --len;
+    }
+    for (; len >= 2 * sizeof(V); len -= 2 * sizeof(V), dstc += 2 * sizeof(V), srcc += 2 * sizeof(V))
+    {
+      V a = *(const V*)srcc;
+      V b = *(const V*)(srcc + sizeof(V));
+      *(V*)dstc = a;
+      *(V*)(dstc + sizeof(V)) = b;
+    }
+    for (; len >= sizeof(V); len -= sizeof(V), dstc += sizeof(V), srcc += sizeof(V))
+      *(V*)dstc = *(const V*)srcc;
+    while (len--)
+      *dstc++ = *srcc++;
+  }
+  else
+  {
+    dstc += len;
+    srcc += len;
+    while (len && (size_t(dstc) & (sizeof(V) - 1)))
+    {
+      *--dstc = *--srcc;
+      --len;
+    }
+    for (; len >= 2 * sizeof(V); len -= 2 * sizeof(V))
+    {
+      dstc -= 2 * sizeof(V);
+      srcc -= 2 * sizeof(V);
+      V b = *(const V*)(srcc + sizeof(V));
+      V a = *(const V*)srcc;
+      *(V*)(dstc + sizeof(V)) = b;
+      *(V*)dstc = a;
+    }
+    for (; len >= sizeof(V); len -= sizeof(V))
+    {
+      dstc -= sizeof(V);
+      srcc -= sizeof(V);
+      *(V*)dstc = *(const V*)srcc;
+    }
+    while (len--)
+      *--dstc = *--srcc;
+  }
+  return dst;
+}
+
+template <typename Vec>
+VECTOR_INLINE
+int vector_cmp(const void* dst, const void* src, size_t len)
+{
+  typedef typename Vec::type V;
+  if (dst == src || !len)
+    return 0;
+  const uint8_t* dstc = (const uint8_t*)dst;
+  const uint8_t* srcc = (const uint8_t*)src;
+  // skip the blocks which are the same, then the word version finds which byte differs
+  for (; len >= sizeof(V); len -= sizeof(V), dstc += sizeof(V), srcc += sizeof(V))
+  {
+    V diff = *(const V*)dstc ^ *(const V*)srcc;
+    uint64_t any = 0;
+    for (size_t i = 0; i < sizeof(V) / sizeof(uint64_t); ++i)
+      any |= diff[i];
+    if (any)
+      break;
+  }
+  return mem_routines_word.cmp(dstc, srcc, len);
+}
+
+template <typename Vec>
+VECTOR_INLINE
+void vector_swap(void* first, void* second, size_t len)
+{
+  typedef typename Vec::type V;
+  if (first == second || !len)
+    return;
+  uint8_t* left = (uint8_t*)first;
+  uint8_t* right = (uint8_t*)second;
+  for (; len >= sizeof(V); len -= sizeof(V), left += sizeof(V), right += sizeof(V))
+  {
+    V tmp = *(V*)left;
+    *(V*)left = *(V*)right;
+    *(V*)right = tmp;
+  }
+  mem_routines_word.swap(left, right, len);
+}
+
+#define VECTOR_ROUTINES(prefix, target_name, Vec) \
+  __attribute__((target(target_name))) static void* prefix##_set(void* dst, int val, size_t len) { return vector_set<Vec>(dst, val, len); } \
+  __attribute__((target(target_name))) static void* prefix##_move(void* dst, const void* src, size_t len) { return vector_move<Vec>(dst, src, len); } \
+  __attribute__((target(target_name))) static int prefix##_cmp(const void* dst, const void* src, size_t len) { return vector_cmp<Vec>(dst, src, len); } \
+  __attribute__((target(target_name))) static void prefix##_swap(void* first, void* second, size_t len) { vector_swap<Vec>(first, second, len); } \
+  static const mem_routines_t mem_routines_##prefix = \
+  { \
+    .name = target_name, \
+    .set  = prefix##_set, \
+    .move = prefix##_move, \
+    .cmp  = prefix##_cmp, \
+    .swap = prefix##_swap, \
+  };
+
+VECTOR_ROUTINES(sse2, "sse2", vec16_t)
+VECTOR_ROUTINES(avx2, "avx2", vec32_t)
+
+// Adds the routines the features allow, in order of expected speed
+uint32_t x86_memory_routines(uint32_t features, const mem_routines_t** routines, uint32_t max_routines)
+{
+  uint32_t count = 0;
+  if (count < max_routines)
+    routines[count++] = &mem_routines_rep;
+  if ((features & CPU_FEATURE_SSE2) && count < max_routines)
+    routines[count++] = &mem_routines_sse2;
+  if ((features & CPU_FEATURE_AVX2) && count < max_routines)
+    routines[count++] = &mem_routines_avx2;
+  return count;
+}
+
+#endif // defined(__i386__) || defined(__x86_64__)
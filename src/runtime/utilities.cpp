@@ -9,13 +9,16 @@
 //#include "conio.h"
 #include "utilities.h"
 #include "kernel/exception_handler.h"
+#include "kernel/replay.h"
 
 unsigned k_random(unsigned upper_bound)
 {
   if (!modules_initialized())
     k_critical_error(10, "Function unavailable until modules initialized\n");
   module_t const* random_module = find_module_by_class(module_class::RANDOM_DEVICE);
-  return ((random_device_vtable_t*)random_module->vtable)->random(0, upper_bound);
+  unsigned value = ((random_device_vtable_t*)random_module->vtable)->random(0, upper_bound);
+  replay_record_random(upper_bound, value);
+  return value;
 }
 
 typedef int (*compare_t)(const void *, const void *);
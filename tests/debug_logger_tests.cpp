@@ -0,0 +1,164 @@
+/*
+  Real-time Scheduler
+  Copyright (c) 2023, John Ryland
+  All rights reserved.
+*/
+
+#include "kernel_tests.h"
+#include "kernel/debug_logger.h"
+#include "kernel/module_manager.h"
+#include "module/serial.h"
+#include "module/text.h"
+#include "types/log_record.h"
+
+// a text display which counts the lines it is sent
+static unsigned lines = 0;
+
+static
+void count_lines(text_display_t*, uint8_t, char ch)
+{
+  if (ch == '\n')
+    lines++;
+}
+
+static
+void ignore_char(text_display_t*, uint8_t, char)
+{
+}
+
+static
+void ignore_goto_xy(text_display_t*, uint32_t, uint32_t)
+{
+}
+
+static text_display_vtable_t counting_display_vtable = { nullptr, nullptr, nullptr, ignore_goto_xy, count_lines, nullptr, nullptr, nullptr };
+static module_t counting_display = { module_class::TEXT_DISPLAY, 0, {}, nullptr, nullptr, &counting_display_vtable, nullptr };
+
+// Round and round the ring, each lap's entries must only be drained once
+static
+void test_ring_wraparound()
+{
+  for (unsigned i = 0; i < LOG_RING_SIZE * 3 + 5; i++)
+  {
+    k_log_deferred(DEBUG, "message %i\n", i);
+    if (i % 10 == 9)
+      k_log_drain();
+  }
+  k_log_drain();
+  TEST(lines == LOG_RING_SIZE * 3 + 5);
+  TEST(!k_log_pending());
+
+  lines = 0;
+  k_log_deferred(DEBUG, "one more\n");
+  TEST(k_log_drain() == 1);
+  TEST(lines == 1);
+  TEST(k_log_drain() == 0);
+  TEST(!k_log_pending());
+}
+
+// Filling the ring drops the rest, and it can be filled again once drained
+static
+void test_ring_full()
+{
+  lines = 0;
+  for (unsigned i = 0; i < LOG_RING_SIZE + 10; i++)
+    k_log_deferred(DEBUG, "message %i\n", i);
+  TEST(k_log_statistics().dropped == 10);
+  TEST(k_log_drain(LOG_RING_SIZE / 2) == LOG_RING_SIZE / 2);
+  TEST(k_log_drain() == LOG_RING_SIZE / 2);
+  TEST(!k_log_pending());
+  // the drops are reported on a line of their own, after a blank line
+  TEST(lines == LOG_RING_SIZE + 2);
+
+  for (unsigned lap = 0; lap < 3; lap++)
+  {
+    for (unsigned i = 0; i < LOG_RING_SIZE; i++)
+      k_log_deferred(DEBUG, "message %i\n", i);
+    TEST(k_log_drain() == LOG_RING_SIZE);
+  }
+  TEST(k_log_statistics().dropped == 0);
+  TEST(!k_log_pending());
+}
+
+// A critical message drains what is queued first, and returns
+static
+void test_critical_drains()
+{
+  lines = 0;
+  k_log_deferred(DEBUG, "queued\n");
+  k_log_deferred(CRITICAL, "critical\n");
+  TEST(lines == 2);
+  TEST(!k_log_pending());
+}
+
+static text_display_vtable_t silent_display_vtable = { nullptr, nullptr, nullptr, ignore_goto_xy, ignore_char, nullptr, nullptr, nullptr };
+static module_t silent_display = { module_class::TEXT_DISPLAY, 1, {}, nullptr, nullptr, &silent_display_vtable, nullptr };
+
+// A sink keeps its settings when modules registered later move it along the table
+static
+void test_sink_settings_kept()
+{
+  TEST(k_log_set_sink_level(&counting_display, WARNING));
+  module_register(silent_display);
+
+  const log_sink_t* sinks;
+  uint32_t count = k_log_sinks(&sinks);
+  TEST(count == 2);
+  TEST(sinks[0].module == &silent_display && sinks[0].min_level == TRACE);
+  TEST(sinks[1].module == &counting_display && sinks[1].min_level == WARNING);
+
+  lines = 0;
+  k_log_fmt(DEBUG, "filtered\n");
+  k_log_fmt(WARNING, "shown\n");
+  TEST(lines == 1);
+}
+
+// a serial port which keeps what it is sent
+static uint8_t sent[1024];
+static unsigned sent_length = 0;
+
+static
+void keep_byte(serial_driver_t*, uint8_t data)
+{
+  if (sent_length < sizeof(sent))
+    sent[sent_length++] = data;
+}
+
+static serial_driver_vtable_t keeping_serial_vtable = { nullptr, nullptr, nullptr, nullptr, nullptr, keep_byte };
+static module_t keeping_serial = { module_class::SERIAL_DRIVER, 2, {}, nullptr, nullptr, &keeping_serial_vtable, nullptr };
+
+// The arguments which don't fit in a binary record are left out whole, and
+// the record is marked as truncated
+static
+void test_binary_record_truncated()
+{
+  module_register(keeping_serial);
+  TEST(k_log_set_sink_binary(&keeping_serial, true));
+
+  const char* long_string = "0123456789012345678901234567890123456789012345678901234567890123";
+  sent_length = 0;
+  k_log_fmt(DEBUG, "%i %s %s %s %s %s\n", 7, long_string, long_string, long_string, long_string, long_string);
+  TEST(sent_length == LOG_RECORD_HEADER_SIZE + unsigned(sent[2]));
+  TEST(sent[0] == LOG_RECORD_SYNC);
+  TEST(sent[1] == (DEBUG | LOG_RECORD_TRUNCATED));
+  // the id, a tick of 0, the 7 and three of the strings, each of 64 and its length
+  TEST(sent[2] == 4 + 1 + 1 + 3 * 65);
+
+  sent_length = 0;
+  k_log_fmt(DEBUG, "%i %s\n", 7, long_string);
+  TEST(sent[1] == DEBUG);
+  TEST(sent[2] == 4 + 1 + 1 + 65);
+
+  TEST(k_log_set_sink_binary(&keeping_serial, false));
+}
+
+void run_debug_logger_tests()
+{
+  reset_test_modules();
+  module_register(counting_display);
+  test_ring_wraparound();
+  test_ring_full();
+  test_critical_drains();
+  test_sink_settings_kept();
+  test_binary_record_truncated();
+}
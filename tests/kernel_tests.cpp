@@ -0,0 +1,156 @@
+/*
+  Kernel Tests
+  Copyright (C) 2023, by John Ryland
+  All rights reserved.
+
+  Tests of the kernel's code which doesn't need the hardware, built for
+  the host with the hardware and the modules replaced by the fakes here.
+
+  Usage:
+
+    kernel_tests
+
+  Returns the number of tests which failed.
+*/
+
+#include "kernel_tests.h"
+#include "kernel/module_manager.h"
+#include "kernel/profiler.h"
+#include "module/perf_counters.h"
+#include "runtime/conio.h"
+#include "runtime/memory.h"
+
+#define timer_t posix_timer_t
+#include <cstdlib>
+#include <cstring>
+#undef timer_t
+
+static int failures = 0;
+static tick_t tick = 0;
+static module_t* module_heads[size_t(module_class::DRIVER_CLASS_COUNT)];
+static uint32_t generation = 0;
+
+
+void test_failed(const char* test)
+{
+  printf("FAILED test of %s\n", test);
+  failures++;
+}
+
+// The timer
+
+tick_t current_tick()
+{
+  return tick;
+}
+
+void set_current_tick(tick_t new_tick)
+{
+  tick = new_tick;
+}
+
+uint32_t timer_frequency()
+{
+  return 1000;
+}
+
+uint64_t monotonic_ns()
+{
+  return tick * 1000000;
+}
+
+// The modules, registered the same way as by the module manager
+
+bool modules_initialized()
+{
+  return true;
+}
+
+uint32_t modules_generation()
+{
+  return generation;
+}
+
+void module_register(module_t& driver)
+{
+  driver.next = module_heads[size_t(driver.type)];
+  module_heads[size_t(driver.type)] = &driver;
+  generation++;
+}
+
+module_t const* find_module_by_class(module_class driver_type)
+{
+  return module_heads[size_t(driver_type)];
+}
+
+void reset_test_modules()
+{
+  for (module_t*& head : module_heads)
+    head = nullptr;
+  generation++;
+}
+
+// The runtime
+
+void* mem_set(void* dst, int val, size_t len)
+{
+  return memset(dst, val, len);
+}
+
+void* mem_move(void* dst, const void* src, size_t len)
+{
+  return memmove(dst, src, len);
+}
+
+void* mem_cpy(void* dst, const void* src, size_t len)
+{
+  return memmove(dst, src, len);
+}
+
+int mem_cmp(const void* dst, const void* src, size_t len)
+{
+  return memcmp(dst, src, len);
+}
+
+// The tasks' statistics aren't drawn or measured
+
+void gotoxy(unsigned, unsigned)
+{
+}
+
+void print_str_int(const char*, int)
+{
+}
+
+void profiler_task_started()
+{
+}
+
+void profiler_task_finished()
+{
+}
+
+void read_perf_counters(perf_sample_t&)
+{
+}
+
+void account_perf_counters(const task_t*, const perf_sample_t&)
+{
+}
+
+void k_critical_error(int code, const char* message, ...)
+{
+  printf("critical error %i: %s\n", code, message);
+  abort();
+}
+
+int main()
+{
+  run_debug_logger_tests();
+  run_mode_manager_tests();
+  run_replay_tests();
+  run_schedule_tests();
+  if (failures)
+    printf("%i tests failed\n", failures);
+  return failures;
+}
@@ -0,0 +1,39 @@
+/*
+  Real-time Scheduler
+  Copyright (c) 2023, John Ryland
+  All rights reserved.
+*/
+
+#pragma once
+
+// included first, as its integer types are used in place of the system's
+#include "types.h"
+
+// the POSIX timer_t would conflict with the kernel's
+#define timer_t posix_timer_t
+#include <cstdio>
+#undef timer_t
+
+// Each test is run and reported the same way as in the string tests, but
+// a failure is counted instead of stopping, so the rest still run
+#define TEST(x) \
+  do { \
+    puts("running test of " #x); \
+    if (x) \
+      puts("passed test of " #x); \
+    else \
+      test_failed(#x); \
+  } while (0)
+
+void test_failed(const char* test);
+
+// the tick the kernel sees, which only moves when it is set
+void set_current_tick(tick_t tick);
+
+// clears the registered modules, to register fakes with module_register()
+void reset_test_modules();
+
+void run_debug_logger_tests();
+void run_mode_manager_tests();
+void run_replay_tests();
+void run_schedule_tests();
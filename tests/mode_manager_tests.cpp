@@ -0,0 +1,155 @@
+/*
+  Real-time Scheduler
+  Copyright (c) 2023, John Ryland
+  All rights reserved.
+*/
+
+#include "kernel_tests.h"
+#include "kernel/elastic.h"
+#include "kernel/mode_manager.h"
+#include "kernel/task_manager.h"
+
+static
+void mode_task()
+{
+}
+
+static
+void reset_schedule(tick_t start)
+{
+  set_current_tick(start);
+  set_elastic_scheduling(false);
+  initialize_tasks();
+  initialize_scheduler();
+  initialize_modes();
+}
+
+static
+mode_task_t periodic(id_t task_name, ticks_t exec_bound, ticks_t period)
+{
+  return { mode_task, task_name, 0, exec_bound, period, "mode task", 0, 0 };
+}
+
+// The tasks outside of the modes count against a mode, and a change which
+// doesn't fit leaves everything as it was
+static
+void test_resident_tasks_checked()
+{
+  reset_schedule(1);
+  TEST(request_to_add_task(mode_task, 100, 0, 0, 50, 0, 100, "resident", 0, 0) == accepted);
+
+  mode_task_t heavy[] = { periodic(1, 30, 100), periodic(2, 30, 100) };
+  unsigned heavy_mode = NO_MODE;
+  TEST(define_mode("heavy", heavy, 2, heavy_mode) == accepted);
+
+  unsigned items = get_items_in_scheduled_item_list();
+  tick_t release_at = 0;
+  TEST(request_mode_change(heavy_mode, mode_change_protocol::IDLE_TIME, release_at) == can_not_be_scheduled_with_the_other_tasks);
+  TEST(current_mode() == NO_MODE);
+  TEST(search_for_task_in_schedule(1) == nullptr);
+  TEST(get_items_in_scheduled_item_list() == items);
+
+  mode_task_t light[] = { periodic(1, 20, 100) };
+  unsigned light_mode = NO_MODE;
+  TEST(define_mode("light", light, 1, light_mode) == accepted);
+  TEST(request_mode_change(light_mode, mode_change_protocol::IDLE_TIME, release_at) == accepted);
+  TEST(current_mode() == light_mode);
+  TEST(release_at == 1);
+  TEST(search_for_task_in_schedule(1) != nullptr);
+}
+
+// A task can't be added to the new mode while the old one of its name is
+// still finishing its jobs
+static
+void test_name_in_use()
+{
+  reset_schedule(1);
+  mode_task_t slow[] = { periodic(1, 10, 100) };
+  mode_task_t fast[] = { periodic(1, 5, 50) };
+  unsigned slow_mode = NO_MODE;
+  unsigned fast_mode = NO_MODE;
+  TEST(define_mode("slow", slow, 1, slow_mode) == accepted);
+  TEST(define_mode("fast", fast, 1, fast_mode) == accepted);
+
+  tick_t release_at = 0;
+  TEST(request_mode_change(slow_mode, mode_change_protocol::IDLE_TIME, release_at) == accepted);
+  task_t* task = search_for_task_in_schedule(1);
+  TEST(request_mode_change(fast_mode, mode_change_protocol::IDLE_TIME, release_at) == task_name_in_use);
+  TEST(current_mode() == slow_mode);
+  TEST(search_for_task_in_schedule(1) == task);
+  TEST(task->complete_not_after == 0);
+}
+
+// When adding a new task fails part way through, the tasks already added
+// are taken out and the old mode's tasks carry on
+static
+void test_rollback()
+{
+  reset_schedule(1);
+  mode_task_t first[] = { periodic(1, 50, 100) };
+  // the new tasks are admitted while the old one's jobs are still pending,
+  // which doesn't leave enough room for the elastic scheduling to admit 3
+  mode_task_t second[] = { periodic(2, 1, 100), periodic(3, 50, 100) };
+  unsigned first_mode = NO_MODE;
+  unsigned second_mode = NO_MODE;
+  TEST(define_mode("first", first, 1, first_mode) == accepted);
+  TEST(define_mode("second", second, 2, second_mode) == accepted);
+
+  tick_t release_at = 0;
+  TEST(request_mode_change(first_mode, mode_change_protocol::IDLE_TIME, release_at) == accepted);
+  task_t* task = search_for_task_in_schedule(1);
+  unsigned items = get_items_in_scheduled_item_list();
+  unsigned pending_jobs = task->pending_jobs;
+  tick_t time_evaluated_upto = task->time_evaluated_upto;
+
+  set_elastic_scheduling(true);
+  TEST(request_mode_change(second_mode, mode_change_protocol::IDLE_TIME, release_at) == can_not_be_scheduled_with_the_other_tasks);
+  TEST(current_mode() == first_mode);
+  TEST(search_for_task_in_schedule(2) == nullptr);
+  TEST(search_for_task_in_schedule(3) == nullptr);
+  TEST(search_for_task_in_schedule(1) == task);
+  TEST(task->complete_not_after == 0);
+  TEST(task->pending_jobs == pending_jobs);
+  TEST(task->time_evaluated_upto == time_evaluated_upto);
+  TEST(get_items_in_scheduled_item_list() == items);
+  set_elastic_scheduling(false);
+}
+
+// The new tasks are released after the old ones' jobs, even where that is
+// past where the ticks wrap around
+static
+void test_release_wraps()
+{
+  tick_t start = ~tick_t(0) - 20;
+  reset_schedule(start);
+  mode_task_t first[] = { periodic(1, 10, 100) };
+  mode_task_t second[] = { periodic(2, 10, 100) };
+  unsigned first_mode = NO_MODE;
+  unsigned second_mode = NO_MODE;
+  TEST(define_mode("first", first, 1, first_mode) == accepted);
+  TEST(define_mode("second", second, 1, second_mode) == accepted);
+
+  tick_t release_at = 0;
+  TEST(request_mode_change(first_mode, mode_change_protocol::IDLE_TIME, release_at) == accepted);
+  set_current_tick(start + 10);
+  TEST(request_mode_change(second_mode, mode_change_protocol::MAX_PERIOD_OFFSET, release_at) == accepted);
+  TEST(release_at == start + 110);
+  TEST(search_for_task_in_schedule(2)->start_not_before == start + 110);
+
+  // the first job of the old task is due at start + 100, after the wrap
+  reset_schedule(start);
+  TEST(define_mode("first", first, 1, first_mode) == accepted);
+  TEST(define_mode("second", second, 1, second_mode) == accepted);
+  TEST(request_mode_change(first_mode, mode_change_protocol::IDLE_TIME, release_at) == accepted);
+  set_current_tick(start + 10);
+  TEST(request_mode_change(second_mode, mode_change_protocol::IDLE_TIME, release_at) == accepted);
+  TEST(release_at == start + 100);
+}
+
+void run_mode_manager_tests()
+{
+  test_resident_tasks_checked();
+  test_name_in_use();
+  test_rollback();
+  test_release_wraps();
+}
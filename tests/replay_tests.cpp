@@ -0,0 +1,160 @@
+/*
+  Real-time Scheduler
+  Copyright (c) 2023, John Ryland
+  All rights reserved.
+*/
+
+#include "kernel_tests.h"
+#include "kernel/mode_manager.h"
+#include "kernel/replay.h"
+#include "kernel/task_manager.h"
+
+#define timer_t posix_timer_t
+#include <cstring>
+#undef timer_t
+
+#define RECORDING_TICKS   5000
+
+// the recording is kept here, and read back in small pieces
+static uint8_t recording[1 << 16];
+static uint32_t recording_size = 0;
+static uint32_t recording_read = 0;
+
+static
+void write_recording(const void* data, uint32_t size, void*)
+{
+  memcpy(recording + recording_size, data, size);
+  recording_size += size;
+}
+
+static
+uint32_t read_recording(void* data, uint32_t size, void*)
+{
+  uint32_t left = recording_size - recording_read;
+  if (size > left)
+    size = left;
+  if (size > 100)
+    size = 100;
+  memcpy(data, recording + recording_read, size);
+  recording_read += size;
+  return size;
+}
+
+static
+void run_for(ticks_t ticks)
+{
+  set_current_tick(current_tick() + ticks);
+}
+
+static
+void short_task()
+{
+  run_for(3);
+}
+
+static
+void long_task()
+{
+  run_for(8);
+}
+
+static unsigned normal_mode = NO_MODE;
+static unsigned degraded_mode = NO_MODE;
+static acceptance_codes mode_change_result = schedule_full;
+static tick_t ended_by = 0;
+
+// changes mode the first time, then tries changing to a mode which isn't
+// defined and ends the resident task
+static
+void controller_task()
+{
+  static unsigned runs = 0;
+  run_for(2);
+  tick_t release_at;
+  if (runs == 0)
+    mode_change_result = request_mode_change(degraded_mode, mode_change_protocol::IDLE_TIME, release_at);
+  if (runs == 1)
+    request_mode_change(MAX_MODES, mode_change_protocol::IDLE_TIME, release_at);
+  if (runs == 2)
+    ended_by = end_task_at(search_for_task_in_schedule(20), current_tick());
+  runs++;
+}
+
+static
+void define_modes()
+{
+  static const mode_task_t normal_tasks[] =
+  {
+    { short_task, 1, 0,  3, 100, "short",  0, 0 },
+    { long_task,  2, 0,  8, 150, "long",   0, 0 },
+  };
+  static const mode_task_t degraded_tasks[] =
+  {
+    { short_task, 1, 0,  3, 100, "short",  0, 0 },
+    { long_task,  3, 0,  8, 300, "slower", 0, 0 },
+  };
+  initialize_modes();
+  define_mode("normal", normal_tasks, 2, normal_mode);
+  define_mode("degraded", degraded_tasks, 2, degraded_mode);
+}
+
+static
+unsigned record_run()
+{
+  set_current_tick(100);
+  initialize_tasks();
+  initialize_scheduler();
+  define_modes();
+  recording_size = 0;
+  replay_start_recording(write_recording, nullptr);
+
+  tick_t release_at;
+  request_to_add_task(online_scheduler, 10, 0, 0, 5, 0, UPDATE_SCHEDULE_RATE - 1, "Online Scheduler", 0, 0);
+  request_to_add_task(controller_task, 11, 0, 0, 2, 0, 700, "controller", 0, 0);
+  request_to_add_task(short_task, 20, 0, 0, 3, 0, 250, "resident", 0, 0);
+  request_mode_change(normal_mode, mode_change_protocol::IDLE_TIME, release_at);
+
+  unsigned dispatches = 0;
+  for (get_item_upto() = 0; get_item_upto() < get_items_in_scheduled_item_list() && current_tick() < RECORDING_TICKS; get_item_upto()++)
+  {
+    scheduled_item_t* item = &get_scheduled_item_list()[get_item_upto()];
+    if (tick_before(current_tick(), item->start_not_before))
+      set_current_tick(item->start_not_before);
+    run_scheduled_item(item);
+    dispatches++;
+  }
+  replay_stop_recording();
+  return dispatches;
+}
+
+// A run with mode changes replays to the same dispatches, with the modes
+// defined again before replaying
+static
+void test_replay_mode_change()
+{
+  unsigned dispatches = record_run();
+  TEST(mode_change_result == accepted);
+  TEST(current_mode() == degraded_mode);
+  TEST(ended_by != 0);
+
+  set_current_tick(0);
+  initialize_tasks();
+  initialize_scheduler();
+  define_modes();
+  recording_read = 0;
+  replay_result_t result;
+  TEST(replay_schedule(read_recording, nullptr, result));
+  TEST(!result.diverged);
+  TEST(result.dispatches == dispatches);
+  // the three tasks added, the three mode changes and the end of the resident task
+  TEST(result.requests == 7);
+  TEST(current_mode() == degraded_mode);
+  // the new mode's task is replaced like the others
+  task_t* slower = search_for_task_in_schedule(3);
+  TEST(slower != nullptr && slower->func_ptr != long_task);
+}
+
+void run_replay_tests()
+{
+  test_replay_mode_change();
+}
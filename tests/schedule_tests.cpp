@@ -0,0 +1,100 @@
+/*
+  Real-time Scheduler
+  Copyright (c) 2023, John Ryland
+  All rights reserved.
+*/
+
+#include "kernel_tests.h"
+#include "kernel/elastic.h"
+#include "kernel/schedule.h"
+#include "kernel/task_manager.h"
+
+static
+void short_task()
+{
+  set_current_tick(current_tick() + 1);
+}
+
+// runs the schedule as the run loop does, until the tick
+static
+void run_until(tick_t end)
+{
+  for (unsigned& upto = get_item_upto(); upto < get_items_in_scheduled_item_list(); upto++)
+  {
+    scheduled_item_t* item = &get_scheduled_item_list()[upto];
+    tick_t start = tick_before(current_tick(), item->start_not_before) ? item->start_not_before : current_tick();
+    if (!tick_before(start, end))
+    {
+      set_current_tick(end);
+      return;
+    }
+    set_current_tick(start);
+    run_scheduled_item(item);
+  }
+}
+
+// A short period task added once the rate has grown long gets all of its
+// jobs, as the online scheduler's next run is brought forward
+static
+void test_rate_shortened()
+{
+  set_current_tick(1);
+  initialize_tasks();
+  initialize_scheduler();
+  TEST(request_to_add_task(online_scheduler, 10, 0, 0, 5, 0, UPDATE_SCHEDULE_RATE - 1, "Online Scheduler", 0, 0) == accepted);
+  TEST(request_to_add_task(short_task, 1, 0, 0, 1, 0, 20000, "slow", 0, 0) == accepted);
+  ticks_t long_rate = schedule_update_rate();
+  run_until(3000);
+
+  TEST(request_to_add_task(short_task, 2, 0, 0, 1, 0, 10, "fast", 0, 0) == accepted);
+  TEST(schedule_update_rate() < long_rate);
+  run_until(13000);
+  // 1000 periods, less the one which might be running at the end
+  TEST(search_for_task_in_schedule(2)->times_called >= 999);
+  TEST(search_for_task_in_schedule(2)->deadline_failures == 0);
+}
+
+// Updating a task goes through the elastic model, as adding one does
+static
+void test_update_elastic()
+{
+  set_current_tick(1);
+  set_elastic_scheduling(true);
+  initialize_tasks();
+  initialize_scheduler();
+  TEST(request_to_add_task(short_task, 1, 0, 0, 50, 0, 100, "rigid", 0, 0) == accepted);
+  TEST(request_to_add_elastic_task(short_task, 2, 0, 20, 100, 400, 1, "elastic", 0, 0) == accepted);
+  task_t* rigid = search_for_task_in_schedule(1);
+  task_t* elastic = search_for_task_in_schedule(2);
+  TEST(elastic->period == 100);
+
+  // a longer exec_bound stretches the elastic task to make room
+  TEST(request_update_task(1, 100, 80, 0) == accepted);
+  TEST(rigid->exec_bound == 80);
+  TEST(elastic->period > 100 && elastic->period <= 400);
+
+  // and one which doesn't fit even with it stretched all the way is turned away
+  ticks_t stretched = elastic->period;
+  TEST(request_update_task(1, 100, 95, 0) == can_not_be_scheduled_with_the_other_tasks);
+  TEST(rigid->exec_bound == 80);
+  TEST(elastic->period == stretched);
+
+  // the elastic task's period is the one it would like, within its range
+  TEST(request_update_task(2, 500, 20, 0) == bound_gt_period);
+  TEST(request_update_task(2, 200, 250, 0) == bound_gt_period);
+  TEST(request_update_task(2, 200, 20, 0) == accepted);
+  TEST(elastic->min_period == 200);
+  TEST(elastic->max_period == 400);
+  TEST(elastic->period >= 200 && elastic->period <= 400);
+
+  // taking the load off gives the elastic task its period back
+  TEST(request_update_task(1, 100, 10, 0) == accepted);
+  TEST(elastic->period == 200);
+  set_elastic_scheduling(false);
+}
+
+void run_schedule_tests()
+{
+  test_rate_shortened();
+  test_update_elastic();
+}
@@ -0,0 +1,380 @@
+/*
+  Binary Log Tool
+  Copyright (C) 2023, by John Ryland
+  All rights reserved.
+
+  Tool for the binary logging mode of the kernel's debug logger.
+  It can scan the sources for the log format strings to produce
+  a dictionary of format IDs, and decode the binary log records
+  captured from the serial port back in to text using it.
+
+  Usage:
+
+    binary_log formats <source files...> > formats.txt
+    binary_log decode [-t] formats.txt < capture.bin
+*/
+
+// included first, as its integer types are used in place of the system's
+#include "types/log_record.h"
+
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <map>
+#include <cstdio>
+#include <cstring>
+
+// the functions which take a format, k_dbg is a template so may be followed by its arguments
+static const char* log_functions[] = { "k_log_fmt", "k_log_deferred", "k_log_deferred_xy", "k_critical_error", "k_dbg" };
+
+static const char* level_names[] = { "TRACE", "DEBUG", "NORMAL", "SUCCESS", "WARNING", "ERROR", "CRITICAL" };
+
+static
+int hex_digit(char ch)
+{
+  if (ch >= '0' && ch <= '9') return ch - '0';
+  if (ch >= 'a' && ch <= 'f') return ch - 'a' + 10;
+  if (ch >= 'A' && ch <= 'F') return ch - 'A' + 10;
+  return -1;
+}
+
+// Parses a C string literal starting at the opening quote, appending the
+// characters it represents to str, returning the position after the literal
+static
+size_t parse_literal(const std::string& src, size_t pos, std::string& str)
+{
+  ++pos; // skip "
+  while (pos < src.size() && src[pos] != '"')
+  {
+    char ch = src[pos++];
+    if (ch != '\\' || pos >= src.size())
+    {
+      str += ch;
+      continue;
+    }
+    ch = src[pos++];
+    switch (ch)
+    {
+      case 'n': str += '\n'; break;
+      case 't': str += '\t'; break;
+      case 'r': str += '\r'; break;
+      case 'a': str += '\a'; break;
+      case 'b': str += '\b'; break;
+      case 'f': str += '\f'; break;
+      case 'v': str += '\v'; break;
+      case 'x':
+      {
+        int value = 0;
+        while (pos < src.size() && hex_digit(src[pos]) >= 0)
+          value = value * 16 + hex_digit(src[pos++]);
+        str += char(value);
+        break;
+      }
+      default:
+        if (ch >= '0' && ch <= '7')
+        {
+          int value = ch - '0';
+          for (int i = 0; i < 2 && pos < src.size() && src[pos] >= '0' && src[pos] <= '7'; ++i)
+            value = value * 8 + (src[pos++] - '0');
+          str += char(value);
+        }
+        else
+        {
+          str += ch; // \\ \" \' \?
+        }
+        break;
+    }
+  }
+  return pos + 1;
+}
+
+// Finds the format string literal of a logging call, which is the first
+// string literal in the arguments. Adjacent literals are joined. Returns
+// false if there isn't one, such as when the format is a variable.
+static
+bool find_format(const std::string& src, size_t pos, std::string& fmt)
+{
+  int depth = 0;
+  while (pos < src.size())
+  {
+    char ch = src[pos];
+    if (ch == '(')
+      ++depth;
+    else if (ch == ')' && --depth == 0)
+      return false;
+    else if (ch == '"')
+    {
+      while (pos < src.size() && src[pos] == '"')
+      {
+        pos = parse_literal(src, pos, fmt);
+        while (pos < src.size() && isspace(static_cast<unsigned char>(src[pos])))
+          ++pos;
+      }
+      return true;
+    }
+    ++pos;
+  }
+  return false;
+}
+
+static
+std::string escape(const std::string& str)
+{
+  std::string out;
+  char buf[8];
+  for (unsigned char ch : str)
+  {
+    if (ch == '\\')
+      out += "\\\\";
+    else if (ch == '\n')
+      out += "\\n";
+    else if (ch < ' ' || ch >= 0x7F)
+    {
+      snprintf(buf, sizeof(buf), "\\x%02x", ch);
+      out += buf;
+    }
+    else
+      out += char(ch);
+  }
+  return out;
+}
+
+static
+std::string unescape(const std::string& str)
+{
+  std::string out;
+  for (size_t i = 0; i < str.size(); ++i)
+  {
+    if (str[i] != '\\' || i + 1 >= str.size())
+    {
+      out += str[i];
+      continue;
+    }
+    char ch = str[++i];
+    if (ch == 'n')
+      out += '\n';
+    else if (ch == 'x' && i + 2 < str.size())
+    {
+      out += char(hex_digit(str[i + 1]) * 16 + hex_digit(str[i + 2]));
+      i += 2;
+    }
+    else
+      out += ch;
+  }
+  return out;
+}
+
+static
+int generate_formats(int argc, char* argv[])
+{
+  std::map<uint32_t, std::string> formats;
+  int result = 0;
+  for (int i = 0; i < argc; ++i)
+  {
+    std::ifstream file(argv[i]);
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    std::string src = buffer.str();
+
+    for (const char* function : log_functions)
+    {
+      std::string name = function;
+      for (size_t pos = src.find(name); pos != std::string::npos; pos = src.find(name, pos + 1))
+      {
+        // must not be the tail of another identifier, eg: k_log_fmt( vs my_k_log_fmt(
+        if (pos && (isalnum(static_cast<unsigned char>(src[pos - 1])) || src[pos - 1] == '_'))
+          continue;
+        size_t args = pos + name.size();
+        if (args < src.size() && src[args] == '<')
+          args = src.find('>', args) + 1;
+        // nor the start of a longer one, eg: k_log_deferred( vs k_log_deferred_xy(
+        if (!args || args >= src.size() || src[args] != '(')
+          continue;
+        std::string fmt;
+        if (!find_format(src, args, fmt))
+          continue;
+        uint32_t id = log_format_id(fmt.c_str());
+        auto existing = formats.find(id);
+        if (existing != formats.end() && existing->second != fmt)
+        {
+          fprintf(stderr, "format id collision 0x%08x: \"%s\" and \"%s\"\n", id,
+                  escape(existing->second).c_str(), escape(fmt).c_str());
+          result = 1;
+        }
+        formats[id] = fmt;
+      }
+    }
+  }
+
+  for (auto& format : formats)
+    printf("%08x %s\n", format.first, escape(format.second).c_str());
+  return result;
+}
+
+// Reads the records from a buffer
+struct record_reader
+{
+  const uint8_t* data;
+  size_t         length;
+  size_t         pos;
+
+  bool    more() const { return pos < length; }
+  uint8_t byte()       { return more() ? data[pos++] : 0; }
+
+  uint64_t varint()
+  {
+    uint64_t value = 0;
+    for (int shift = 0; more() && shift < 64; shift += 7)
+    {
+      uint8_t b = byte();
+      value |= uint64_t(b & 0x7F) << shift;
+      if (!(b & 0x80))
+        break;
+    }
+    return value;
+  }
+};
+
+// The same translation of the old DOS code-page line drawing characters as the serial output
+static
+void output_char(std::string& out, char ch1)
+{
+  unsigned char ch = static_cast<unsigned char>(ch1);
+  const char* charLUT = "│┤╡╢╖╕╣║╗╝╜╛┐└┴┬├─┼╞╟╚╔╩╦╠═╬╧╨╤╥╙╘╒╓╫╪┘┌";
+  if (ch >= 0xB3 && ch <= 0xDA)
+    out.append(&charLUT[(ch - 0xB3) * 3], 3);
+  else if (ch == 0xDB)
+    out += "▇";
+  else
+    out += ch1;
+}
+
+// the arguments of a truncated record stop short, where the rest of the
+// message is left out
+static
+std::string decode_message(const std::string& fmt, record_reader& args, bool truncated)
+{
+  std::string out;
+  char buf[32];
+  for (size_t i = 0; i < fmt.size(); ++i)
+  {
+    if (fmt[i] != '%' || i + 1 >= fmt.size())
+    {
+      output_char(out, fmt[i]);
+      continue;
+    }
+    if (truncated && !args.more() && fmt[i + 1] != '%')
+      return out + "<truncated>\n";
+    switch (fmt[++i])
+    {
+      case 'd':
+      case 'i':
+      {
+        uint32_t zigzag = uint32_t(args.varint());
+        snprintf(buf, sizeof(buf), "%d", int32_t((zigzag >> 1) ^ (0 - (zigzag & 1))));
+        out += buf;
+        break;
+      }
+      case 'x': snprintf(buf, sizeof(buf), "%08X", unsigned(args.varint())); out += buf; break;
+      case 'X': snprintf(buf, sizeof(buf), "%016llX", (unsigned long long)args.varint()); out += buf; break;
+      case 'c': output_char(out, char(args.byte())); break;
+      case 's':
+      {
+        uint8_t length = args.byte();
+        for (uint8_t j = 0; j < length; ++j)
+          output_char(out, char(args.byte()));
+        break;
+      }
+      case 'f':
+      {
+        uint64_t bits = 0;
+        for (int j = 0; j < 8; ++j)
+          bits |= uint64_t(args.byte()) << (j * 8);
+        double value;
+        memcpy(&value, &bits, sizeof(value));
+        snprintf(buf, sizeof(buf), "%g", value);
+        out += buf;
+        break;
+      }
+      case '%': out += '%'; break;
+      default:  out += '%'; out += fmt[i]; break;
+    }
+  }
+  return out;
+}
+
+static
+int decode(int argc, char* argv[])
+{
+  bool timestamps = false;
+  if (argc && !strcmp(argv[0], "-t"))
+  {
+    timestamps = true;
+    --argc;
+    ++argv;
+  }
+  if (argc != 1)
+  {
+    fprintf(stderr, "decode needs the formats file\n");
+    return 1;
+  }
+
+  std::map<uint32_t, std::string> formats;
+  std::ifstream dictionary(argv[0]);
+  std::string line;
+  while (std::getline(dictionary, line))
+    if (line.size() > 9)
+      formats[uint32_t(strtoul(line.substr(0, 8).c_str(), nullptr, 16))] = unescape(line.substr(9));
+
+  std::string input((std::istreambuf_iterator<char>(std::cin)), std::istreambuf_iterator<char>());
+  const uint8_t* data = reinterpret_cast<const uint8_t*>(input.data());
+  size_t skipped = 0;
+  size_t pos = 0;
+  while (pos + LOG_RECORD_HEADER_SIZE <= input.size())
+  {
+    // anything else sent on the serial port before or between records is skipped
+    if (data[pos] != LOG_RECORD_SYNC || pos + LOG_RECORD_HEADER_SIZE + data[pos + 2] > input.size())
+    {
+      ++pos;
+      ++skipped;
+      continue;
+    }
+
+    uint8_t level = data[pos + 1] & ~LOG_RECORD_TRUNCATED;
+    bool truncated = data[pos + 1] & LOG_RECORD_TRUNCATED;
+    record_reader record = { data + pos + LOG_RECORD_HEADER_SIZE, data[pos + 2], 0 };
+    pos += LOG_RECORD_HEADER_SIZE + data[pos + 2];
+
+    uint32_t id = 0;
+    for (int i = 0; i < 4; ++i)
+      id |= uint32_t(record.byte()) << (i * 8);
+    uint64_t tick = record.varint();
+
+    if (timestamps)
+      printf("[%10llu %-8s] ", (unsigned long long)tick, level < 7 ? level_names[level] : "?");
+
+    auto format = formats.find(id);
+    if (format == formats.end())
+      printf("<unknown format id %08x, %u bytes of arguments%s>\n", id, unsigned(record.length - record.pos),
+             truncated ? ", truncated" : "");
+    else
+      printf("%s", decode_message(format->second, record, truncated).c_str());
+  }
+
+  if (skipped)
+    fprintf(stderr, "%zu bytes were not part of a record\n", skipped);
+  return 0;
+}
+
+int main(int argc, char* argv[])
+{
+  if (argc >= 2 && !strcmp(argv[1], "formats"))
+    return generate_formats(argc - 2, argv + 2);
+  if (argc >= 2 && !strcmp(argv[1], "decode"))
+    return decode(argc - 2, argv + 2);
+  fprintf(stderr, "usage: %s formats <source files...> > formats.txt\n", argv[0]);
+  fprintf(stderr, "       %s decode [-t] formats.txt < capture.bin\n", argv[0]);
+  return 1;
+}
@@ -0,0 +1,162 @@
+/*
+  Sensitivity Analysis Tool
+  Copyright (C) 2023, by John Ryland
+  All rights reserved.
+
+  Tool for capacity planning of a set of periodic tasks. It runs the same
+  EDF analysis as the kernel on a task set described in a file, and reports
+  whether the set is schedulable, the critical scaling factor, and for each
+  task how large its exec_bound could be with the other tasks as they are.
+  The analysis of each task is independent, so they are shared out across
+  threads.
+
+  Usage:
+
+    sensitivity [-j threads] [task set file]
+
+  Each line of the task set is a task, as its name, exec_bound, period and
+  optionally its deadline, which is the period if not given. Blank lines
+  and anything after a # are ignored, eg:
+
+    # name      exec_bound  period  deadline
+    sensor      20          100
+    control     150         500     400
+*/
+
+// included first, as its integer types are used in place of the system's
+#include "kernel/edf_analysis.h"
+
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+struct task_entry
+{
+  std::string  name;
+  edf_task_t   params;
+  ticks_t      allowable_exec_bound;
+};
+
+static
+bool read_tasks(std::istream& in, std::vector<task_entry>& tasks)
+{
+  std::string line;
+  for (unsigned line_number = 1; std::getline(in, line); ++line_number)
+  {
+    line = line.substr(0, line.find('#'));
+    std::istringstream fields(line);
+    task_entry task;
+    unsigned long exec_bound, period, deadline;
+    if (!(fields >> task.name))
+      continue;
+    if (!(fields >> exec_bound >> period) || period == 0)
+    {
+      fprintf(stderr, "line %u: expected name, exec_bound, period and optionally a deadline\n", line_number);
+      return false;
+    }
+    if (!(fields >> deadline))
+      deadline = period;
+    if (deadline == 0 || deadline > period)
+    {
+      fprintf(stderr, "line %u: the deadline needs to be from 1 up to the period\n", line_number);
+      return false;
+    }
+    if (period > 0xFFFFFFFFUL || exec_bound > 0xFFFFFFFFUL)
+    {
+      fprintf(stderr, "line %u: the times need to fit in 32 bits\n", line_number);
+      return false;
+    }
+    task.params = { uint32_t(exec_bound), uint32_t(period), uint32_t(deadline) };
+    task.allowable_exec_bound = 0;
+    tasks.push_back(task);
+  }
+  return true;
+}
+
+int main(int argc, char* argv[])
+{
+  unsigned threads = std::thread::hardware_concurrency();
+  int arg = 1;
+  if (arg + 1 < argc && !strcmp(argv[arg], "-j"))
+  {
+    threads = unsigned(strtoul(argv[arg + 1], nullptr, 10));
+    arg += 2;
+  }
+  if (argc - arg > 1 || (arg < argc && argv[arg][0] == '-'))
+  {
+    fprintf(stderr, "usage: %s [-j threads] [task set file]\n", argv[0]);
+    return 1;
+  }
+
+  std::vector<task_entry> tasks;
+  bool read;
+  if (arg < argc)
+  {
+    std::ifstream file(argv[arg]);
+    if (!file)
+    {
+      fprintf(stderr, "can't open %s\n", argv[arg]);
+      return 1;
+    }
+    read = read_tasks(file, tasks);
+  }
+  else
+  {
+    read = read_tasks(std::cin, tasks);
+  }
+  if (!read)
+    return 1;
+
+  std::vector<edf_task_t> params;
+  for (const task_entry& task : tasks)
+    params.push_back(task.params);
+  unsigned count = unsigned(params.size());
+
+  // job count is the critical scaling factor, the ones before are the tasks
+  uint32_t critical_scaling_factor = 0;
+  std::atomic<unsigned> next_job(0);
+  auto worker = [&]()
+  {
+    for (unsigned job = next_job++; job <= count; job = next_job++)
+    {
+      if (job == count)
+        critical_scaling_factor = edf_critical_scaling_factor(params.data(), count);
+      else
+        tasks[job].allowable_exec_bound = edf_allowable_exec_bound(params.data(), count, job);
+    }
+  };
+  if (threads < 1)
+    threads = 1;
+  if (threads > count + 1)
+    threads = count + 1;
+  std::vector<std::thread> pool;
+  for (unsigned i = 1; i < threads; ++i)
+    pool.emplace_back(worker);
+  worker();
+  for (std::thread& thread : pool)
+    thread.join();
+
+  uint64_t utilization = 0;
+  for (const edf_task_t& task : params)
+    utilization += uint64_t(task.exec_bound) * 1000000 / task.period;
+
+  printf("tasks:                    %u\n", count);
+  printf("utilization:              %.4f\n", utilization / 1000000.0);
+  printf("schedulable:              %s\n", critical_scaling_factor >= EDF_SCALE_ONE ? "yes" : "no");
+  printf("critical scaling factor:  %.4f\n\n", double(critical_scaling_factor) / EDF_SCALE_ONE);
+  printf("%-20s %10s %10s %10s %10s %10s\n", "task", "exec_bound", "period", "deadline", "allowable", "slack");
+  for (const task_entry& task : tasks)
+  {
+    long slack = long(task.allowable_exec_bound) - long(task.params.exec_bound);
+    printf("%-20s %10u %10u %10u %10llu %10ld\n", task.name.c_str(), task.params.exec_bound, task.params.period,
+           task.params.deadline, (unsigned long long)task.allowable_exec_bound, slack < 0 ? 0 : slack);
+  }
+  return 0;
+}
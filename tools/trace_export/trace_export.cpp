@@ -0,0 +1,226 @@
+/*
+  Trace Export Tool
+  Copyright (C) 2023, by John Ryland
+  All rights reserved.
+
+  Tool which converts a dump of the kernel's schedule trace recorder in
+  to the Chrome trace event format, which chrome://tracing and the
+  Perfetto UI can open, to look at long schedules offline.
+
+  Usage:
+
+    trace_export [trace.bin] > trace.json
+*/
+
+#include "types/trace_event.h"
+
+#include <string>
+#include <vector>
+#include <map>
+#include <cstdio>
+#include <cstring>
+
+// tracks of the one process, after the cpus' tracks
+#define ADMISSION_TRACK    1000
+#define TIMER_TRACK        1001
+#define TASK_TRACK_BASE    2000
+
+// the kernel's acceptance_codes, see include/kernel/schedule.h
+static const char* acceptance_names[] =
+{
+  "accepted",
+  "bound_gt_period",
+  "bound_gt_start_to_complete",
+  "wait_for_not_present",
+  "can_not_be_scheduled_with_the_other_tasks",
+  "schedule_full",
+  "scheduled_item_buffer_too_small",
+  "task_not_present",
+  "mode_not_defined",
+  "firm_constraint_invalid",
+  "task_name_in_use",
+};
+
+static std::map<uint16_t, std::string> task_names;
+static uint64_t first_timestamp = 0;
+static uint64_t timestamp_frequency = 1;
+static bool first_output = true;
+
+static
+bool read_exactly(FILE* file, void* data, size_t size)
+{
+  return fread(data, 1, size, file) == size;
+}
+
+static
+std::string escape(const std::string& str)
+{
+  std::string escaped;
+  for (char ch : str)
+  {
+    if (ch == '"' || ch == '\\')
+      escaped += '\\';
+    if (static_cast<unsigned char>(ch) >= ' ')
+      escaped += ch;
+  }
+  return escaped;
+}
+
+static
+std::string task_name(uint16_t slot)
+{
+  if (slot == TRACE_NO_TASK)
+    return "unknown task";
+  auto name = task_names.find(slot);
+  return (name != task_names.end()) ? name->second : "task " + std::to_string(slot);
+}
+
+// microseconds since the first event, which is what the format uses
+static
+double microseconds(uint64_t timestamp)
+{
+  return double(timestamp - first_timestamp) * 1000000.0 / double(timestamp_frequency);
+}
+
+static
+void output(const std::string& event)
+{
+  printf("%s\n    %s", first_output ? "" : ",", event.c_str());
+  first_output = false;
+}
+
+static
+void output_track_name(unsigned track, const std::string& name)
+{
+  output("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" + std::to_string(track) +
+         ",\"args\":{\"name\":\"" + escape(name) + "\"}}");
+}
+
+static
+void output_instant(unsigned track, const std::string& name, uint64_t timestamp, const std::string& args)
+{
+  char ts[32];
+  snprintf(ts, sizeof(ts), "%.3f", microseconds(timestamp));
+  output("{\"name\":\"" + escape(name) + "\",\"ph\":\"i\",\"s\":\"t\",\"pid\":0,\"tid\":" + std::to_string(track) +
+         ",\"ts\":" + ts + ",\"args\":{" + args + "}}");
+}
+
+static
+void output_run(unsigned track, const std::string& name, uint64_t start, uint64_t finish, uint32_t ticks)
+{
+  char times[64];
+  snprintf(times, sizeof(times), "\"ts\":%.3f,\"dur\":%.3f", microseconds(start), microseconds(finish) - microseconds(start));
+  output("{\"name\":\"" + escape(name) + "\",\"ph\":\"X\",\"pid\":0,\"tid\":" + std::to_string(track) +
+         "," + times + ",\"args\":{\"ticks\":" + std::to_string(ticks) + "}}");
+}
+
+// The runs of the tasks are on the cpus' tracks, made from each start and
+// the finish which follows it, and the rest are on the tasks' own tracks
+static
+void output_events(const std::vector<trace_event_t>& events)
+{
+  std::map<uint8_t, trace_event_t> running;
+  for (const trace_event_t& event : events)
+  {
+    std::string name = task_name(event.task);
+    unsigned task_track = TASK_TRACK_BASE + event.task;
+    std::string arg = std::to_string(event.arg);
+    switch (event.type)
+    {
+      case TRACE_START:
+        running[event.cpu] = event;
+        break;
+      case TRACE_FINISH:
+      {
+        auto start = running.find(event.cpu);
+        // a finish without its start was from before the oldest event kept
+        if (start != running.end() && start->second.task == event.task)
+          output_run(event.cpu, name, start->second.timestamp, event.timestamp, event.arg);
+        running.erase(event.cpu);
+        break;
+      }
+      case TRACE_RELEASE:       output_instant(task_track, "release", event.timestamp, "\"tick\":" + arg); break;
+      case TRACE_PREEMPT:       output_instant(task_track, "preempted", event.timestamp, ""); break;
+      case TRACE_DEADLINE_MISS: output_instant(task_track, "deadline miss", event.timestamp, "\"ticks_late\":" + arg); break;
+      case TRACE_JOB_SKIPPED:   output_instant(task_track, "job skipped", event.timestamp, ""); break;
+      case TRACE_TIMER_TICK:    output_instant(TIMER_TRACK, "tick", event.timestamp, "\"tick\":" + arg); break;
+      case TRACE_ADMISSION:
+      {
+        const char* result = (event.arg < sizeof(acceptance_names) / sizeof(acceptance_names[0])) ? acceptance_names[event.arg] : "unknown";
+        output_instant(ADMISSION_TRACK, event.arg ? "rejected" : "admitted", event.timestamp,
+                       "\"task\":\"" + escape(event.task == TRACE_NO_TASK ? "not added" : name) + "\",\"result\":\"" + result + "\"");
+        break;
+      }
+      default:
+        break;
+    }
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  FILE* file = (argc >= 2) ? fopen(argv[1], "rb") : stdin;
+  if (!file)
+  {
+    fprintf(stderr, "usage: %s [trace.bin] > trace.json\n", argv[0]);
+    return 1;
+  }
+
+  trace_dump_header_t header;
+  if (!read_exactly(file, &header, sizeof(header)) || header.magic != TRACE_DUMP_MAGIC)
+  {
+    fprintf(stderr, "not a trace dump\n");
+    return 1;
+  }
+  if (header.version != TRACE_DUMP_VERSION)
+  {
+    fprintf(stderr, "trace dump is version %u, expected %u\n", header.version, TRACE_DUMP_VERSION);
+    return 1;
+  }
+
+  for (unsigned i = 0; i < header.task_count; i++)
+  {
+    trace_task_record_t task;
+    if (!read_exactly(file, &task, sizeof(task)))
+    {
+      fprintf(stderr, "trace dump is cut short\n");
+      return 1;
+    }
+    task.name[TRACE_TASK_NAME_LENGTH - 1] = 0;
+    task_names[task.slot] = task.name;
+  }
+
+  std::vector<trace_event_t> events(header.event_count);
+  if (header.event_count && !read_exactly(file, events.data(), events.size() * sizeof(trace_event_t)))
+  {
+    fprintf(stderr, "trace dump is cut short\n");
+    return 1;
+  }
+  if (header.lost_events)
+    fprintf(stderr, "the oldest %u events were overwritten before the dump\n", header.lost_events);
+  if (!header.timestamp_frequency)
+  {
+    fprintf(stderr, "the trace has no timestamp frequency, it was too short to measure\n");
+    return 1;
+  }
+  timestamp_frequency = header.timestamp_frequency;
+  first_timestamp = events.empty() ? 0 : events[0].timestamp;
+  for (const trace_event_t& event : events)
+    if (event.timestamp < first_timestamp)
+      first_timestamp = event.timestamp;
+
+  printf("{\n  \"displayTimeUnit\": \"ns\",\n  \"traceEvents\": [");
+  output("{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,\"args\":{\"name\":\"Real-time Scheduler\"}}");
+  std::map<uint8_t, bool> cpus;
+  for (const trace_event_t& event : events)
+    cpus[event.cpu] = true;
+  for (auto& cpu : cpus)
+    output_track_name(cpu.first, "CPU " + std::to_string(cpu.first));
+  output_track_name(ADMISSION_TRACK, "Admission");
+  output_track_name(TIMER_TRACK, "Timer");
+  for (auto& task : task_names)
+    output_track_name(TASK_TRACK_BASE + task.first, task.second);
+  output_events(events);
+  printf("\n  ]\n}\n");
+  return 0;
+}